@@ -0,0 +1,168 @@
+#include "harness.hpp"
+
+#include <TMBEL.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+template <typename Base>
+class Exposed : public Base {
+ public:
+    using Base::Base;
+    using Base::get;
+    using Base::push;
+};
+
+template <typename Map>
+Body mapLookup(uint64_t size) {
+    return [size](uint64_t ops) {
+        Map map;
+        ec::HandlerList<uint64_t> list;
+        for (uint64_t i = 0; i < size; ++i) map.push(i * 7919, &list);
+
+        std::mt19937_64 random(42);
+        std::vector<uint64_t> keys(4096);
+        for (auto& el : keys) el = (random() % size) * 7919;
+
+        ec::HandlerList<uint64_t>* result = nullptr;
+        auto begin = Clock::now();
+        for (uint64_t i = 0; i < ops; ++i) result = map.get(keys[i & 4095]);
+        uint64_t time = elapsed(begin);
+
+        keep(result);
+        return time;
+    };
+}
+
+// Subscribes count patterns "m.<a>.<b>.<c>" over 10 x 100 x count/1000
+// levels, every 16th with a '*' level and every 64th ending in '#'.
+void subscribeTopics(ec::TopicRouter<uint64_t>* router,
+                     ec::HandlerList<uint64_t>* list, uint64_t count) {
+    for (uint64_t i = 0; i < count; ++i) {
+        std::string b = i % 16 == 0 ? "*" : std::to_string(i / 10 % 100);
+        std::string c = i % 64 == 0 ? "#" : std::to_string(i / 1000);
+        router->subscribe("m." + std::to_string(i % 10) + "." + b + "." + c,
+                          list);
+    }
+}
+
+std::vector<std::string> topics(uint64_t size) {
+    std::mt19937_64 random(42);
+    std::vector<std::string> result(4096);
+    for (auto& el : result) {
+        uint64_t i = random() % size;
+        el = "m." + std::to_string(i % 10) + "." + std::to_string(i / 10 % 100) +
+             "." + std::to_string(i / 1000);
+    }
+    return result;
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////
+/// Lookups in the global handler containers.
+////////////////////////////////////////////////////////////
+
+void containerBenchmarks(Runner& runner) {
+    for (uint64_t size : {1000, 100000}) {
+        runner.run("global_map/get", 1, size, 1 << 20,
+                   mapLookup<Exposed<ec::GlobalMapBase<uint64_t, uint64_t>>>(
+                       size));
+        runner.run(
+            "global_hash_map/get", 1, size, 1 << 20,
+            mapLookup<Exposed<ec::GlobalHashMapBase<uint64_t, uint64_t>>>(
+                size));
+
+        runner.run("global_mas/get", 1, size, 1 << 20, [size](uint64_t ops) {
+            Exposed<ec::GlobalMasBase<uint64_t>> mas;
+            ec::HandlerList<uint64_t> list;
+            std::vector<ec::SlotHandle> handles;
+            for (uint64_t i = 0; i < size; ++i)
+                handles.push_back(mas.push(&list));
+
+            std::mt19937_64 random(42);
+            std::vector<ec::SlotHandle> keys(4096);
+            for (auto& el : keys) el = handles[random() % size];
+
+            ec::HandlerList<uint64_t>* result = nullptr;
+            auto begin = Clock::now();
+            for (uint64_t i = 0; i < ops; ++i) result = mas.get(keys[i & 4095]);
+            uint64_t time = elapsed(begin);
+
+            keep(result);
+            return time;
+        });
+    }
+
+    constexpr uint64_t subscriptions = 100000;
+
+    // Cache disabled, every match walks the trie
+    runner.run("topic_router/match_cold", 1, subscriptions, 1 << 16,
+               [](uint64_t ops) {
+                   ec::TopicRouter<uint64_t> router(0);
+                   ec::HandlerList<uint64_t> list;
+                   subscribeTopics(&router, &list, subscriptions);
+                   auto keys = topics(subscriptions);
+
+                   size_t result = 0;
+                   auto begin    = Clock::now();
+                   for (uint64_t i = 0; i < ops; ++i)
+                       result += router.match(keys[i & 4095])->size();
+                   uint64_t time = elapsed(begin);
+
+                   keep(result);
+                   return time;
+               });
+
+    runner.run("topic_router/match_cached", 1, subscriptions, 1 << 20,
+               [](uint64_t ops) {
+                   ec::TopicRouter<uint64_t> router;
+                   ec::HandlerList<uint64_t> list;
+                   subscribeTopics(&router, &list, subscriptions);
+                   auto keys = topics(subscriptions);
+                   for (auto& el : keys) router.match(el);
+
+                   size_t result = 0;
+                   auto begin    = Clock::now();
+                   for (uint64_t i = 0; i < ops; ++i)
+                       result += router.match(keys[i & 4095])->size();
+                   uint64_t time = elapsed(begin);
+
+                   keep(result);
+                   return time;
+               });
+
+    // Subscribe and unsubscribe of a pattern next to a full cache, param
+    // is the number of cached topics.
+    for (uint64_t cached : {0, 1 << 16}) {
+        runner.run(
+            "topic_router/subscribe", 1, cached, 1 << 14,
+            [cached](uint64_t ops) {
+                ec::TopicRouter<uint64_t> router(1 << 16);
+                ec::HandlerList<uint64_t> list;
+                subscribeTopics(&router, &list, subscriptions);
+                std::mt19937_64 random(7);
+                for (uint64_t i = 0; i < cached; ++i) {
+                    uint64_t topic = random() % subscriptions;
+                    router.match("m." + std::to_string(topic % 10) + "." +
+                                 std::to_string(topic / 10 % 100) + "." +
+                                 std::to_string(topic / 1000));
+                }
+                auto keys = topics(subscriptions);
+
+                auto begin = Clock::now();
+                for (uint64_t i = 0; i < ops; ++i)
+                    router.unsubscribe(router.subscribe(keys[i & 4095], &list));
+                uint64_t time = elapsed(begin);
+
+                keep(router.size());
+                return time;
+            });
+    }
+}
+
+}  // namespace bench
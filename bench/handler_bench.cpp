@@ -0,0 +1,375 @@
+#include "harness.hpp"
+
+#include <TMBEL.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+class CountHandler : public ec::Handler<uint64_t> {
+ public:
+    uint64_t sum = 0;
+
+    void call(const uint64_t& data) override { sum += data; }
+};
+
+// Keeps the last event, like a handler that hands it to another thread.
+template <typename Payload>
+class KeepHandler : public ec::Handler<Payload> {
+ public:
+    Payload last;
+
+    void call(const Payload& data) override { last = data; }
+};
+
+template <typename Payload>
+uint64_t fanOutPayload(const Payload& payload, uint64_t width, uint64_t ops) {
+    ec::HandlerList<Payload> list;
+    std::vector<std::unique_ptr<KeepHandler<Payload>>> handlers;
+    for (uint64_t i = 0; i < width; ++i) {
+        handlers.push_back(std::make_unique<KeepHandler<Payload>>());
+        list.attach(handlers.back().get());
+    }
+
+    auto begin = Clock::now();
+    for (uint64_t i = 0; i < ops; ++i) {
+        list.call(payload);
+        for (auto& el : handlers) el->last = Payload();
+    }
+    return elapsed(begin);
+}
+
+constexpr size_t payload_size = 4096;
+
+struct Quote {
+    int64_t symbol;
+    int64_t price;
+};
+
+// Handler that filters in its body, the pattern the index replaces.
+class SymbolHandler : public ec::Handler<Quote> {
+ public:
+    int64_t symbol;
+    uint64_t calls = 0;
+
+    explicit SymbolHandler(int64_t symbol) : symbol(symbol) {}
+
+    void call(const Quote& data) override {
+        if (data.symbol != symbol) return;
+        ++calls;
+    }
+};
+
+// Dispatches quotes of random symbols to width handlers that each want
+// one symbol, filtering in the handlers or through the index.
+uint64_t filteredDispatch(bool indexed, uint64_t width, uint64_t ops) {
+    ec::IndexedHandlerList<Quote> index;
+    ec::HandlerList<Quote> list;
+    size_t field =
+        index.addField([](const Quote& data) { return data.symbol; });
+
+    std::vector<std::unique_ptr<SymbolHandler>> handlers;
+    for (uint64_t i = 0; i < width; ++i) {
+        handlers.push_back(std::make_unique<SymbolHandler>(int64_t(i)));
+        if (indexed)
+            index.attach(handlers.back().get(),
+                         ec::SubscriptionFilter().equal(field, int64_t(i)));
+        else
+            list.attach(handlers.back().get());
+    }
+
+    auto begin = Clock::now();
+    for (uint64_t i = 0; i < ops; ++i) {
+        Quote quote{int64_t(i * 7919 % width), int64_t(i)};
+        if (indexed)
+            index.call(quote);
+        else
+            list.call(quote);
+    }
+    uint64_t result = elapsed(begin);
+
+    keep(handlers.front()->calls);
+    return result;
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////
+/// HandlerList fan-out and per-event cost of the function
+/// handlers.
+////////////////////////////////////////////////////////////
+
+void handlerBenchmarks(Runner& runner) {
+    for (uint64_t width : {1, 10, 100, 1000}) {
+        auto fanOut = [width](bool concurrent) {
+            return [width, concurrent](uint64_t ops) {
+                ec::HandlerList<uint64_t> list;
+                std::vector<std::unique_ptr<CountHandler>> handlers;
+                for (uint64_t i = 0; i < width; ++i) {
+                    handlers.push_back(std::make_unique<CountHandler>());
+                    list.attach(handlers.back().get());
+                }
+
+                auto begin = Clock::now();
+                for (uint64_t i = 0; i < ops; ++i) {
+                    if (concurrent)
+                        list.callConcurrent(i);
+                    else
+                        list.call(i);
+                }
+                uint64_t result = elapsed(begin);
+
+                keep(handlers.front()->sum);
+                return result;
+            };
+        };
+
+        runner.run("handler_list/call", 1, width, (1 << 20) / width,
+                   fanOut(false));
+        runner.run("handler_list/call_concurrent", 1, width,
+                   (1 << 20) / width, fanOut(true));
+    }
+
+    // param is the metrics sample period, 0 runs without metrics.
+    for (uint32_t period : {0, 1, 16}) {
+        runner.run("handler_list/call_metrics", 1, period, 1 << 20,
+                   [period](uint64_t ops) {
+                       ec::HandlerList<uint64_t> list;
+                       CountHandler handler;
+                       if (period != 0) {
+                           handler.setMetrics("bench");
+                           handler.getMetrics()->setSamplePeriod(period);
+                       }
+                       list.attach(&handler);
+
+                       auto begin = Clock::now();
+                       for (uint64_t i = 0; i < ops; ++i)
+                           list.callConcurrent(i);
+                       uint64_t result = elapsed(begin);
+
+                       keep(handler.sum);
+                       return result;
+                   });
+    }
+
+    // A 4 KiB payload kept by every handler: copied, or shared by
+    // reference count. param is the number of handlers.
+    runner.run("handler_list/payload_copy", 1, 50, 1 << 12, [](uint64_t ops) {
+        std::string payload(payload_size, 'x');
+        return fanOutPayload(payload, 50, ops);
+    });
+
+    runner.run("handler_list/payload_shared", 1, 50, 1 << 12, [](uint64_t ops) {
+        auto payload = ec::SharedBuffer::copy(std::string(payload_size, 'x'));
+        return fanOutPayload(payload, 50, ops);
+    });
+
+    runner.run("handler/sync_func", 1, 0, 1 << 20, [](uint64_t ops) {
+        uint64_t sum = 0;
+        ec::SyncFuncHandler<uint64_t> handler(
+            [&sum](const uint64_t& data) { sum += data; });
+        handler.setMutex(ec::MutexList::getInstance()->getMutex());
+
+        auto begin = Clock::now();
+        for (uint64_t i = 0; i < ops; ++i) handler.call(i);
+        uint64_t result = elapsed(begin);
+
+        keep(sum);
+        return result;
+    });
+
+    // Replaces the function with one capturing 40 bytes, which
+    // std::function would have put on the heap.
+    runner.run("handler/set_function", 1, 0, 1 << 20, [](uint64_t ops) {
+        ec::SyncFuncHandler<uint64_t> handler;
+        uint64_t state[5] = {1, 2, 3, 4, 5};
+
+        auto begin = Clock::now();
+        for (uint64_t i = 0; i < ops; ++i) {
+            state[0] = i;
+            handler.setFunction([state](const uint64_t& data) {
+                keep(state[0] + state[4] + data);
+            });
+        }
+        return elapsed(begin);
+    });
+
+    // param is the number of handlers, each matches one symbol.
+    for (uint64_t width : {50, 5000}) {
+        runner.run("handler_list/filtered_in_handler", 1, width,
+                   (1 << 18) / width * 10, [width](uint64_t ops) {
+                       return filteredDispatch(false, width, ops);
+                   });
+        runner.run("handler_list/filtered_indexed", 1, width, 1 << 18,
+                   [width](uint64_t ops) {
+                       return filteredDispatch(true, width, ops);
+                   });
+    }
+
+    // Cost of the decision in front of a handler, most events of the
+    // storm are rejected.
+    runner.run("flow/rate_limiter", 1, 0, 1 << 20, [](uint64_t ops) {
+        ec::RateLimiter<uint64_t> limiter(1000, 10);
+        CountHandler handler;
+        limiter.attach(&handler);
+
+        auto begin = Clock::now();
+        for (uint64_t i = 0; i < ops; ++i) limiter.call(i);
+        uint64_t result = elapsed(begin);
+
+        keep(handler.sum);
+        return result;
+    });
+
+    // param is the number of keys.
+    runner.run("flow/throttle", 1, 1024, 1 << 20, [](uint64_t ops) {
+        ec::Throttle<uint64_t> throttle(
+            [](const uint64_t& data) { return data & 1023; },
+            std::chrono::milliseconds(1));
+        CountHandler handler;
+        throttle.attach(&handler);
+
+        auto begin = Clock::now();
+        for (uint64_t i = 0; i < ops; ++i) throttle.call(i);
+        uint64_t result = elapsed(begin);
+
+        keep(handler.sum);
+        return result;
+    });
+
+    runner.run("flow/sampler", 1, 100, 1 << 20, [](uint64_t ops) {
+        ec::Sampler<uint64_t> sampler(100);
+        CountHandler handler;
+        sampler.attach(&handler);
+
+        auto begin = Clock::now();
+        for (uint64_t i = 0; i < ops; ++i) sampler.call(i);
+        uint64_t result = elapsed(begin);
+
+        keep(handler.sum);
+        return result;
+    });
+
+    runner.run("flow/reservoir", 1, 64, 1 << 20, [](uint64_t ops) {
+        ec::ReservoirSampler<uint64_t> sampler(64);
+        CountHandler handler;
+        sampler.attach(&handler);
+
+        auto begin = Clock::now();
+        for (uint64_t i = 0; i < ops; ++i) sampler.call(i);
+        sampler.flush();
+        uint64_t result = elapsed(begin);
+
+        keep(handler.sum);
+        return result;
+    });
+
+    // Tumbling windows of 100 events per key, param is the number of
+    // keys.
+    runner.run("window/count", 1, 1024, 1 << 20, [](uint64_t ops) {
+        ec::WindowProcessor<uint64_t, uint64_t> window(
+            100, 100, [](uint64_t& sum, const uint64_t& data) { sum += data; });
+        window.setKey([](const uint64_t& data) { return data; }, 1024);
+        CountHandler handler;
+        window.attach(&handler);
+
+        auto begin = Clock::now();
+        for (uint64_t i = 0; i < ops; ++i) window.call(i);
+        uint64_t result = elapsed(begin);
+
+        keep(handler.sum);
+        return result;
+    });
+
+    // Closing the time windows of every key, param is the number of
+    // keys, one event per key and tick.
+    runner.run("window/tick", 1, 1024, 1 << 10, [](uint64_t ops) {
+        ec::WindowProcessor<uint64_t, uint64_t> window(
+            std::chrono::seconds(1), std::chrono::seconds(1),
+            [](uint64_t& sum, const uint64_t& data) { sum += data; });
+        window.setKey([](const uint64_t& data) { return data; }, 1024);
+        CountHandler handler;
+        window.attach(&handler);
+
+        uint64_t result = 0;
+        for (uint64_t i = 0; i < ops; ++i) {
+            for (uint64_t key = 0; key < 1024; ++key) window.call(key);
+
+            auto begin = Clock::now();
+            window.tick();
+            result += elapsed(begin);
+        }
+
+        keep(handler.sum);
+        return result;
+    });
+
+    // param is the number of map stages, wired as Processors with a
+    // handler list per hop or compiled into one chain of a graph.
+    for (uint64_t stages : {1, 4, 16}) {
+        runner.run("flow_graph/processor_chain", 1, stages, 1 << 20,
+                   [stages](uint64_t ops) {
+                       std::vector<std::unique_ptr<
+                           ec::Processor<uint64_t, uint64_t>>>
+                           chain;
+                       for (uint64_t i = 0; i < stages; ++i) {
+                           chain.push_back(std::make_unique<
+                                           ec::Processor<uint64_t, uint64_t>>(
+                               [](const uint64_t& data) { return data + 1; }));
+                           if (i > 0) chain[i - 1]->attach(chain[i].get());
+                       }
+                       CountHandler handler;
+                       chain.back()->attach(&handler);
+
+                       auto begin = Clock::now();
+                       for (uint64_t i = 0; i < ops; ++i) chain[0]->call(i);
+                       uint64_t result = elapsed(begin);
+
+                       keep(handler.sum);
+                       return result;
+                   });
+        runner.run("flow_graph/chain", 1, stages, 1 << 20,
+                   [stages](uint64_t ops) {
+                       ec::FlowGraph graph;
+                       auto source = graph.source<uint64_t>("source");
+                       auto node   = source;
+                       for (uint64_t i = 0; i < stages; ++i)
+                           node = graph.map<uint64_t>(
+                               node, "map" + std::to_string(i),
+                               [](const uint64_t& data) { return data + 1; });
+                       uint64_t sum = 0;
+                       graph.sink(node, "sum", [&sum](const uint64_t& data) {
+                           sum += data;
+                       });
+                       graph.build();
+
+                       auto begin = Clock::now();
+                       for (uint64_t i = 0; i < ops; ++i) graph.push(source, i);
+                       uint64_t result = elapsed(begin);
+
+                       keep(sum);
+                       return result;
+                   });
+    }
+
+    runner.run("handler/async_func", 1, 0, 1 << 12, [](uint64_t ops) {
+        std::atomic<uint64_t> sum{0};
+        static const uint64_t data = 1;
+
+        auto begin = Clock::now();
+        {
+            ec::AsyncFuncHandler<uint64_t> handler(
+                [&sum](const uint64_t& value) { sum += value; });
+            handler.setMutex(ec::MutexList::getInstance()->getMutex());
+            for (uint64_t i = 0; i < ops; ++i) handler.call(data);
+        }
+        return elapsed(begin);
+    });
+}
+
+}  // namespace bench
@@ -0,0 +1,71 @@
+#include "harness.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <thread>
+
+namespace bench {
+
+////////////////////////////////////////////////////////////
+// Runner implementation
+////////////////////////////////////////////////////////////
+
+Runner::Runner(const std::string& filter, size_t repetitions, double scale)
+    : filter_(filter), repetitions_(std::max<size_t>(repetitions, 1)),
+      scale_(scale) {}
+
+void Runner::run(const std::string& name, size_t threads, uint64_t param,
+                 uint64_t ops, const Body& body) {
+    if (!filter_.empty() && name.find(filter_) == std::string::npos) return;
+
+    ops = std::max<uint64_t>(static_cast<uint64_t>(ops * scale_), threads);
+
+    std::vector<double> samples;
+    for (size_t i = 0; i < repetitions_; ++i)
+        samples.push_back(static_cast<double>(body(ops)) / ops);
+    std::sort(samples.begin(), samples.end());
+
+    Result result;
+    result.name          = name;
+    result.threads       = threads;
+    result.param         = param;
+    result.ops           = ops;
+    result.ns_per_op     = samples[samples.size() / 2];
+    result.min_ns_per_op = samples.front();
+    result.max_ns_per_op = samples.back();
+    results_.push_back(result);
+
+    std::fprintf(stderr, "%-40s threads=%-3zu param=%-8lu %10.2f ns/op\n",
+                 name.c_str(), threads, static_cast<unsigned long>(param),
+                 result.ns_per_op);
+}
+
+void Runner::writeJson(std::ostream& stream) const {
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    stream << "{\n  \"context\": {\n"
+           << "    \"date\": \"" << date << "\",\n"
+           << "    \"hardware_threads\": "
+           << std::thread::hardware_concurrency() << ",\n"
+           << "    \"compiler\": \"" << __VERSION__ << "\",\n"
+           << "    \"repetitions\": " << repetitions_ << "\n"
+           << "  },\n  \"benchmarks\": [";
+
+    for (size_t i = 0; i < results_.size(); ++i) {
+        const Result& el = results_[i];
+        stream << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << el.name
+               << "\", \"threads\": " << el.threads
+               << ", \"param\": " << el.param << ", \"ops\": " << el.ops
+               << ", \"ns_per_op\": " << el.ns_per_op
+               << ", \"min_ns_per_op\": " << el.min_ns_per_op
+               << ", \"max_ns_per_op\": " << el.max_ns_per_op
+               << ", \"ops_per_sec\": "
+               << (el.ns_per_op > 0 ? 1e9 / el.ns_per_op : 0) << "}";
+    }
+    stream << "\n  ]\n}\n";
+}
+
+}  // namespace bench
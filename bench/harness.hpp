@@ -0,0 +1,68 @@
+#ifndef _TMBEL_BENCH_HARNESS_HPP_
+#define _TMBEL_BENCH_HARNESS_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+////////////////////////////////////////////////////////////
+/// \brief Measured body. Runs ops operations and returns the
+/// nanoseconds they took, so setup can stay out of timing.
+////////////////////////////////////////////////////////////
+using Body = std::function<uint64_t(uint64_t ops)>;
+
+struct Result {
+    std::string name;
+    size_t threads;
+    uint64_t param;
+    uint64_t ops;
+    double ns_per_op;
+    double min_ns_per_op;
+    double max_ns_per_op;
+};
+
+class Runner {
+ protected:
+    std::vector<Result> results_;
+    std::string filter_;
+    size_t repetitions_;
+    double scale_;
+
+ public:
+    Runner(const std::string& filter, size_t repetitions, double scale);
+
+    /// Runs body repetitions times and keeps the median.
+    void run(const std::string& name, size_t threads, uint64_t param,
+             uint64_t ops, const Body& body);
+
+    void writeJson(std::ostream& stream) const;
+};
+
+using Clock = std::chrono::steady_clock;
+
+inline uint64_t elapsed(Clock::time_point begin) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                                begin)
+        .count();
+}
+
+/// Keeps the compiler from optimizing value away.
+template <typename Ty>
+inline void keep(const Ty& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+void queueBenchmarks(Runner& runner);
+void handlerBenchmarks(Runner& runner);
+void lockBenchmarks(Runner& runner);
+void containerBenchmarks(Runner& runner);
+void replayBenchmarks(Runner& runner);
+
+}  // namespace bench
+
+#endif
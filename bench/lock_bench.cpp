@@ -0,0 +1,59 @@
+#include "harness.hpp"
+
+#include <TMBEL.hpp>
+#include <thread>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+Body contention(ec::MutexType type, ec::MutexAccess access, size_t threads) {
+    return [type, access, threads](uint64_t ops) {
+        ec::Mutex mutex = ec::MutexList::getInstance()
+                              ->getMutex(type)
+                              .withAccess(access);
+        uint64_t per_thread = ops / threads;
+        volatile uint64_t counter = 0;
+
+        std::vector<std::thread> workers;
+        auto begin = Clock::now();
+        for (size_t i = 0; i < threads; ++i)
+            workers.emplace_back([&mutex, &counter, per_thread]() {
+                for (uint64_t j = 0; j < per_thread; ++j) {
+                    mutex.lock();
+                    counter = counter + 1;
+                    mutex.unlock();
+                }
+            });
+        for (auto& el : workers) el.join();
+
+        return elapsed(begin) * ops / (per_thread * threads);
+    };
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////
+/// ec::Mutex groups of every backend under contention on a
+/// short critical section.
+////////////////////////////////////////////////////////////
+
+void lockBenchmarks(Runner& runner) {
+    for (size_t threads : {1, 4, 16, 64}) {
+        runner.run("mutex/recursive", threads, 0, 1 << 20,
+                   contention(ec::MutexType::Recursive,
+                              ec::MutexAccess::Write, threads));
+        runner.run("mutex/adaptive", threads, 0, 1 << 20,
+                   contention(ec::MutexType::Adaptive, ec::MutexAccess::Write,
+                              threads));
+        runner.run("mutex/shared_write", threads, 0, 1 << 20,
+                   contention(ec::MutexType::Shared, ec::MutexAccess::Write,
+                              threads));
+        runner.run("mutex/shared_read", threads, 0, 1 << 20,
+                   contention(ec::MutexType::Shared, ec::MutexAccess::Read,
+                              threads));
+    }
+}
+
+}  // namespace bench
@@ -0,0 +1,61 @@
+#include "harness.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+////////////////////////////////////////////////////////////
+/// tmbel_bench [--filter=substring] [--json=path]
+///             [--repetitions=n] [--scale=x]
+///
+/// Progress goes to stderr, JSON results to --json or stdout.
+////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv) {
+    std::string filter;
+    std::string json;
+    size_t repetitions = 5;
+    double scale       = 1.0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        auto value = [&argument](const char* prefix) -> const char* {
+            size_t length = std::strlen(prefix);
+            return argument.compare(0, length, prefix) == 0
+                       ? argument.c_str() + length
+                       : nullptr;
+        };
+
+        if (auto el = value("--filter="))
+            filter = el;
+        else if (auto el = value("--json="))
+            json = el;
+        else if (auto el = value("--repetitions="))
+            repetitions = std::strtoul(el, nullptr, 10);
+        else if (auto el = value("--scale="))
+            scale = std::strtod(el, nullptr);
+        else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--filter=substring] [--json=path]"
+                         " [--repetitions=n] [--scale=x]\n";
+            return 1;
+        }
+    }
+
+    bench::Runner runner(filter, repetitions, scale);
+    bench::queueBenchmarks(runner);
+    bench::handlerBenchmarks(runner);
+    bench::lockBenchmarks(runner);
+    bench::containerBenchmarks(runner);
+    bench::replayBenchmarks(runner);
+
+    if (json.empty()) {
+        runner.writeJson(std::cout);
+    } else {
+        std::ofstream stream(json);
+        runner.writeJson(stream);
+    }
+    return 0;
+}
@@ -0,0 +1,171 @@
+#include "harness.hpp"
+
+#include <TMBEL.hpp>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+////////////////////////////////////////////////////////////
+/// EventQueue push/poll, single thread and with producers
+/// racing one consumer, on the default allocator, the node
+/// pool and an arena. SharedQueue in one process and between
+/// two.
+////////////////////////////////////////////////////////////
+
+namespace {
+
+constexpr uint64_t burst_size = 64;
+
+// Pushes bursts of burst_size events and drains them.
+uint64_t runBursts(ec::EventQueue<uint64_t>& queue, uint64_t ops) {
+    uint64_t data  = 0;
+    uint64_t count = ops / burst_size;
+
+    auto begin = Clock::now();
+    for (uint64_t i = 0; i < count; ++i) {
+        for (uint64_t j = 0; j < burst_size; ++j) queue.push(j);
+        while (queue.pollEvent(&data)) {}
+    }
+    keep(data);
+    return elapsed(begin) * ops / (count * burst_size);
+}
+
+}  // namespace
+
+void queueBenchmarks(Runner& runner) {
+    runner.run("queue/push_poll", 1, 0, 1 << 20, [](uint64_t ops) {
+        ec::EventQueue<uint64_t> queue;
+        uint64_t data;
+
+        auto begin = Clock::now();
+        for (uint64_t i = 0; i < ops; ++i) {
+            queue.push(i);
+            queue.pollEvent(&data);
+        }
+        keep(data);
+        return elapsed(begin);
+    });
+
+    runner.run("queue/burst_default", 1, burst_size, 1 << 20, [](uint64_t ops) {
+        ec::EventQueue<uint64_t> queue;
+        return runBursts(queue, ops);
+    });
+
+    runner.run("queue/burst_pool", 1, burst_size, 1 << 20, [](uint64_t ops) {
+        ec::EventQueue<uint64_t> queue(ec::NodePoolResource::getInstance());
+        return runBursts(queue, ops);
+    });
+
+    runner.run("queue/burst_arena", 1, burst_size, 1 << 20, [](uint64_t ops) {
+        ec::ArenaResource arena;
+        ec::EventQueue<uint64_t> queue(&arena);
+        return runBursts(queue, ops);
+    });
+
+    struct Resource {
+        const char* name;
+        std::pmr::memory_resource* resource;
+    };
+
+    for (Resource resource :
+         {Resource{"queue/producers_consumer", std::pmr::get_default_resource()},
+          Resource{"queue/producers_consumer_pool",
+                   ec::NodePoolResource::getInstance()}})
+        for (size_t producers : {1, 2, 4, 8}) {
+            runner.run(
+                resource.name, producers + 1, producers, 1 << 20,
+                [producers, resource](uint64_t ops) {
+                    ec::EventQueue<uint64_t> queue(resource.resource);
+                    uint64_t per_producer = ops / producers;
+
+                    auto begin = Clock::now();
+                    std::vector<std::thread> threads;
+                    for (size_t i = 0; i < producers; ++i)
+                        threads.emplace_back([&queue, per_producer]() {
+                            for (uint64_t j = 0; j < per_producer; ++j)
+                                queue.push(j);
+                        });
+
+                    uint64_t data;
+                    for (uint64_t i = 0; i < per_producer * producers; ++i)
+                        queue.waitEvent(&data);
+
+                    for (auto& el : threads) el.join();
+                    return elapsed(begin) * ops / (per_producer * producers);
+                });
+        }
+
+#ifdef __linux__
+    runner.run("shared_queue/push_poll", 1, 0, 1 << 20, [](uint64_t ops) {
+        auto queue =
+            ec::SharedQueue<uint64_t>::create(1024, ec::SharedQueueMode::Spsc);
+        uint64_t data = 0;
+
+        auto begin = Clock::now();
+        for (uint64_t i = 0; i < ops; ++i) {
+            queue.push(i);
+            queue.pollEvent(&data);
+        }
+        keep(data);
+        return elapsed(begin);
+    });
+
+    // Events pushed by a child process and drained by the parent.
+    runner.run("shared_queue/cross_process", 2, 0, 1 << 20, [](uint64_t ops) {
+        auto queue =
+            ec::SharedQueue<uint64_t>::create(4096, ec::SharedQueueMode::Spsc);
+
+        auto begin  = Clock::now();
+        pid_t child = fork();
+        if (child == 0) {
+            for (uint64_t i = 0; i < ops; ++i) queue.push(i);
+            _exit(0);
+        }
+
+        uint64_t data = 0;
+        for (uint64_t i = 0; i < ops; ++i) queue.waitEvent(&data);
+        uint64_t result = elapsed(begin);
+
+        waitpid(child, nullptr, 0);
+        keep(data);
+        return result;
+    });
+
+    // One event bounced between two processes, the time is reported per
+    // one-way hand-off.
+    runner.run("shared_queue/ping_pong", 2, 0, 1 << 14, [](uint64_t ops) {
+        auto ping =
+            ec::SharedQueue<uint64_t>::create(16, ec::SharedQueueMode::Spsc);
+        auto pong =
+            ec::SharedQueue<uint64_t>::create(16, ec::SharedQueueMode::Spsc);
+
+        pid_t child = fork();
+        if (child == 0) {
+            uint64_t data;
+            while (ping.waitEvent(&data)) pong.push(data);
+            _exit(0);
+        }
+
+        uint64_t data = 0;
+        auto begin    = Clock::now();
+        for (uint64_t i = 0; i < ops; ++i) {
+            ping.push(i);
+            pong.waitEvent(&data);
+        }
+        uint64_t result = elapsed(begin) / 2;
+
+        ping.close();
+        waitpid(child, nullptr, 0);
+        keep(data);
+        return result;
+    });
+#endif
+}
+
+}  // namespace bench
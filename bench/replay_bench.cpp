@@ -0,0 +1,114 @@
+#include "harness.hpp"
+
+#include <TMBEL.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+
+namespace bench {
+
+namespace {
+
+class CountHandler : public ec::Handler<uint64_t> {
+ public:
+    uint64_t sum = 0;
+
+    void call(const uint64_t& data) override { sum += data; }
+};
+
+class Controller : public ec::ControllerBase<uint64_t> {
+ public:
+    void process() override {}
+
+    void attach(ec::Handler<uint64_t>* handler) {
+        handler_list_.attach(handler);
+    }
+};
+
+std::string tracePath() {
+    return (std::filesystem::temp_directory_path() / "tmbel_bench_trace.rec")
+        .string();
+}
+
+// Bursts of 1 to 64 events 1 µs apart with 100 µs between the
+// bursts, from a fixed seed so every run replays the same trace.
+void writeTrace(const std::string& path, uint64_t events) {
+    ec::EventRecorder recorder(path);
+    std::mt19937_64 random(42);
+    uint64_t time = 0;
+
+    for (uint64_t i = 0; i < events;) {
+        uint64_t burst = random() % 64 + 1;
+        for (uint64_t j = 0; j < burst && i < events; ++j, ++i) {
+            recorder.record(time, std::string_view(
+                                      reinterpret_cast<const char*>(&i),
+                                      sizeof(i)));
+            time += 1000;
+        }
+        time += 100000;
+    }
+}
+
+uint64_t recordEvents(bool async, uint64_t ops) {
+    std::string path = tracePath();
+    uint64_t result;
+    {
+        ec::RecordHandler<uint64_t> handler(path, async);
+
+        auto begin = Clock::now();
+        for (uint64_t i = 0; i < ops; ++i) handler.call(i);
+        handler.getRecorder()->flush();
+        result = elapsed(begin);
+    }
+    std::remove(path.c_str());
+    return result;
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////
+/// Recording cost of RecordHandler and replay of a recorded
+/// trace through a controller.
+////////////////////////////////////////////////////////////
+
+void replayBenchmarks(Runner& runner) {
+    // param 1 writes the file on the recorder thread.
+    for (bool async : {false, true})
+        runner.run("recorder/record", 1, async, 1 << 20,
+                   [async](uint64_t ops) { return recordEvents(async, ops); });
+
+    runner.run("replay/throughput", 1, 0, 1 << 18, [](uint64_t ops) {
+        std::string path = tracePath();
+        writeTrace(path, ops);
+        ec::Replayer<uint64_t> replayer(path);
+        std::remove(path.c_str());
+
+        Controller controller;
+        CountHandler handler;
+        controller.attach(&handler);
+
+        auto stats = replayer.replay(&controller, ec::ReplayMode::Throughput);
+        keep(handler.sum);
+        return stats.elapsed;
+    });
+
+    // Mean lag behind the recorded schedule instead of elapsed time,
+    // which is the length of the trace.
+    runner.run("replay/timed_lag", 1, 0, 1 << 12, [](uint64_t ops) {
+        std::string path = tracePath();
+        writeTrace(path, ops);
+        ec::Replayer<uint64_t> replayer(path);
+        std::remove(path.c_str());
+
+        Controller controller;
+        CountHandler handler;
+        controller.attach(&handler);
+
+        auto stats = replayer.replay(&controller, ec::ReplayMode::Timed);
+        keep(handler.sum);
+        return stats.mean_lag * ops;
+    });
+}
+
+}  // namespace bench
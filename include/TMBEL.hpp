@@ -1,14 +1,31 @@
 #ifndef _TMBEL_HPP_
 #define _TMBEL_HPP_
 
+#include <TMBEL/inplace_function.hpp>
 #include <TMBEL/multithread_list.hpp>
 #include <TMBEL/singleton.hpp>
+#include <TMBEL/concurrent_map.hpp>
+#include <TMBEL/slot_map.hpp>
 #include <TMBEL/global_container.hpp>
+#include <TMBEL/topic_router.hpp>
+#include <TMBEL/adaptive_mutex.hpp>
+#include <TMBEL/lock_profile.hpp>
 #include <TMBEL/lock_handler.hpp>
 #include <TMBEL/process_list.hpp>
 #include <TMBEL/handler.hpp>
+#include <TMBEL/handler_index.hpp>
 #include <TMBEL/utils.hpp>
+#include <TMBEL/memory_resource.hpp>
+#include <TMBEL/payload.hpp>
+#include <TMBEL/histogram.hpp>
+#include <TMBEL/metrics.hpp>
+#include <TMBEL/tracing.hpp>
+#include <TMBEL/reactor.hpp>
 #include <TMBEL/event_queue.hpp>
+#include <TMBEL/shared_queue.hpp>
 #include <TMBEL/controller.hpp>
+#include <TMBEL/recorder.hpp>
+#include <TMBEL/window.hpp>
+#include <TMBEL/flow_graph.hpp>
 
 #endif
\ No newline at end of file
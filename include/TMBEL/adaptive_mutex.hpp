@@ -0,0 +1,44 @@
+#ifndef _TMBEL_ADAPTIVE_MUTEX_HPP_
+#define _TMBEL_ADAPTIVE_MUTEX_HPP_
+
+#include <atomic>
+#include <cstdint>
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+/// \brief Non-recursive lock that spins for a bounded number
+/// of iterations before parking the thread on a futex.
+///
+/// Meant for short critical sections where the cost of a
+/// syscall is bigger than the work itself. Locking it twice
+/// from the same thread is a deadlock.
+////////////////////////////////////////////////////////////
+class AdaptiveMutex {
+ protected:
+    using Self = AdaptiveMutex;
+
+    // 0 - unlocked, 1 - locked, 2 - locked and somebody parked.
+    std::atomic<uint32_t> state_;
+    uint32_t spin_count_;
+
+    void park_();
+    void wake_();
+
+ public:
+    static constexpr uint32_t default_spin_count = 128;
+
+    AdaptiveMutex(uint32_t spin_count = default_spin_count);
+    AdaptiveMutex(const Self&) = delete;
+    ~AdaptiveMutex();
+
+    Self& operator=(const Self&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+};
+
+}  // namespace ec
+
+#endif
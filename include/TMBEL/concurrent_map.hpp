@@ -0,0 +1,282 @@
+#ifndef _TMBEL_CONCURRENT_MAP_HPP_
+#define _TMBEL_CONCURRENT_MAP_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+/// \brief Hash map split into shards with open addressing.
+///
+/// Lookups take no locks: every shard keeps a table of node
+/// pointers that is only published with release stores and a
+/// pair of reader counters. Writers lock one shard, and
+/// memory of erased nodes and outgrown tables is freed after
+/// all readers that could see it have left the shard.
+///
+/// Stored values are immutable, insert() does not overwrite
+/// an existing key.
+////////////////////////////////////////////////////////////
+template <typename Key, typename Value, typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class ConcurrentMap {
+ protected:
+    using Self = ConcurrentMap;
+
+    struct Node {
+        size_t hash;
+        Key key;
+        Value value;
+    };
+
+    struct Table {
+        size_t mask;
+        std::unique_ptr<std::atomic<Node*>[]> slots;
+
+        Table(size_t capacity)
+            : mask(capacity - 1), slots(new std::atomic<Node*>[capacity]) {
+            for (size_t i = 0; i < capacity; ++i)
+                slots[i].store(nullptr, std::memory_order_relaxed);
+        }
+    };
+
+    struct alignas(64) ReaderCount {
+        std::atomic<size_t> value{0};
+    };
+
+    struct alignas(64) Shard {
+        std::atomic<Table*> table{nullptr};
+        std::atomic<size_t> epoch{0};
+        ReaderCount readers[2];
+
+        std::mutex lock;
+        size_t size = 0;
+        size_t used = 0;  // live nodes and tombstones
+        std::vector<Node*> retired_nodes;
+        std::vector<Table*> retired_tables;
+    };
+
+    static constexpr size_t initial_capacity = 16;
+    static constexpr size_t retire_limit     = 64;
+
+    static inline char tombstone_tag_;
+
+    size_t shard_shift_;
+    size_t shard_count_;
+    std::unique_ptr<Shard[]> shards_;
+    Hash hasher_;
+    KeyEqual equal_;
+
+    static Node* tombstone_() { return reinterpret_cast<Node*>(&tombstone_tag_); }
+
+    static size_t mix_(uint64_t hash) {
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ULL;
+        hash ^= hash >> 33;
+        return static_cast<size_t>(hash);
+    }
+
+    Shard& shardOf_(size_t hash) const {
+        return shards_[shard_count_ == 1 ? 0 : hash >> shard_shift_];
+    }
+
+    size_t enter_(Shard& shard) const {
+        while (true) {
+            size_t epoch = shard.epoch.load(std::memory_order_seq_cst);
+            shard.readers[epoch & 1].value.fetch_add(1,
+                                                     std::memory_order_seq_cst);
+            if (shard.epoch.load(std::memory_order_seq_cst) == epoch)
+                return epoch;
+            shard.readers[epoch & 1].value.fetch_sub(1,
+                                                     std::memory_order_release);
+        }
+    }
+
+    void leave_(Shard& shard, size_t epoch) const {
+        shard.readers[epoch & 1].value.fetch_sub(1, std::memory_order_release);
+    }
+
+    // Waits until no reader can hold a pointer unlinked before the call.
+    // Shard lock must be held.
+    void synchronize_(Shard& shard) {
+        size_t epoch = shard.epoch.load(std::memory_order_relaxed);
+        shard.epoch.store(epoch + 1, std::memory_order_seq_cst);
+        while (shard.readers[epoch & 1].value.load(std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+
+    void reclaim_(Shard& shard) {
+        synchronize_(shard);
+        for (auto el : shard.retired_nodes) delete el;
+        for (auto el : shard.retired_tables) delete el;
+        shard.retired_nodes.clear();
+        shard.retired_tables.clear();
+    }
+
+    void rehash_(Shard& shard) {
+        Table* table    = shard.table.load(std::memory_order_relaxed);
+        size_t capacity = table->mask + 1;
+        while (shard.size * 2 >= capacity) capacity <<= 1;
+
+        Table* result = new Table(capacity);
+        for (size_t i = 0; i <= table->mask; ++i) {
+            Node* node = table->slots[i].load(std::memory_order_relaxed);
+            if (node == nullptr || node == tombstone_()) continue;
+
+            size_t position = node->hash;
+            while (result->slots[position & result->mask].load(
+                       std::memory_order_relaxed) != nullptr)
+                ++position;
+            result->slots[position & result->mask].store(
+                node, std::memory_order_relaxed);
+        }
+
+        shard.table.store(result, std::memory_order_release);
+        shard.used = shard.size;
+        shard.retired_tables.push_back(table);
+    }
+
+ public:
+    ConcurrentMap(size_t shard_count = 64) {
+        shard_shift_ = 64;
+        shard_count_ = 1;
+        while (shard_count_ < shard_count) {
+            shard_count_ <<= 1;
+            --shard_shift_;
+        }
+
+        shards_.reset(new Shard[shard_count_]);
+        for (size_t i = 0; i < shard_count_; ++i)
+            shards_[i].table.store(new Table(initial_capacity),
+                                   std::memory_order_relaxed);
+    }
+
+    ConcurrentMap(const Self&) = delete;
+    Self& operator=(const Self&) = delete;
+
+    ~ConcurrentMap() {
+        for (size_t i = 0; i < shard_count_; ++i) {
+            Shard& shard = shards_[i];
+            Table* table = shard.table.load(std::memory_order_relaxed);
+            for (size_t j = 0; j <= table->mask; ++j) {
+                Node* node = table->slots[j].load(std::memory_order_relaxed);
+                if (node != nullptr && node != tombstone_()) delete node;
+            }
+            delete table;
+
+            for (auto el : shard.retired_nodes) delete el;
+            for (auto el : shard.retired_tables) delete el;
+        }
+    }
+
+    bool find(const Key& key, Value* result) const {
+        size_t hash  = mix_(hasher_(key));
+        Shard& shard = shardOf_(hash);
+        size_t epoch = enter_(shard);
+
+        Table* table = shard.table.load(std::memory_order_acquire);
+        bool found   = false;
+        for (size_t i = hash;; ++i) {
+            Node* node = table->slots[i & table->mask].load(
+                std::memory_order_acquire);
+            if (node == nullptr) break;
+            if (node == tombstone_() || node->hash != hash ||
+                !equal_(node->key, key))
+                continue;
+
+            *result = node->value;
+            found   = true;
+            break;
+        }
+
+        leave_(shard, epoch);
+        return found;
+    }
+
+    bool contains(const Key& key) const {
+        Value value;
+        return find(key, &value);
+    }
+
+    bool insert(const Key& key, const Value& value) {
+        size_t hash  = mix_(hasher_(key));
+        Shard& shard = shardOf_(hash);
+        std::lock_guard lock(shard.lock);
+
+        Table* table = shard.table.load(std::memory_order_relaxed);
+        if ((shard.used + 1) * 4 > (table->mask + 1) * 3) {
+            rehash_(shard);
+            table = shard.table.load(std::memory_order_relaxed);
+        }
+
+        size_t free_slot = table->mask + 1;
+        for (size_t i = hash;; ++i) {
+            Node* node =
+                table->slots[i & table->mask].load(std::memory_order_relaxed);
+            if (node == nullptr) {
+                if (free_slot > table->mask) {
+                    free_slot = i & table->mask;
+                    ++shard.used;
+                }
+                break;
+            }
+            if (node == tombstone_()) {
+                if (free_slot > table->mask) free_slot = i & table->mask;
+                continue;
+            }
+            if (node->hash == hash && equal_(node->key, key)) return false;
+        }
+
+        table->slots[free_slot].store(new Node{hash, key, value},
+                                      std::memory_order_release);
+        ++shard.size;
+
+        if (shard.retired_tables.size() > 0) reclaim_(shard);
+        return true;
+    }
+
+    bool erase(const Key& key, Value* result = nullptr) {
+        size_t hash  = mix_(hasher_(key));
+        Shard& shard = shardOf_(hash);
+        std::lock_guard lock(shard.lock);
+
+        Table* table = shard.table.load(std::memory_order_relaxed);
+        for (size_t i = hash;; ++i) {
+            auto& slot = table->slots[i & table->mask];
+            Node* node = slot.load(std::memory_order_relaxed);
+            if (node == nullptr) return false;
+            if (node == tombstone_() || node->hash != hash ||
+                !equal_(node->key, key))
+                continue;
+
+            if (result != nullptr) *result = node->value;
+            slot.store(tombstone_(), std::memory_order_release);
+            --shard.size;
+
+            shard.retired_nodes.push_back(node);
+            if (shard.retired_nodes.size() >= retire_limit) reclaim_(shard);
+            return true;
+        }
+    }
+
+    size_t size() const {
+        size_t result = 0;
+        for (size_t i = 0; i < shard_count_; ++i) {
+            std::lock_guard lock(shards_[i].lock);
+            result += shards_[i].size;
+        }
+        return result;
+    }
+};
+
+}  // namespace ec
+
+#endif
@@ -1,14 +1,37 @@
 #ifndef _TMBEL_CONTROLLER_HPP_
 #define _TMBEL_CONTROLLER_HPP_
 
+#include <TMBEL/adaptive_mutex.hpp>
 #include <TMBEL/event_queue.hpp>
 #include <TMBEL/handler.hpp>
+#include <TMBEL/memory_resource.hpp>
+#include <TMBEL/metrics.hpp>
+#include <TMBEL/reactor.hpp>
+#include <TMBEL/shared_queue.hpp>
 #include <TMBEL/utils.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace ec {
 
+////////////////////////////////////////////////////////////
+/// \brief How controller workers enter the handler list.
+////////////////////////////////////////////////////////////
+enum class DispatchPolicy {
+    Parallel,     ///< Workers dispatch concurrently, no order between events.
+    Serialized,   ///< One event at a time per HandlerList.
+    Partitioned   ///< Events with equal keys are dispatched in order.
+};
+
 ////////////////////////////////////////////////////////////
 /// \brief Base class of object that used to control event
 /// loop.
@@ -19,28 +42,693 @@ class ControllerBase {
     using Container = HandlerList<Data>;
     using EQueue    = EventQueue<Data>;
 
+ public:
+    using TimePoint = typename EQueue::TimePoint;
+
+    using Partitioner = std::function<size_t(const Data&)>;
+
+    /// Periodic task run by the controller, see addTimer().
+    using TimerTask = InplaceFunction<void()>;
+
+#ifdef __linux__
+    /// Reads everything available on fd (it is watched
+    /// edge-triggered) and appends the events to batch.
+    using Reader =
+        std::function<void(int fd, uint32_t events, std::vector<Data>* batch)>;
+#endif
+
+ protected:
+    ////////////////////////////////////////////////////////////
+    // Partitioned dispatch. Keys are hashed to partitions and
+    // every partition belongs to one lane, which is a queue
+    // drained by one worker. A partition only moves to another
+    // lane when none of its events are queued, so events of a
+    // key never overtake each other.
+    ////////////////////////////////////////////////////////////
+    struct Routed {
+        size_t partition;
+        Data data;
+    };
+
+    struct Partition {
+        AdaptiveMutex lock;
+        std::atomic<size_t> lane{0};
+        std::atomic<size_t> pending{0};
+        std::atomic<size_t> load{0};
+    };
+
+    using Lane = EventQueue<Routed>;
+
+    static constexpr size_t rebalance_check_period = 1024;
+    static constexpr size_t shared_batch_size      = 64;
+
     std::mutex lock_;
     Container handler_list_;
+    std::atomic<Container*> handlers_{&handler_list_};  // dispatched to
+    std::unique_ptr<ArenaResource> arena_;
+    std::pmr::memory_resource* resource_ = std::pmr::get_default_resource();
     EQueue event_queue_;
 
+    std::vector<std::thread> workers_;
+    std::atomic<bool> running_{false};
+    std::atomic<DispatchPolicy> policy_{DispatchPolicy::Serialized};
+    std::atomic<HandlerMetrics*> metrics_{nullptr};
+
+    Partitioner partitioner_;
+    std::unique_ptr<Partition[]> partitions_;
+    size_t partition_count_ = 0;
+    // Held to replace lanes_ and reactor_, not to use them. Waking
+    // them must not take lock_, which stop() holds while joining.
+    std::mutex wake_lock_;
+    std::vector<std::unique_ptr<Lane>> lanes_;
+    bool routing_ = false;  // changed only with every partition locked
+
+    std::chrono::steady_clock::duration rebalance_interval_{0};
+    std::atomic<std::chrono::steady_clock::rep> next_rebalance_{0};
+
+    ////////////////////////////////////////////////////////////
+    // Timers run on whichever thread drives the controller:
+    // workers wait for events only until the next timer is due,
+    // call() and the reactor loop check them on every round.
+    // timer_run_lock_ lets one thread run them at a time.
+    ////////////////////////////////////////////////////////////
+    struct Timer {
+        size_t id;
+        std::chrono::steady_clock::duration period;
+        TimePoint next;
+        TimerTask task;
+        bool removed = false;
+    };
+
+    std::mutex timer_lock_;
+    std::recursive_mutex timer_run_lock_;
+    std::vector<std::shared_ptr<Timer>> timers_;
+    size_t next_timer_id_ = 0;
+    std::atomic<typename TimePoint::rep> next_timer_{
+        TimePoint::max().time_since_epoch().count()};
+
+#ifdef __linux__
+    std::unique_ptr<Reactor> reactor_;
+    std::vector<Data> reactor_batch_;
+    std::atomic<bool> reactor_stop_{false};  // taken by the loop on exit
+    std::atomic<bool> reactor_sleeping_{false};
+
+    Reactor* getReactor_() {
+        std::lock_guard lock(wake_lock_);
+        if (!reactor_) reactor_ = std::make_unique<Reactor>();
+        return reactor_.get();
+    }
+
+    // Milliseconds the reactor may sleep before the next timer.
+    int timeout_() const {
+        TimePoint next = nextTimer_();
+        if (next == TimePoint::max()) return -1;
+
+        auto left = std::chrono::ceil<std::chrono::milliseconds>(
+            next - TimePoint::clock::now());
+        return int(std::max<int64_t>(left.count(), 0));
+    }
+#endif
+
+    // Wakes the reactor loop if it sleeps in epoll_wait.
+    void notify_() {
+#ifdef __linux__
+        if (reactor_sleeping_.load(std::memory_order_seq_cst) &&
+            reactor_sleeping_.exchange(false, std::memory_order_seq_cst))
+            reactor_->wake();
+#endif
+    }
+
+    void dispatchUntimed_(const Data& data) {
+        Container* handlers = handlers_.load(std::memory_order_relaxed);
+        if (policy_.load(std::memory_order_relaxed) ==
+            DispatchPolicy::Serialized)
+            handlers->call(data);
+        else
+            handlers->callConcurrent(data);
+    }
+
+    void dispatch_(const Data& data) {
+        HandlerMetrics* metrics = metrics_.load(std::memory_order_relaxed);
+        if (metrics == nullptr || !metrics->count())
+            return dispatchUntimed_(data);
+
+        uint64_t begin = MetricsClock::now();
+        dispatchUntimed_(data);
+        metrics->record(MetricsClock::now() - begin);
+    }
+
+    TimePoint nextTimer_() const {
+        return TimePoint(typename TimePoint::duration(
+            next_timer_.load(std::memory_order_acquire)));
+    }
+
+    // Runs the due timers unless another thread is running them.
+    void runTimers_() {
+        if (nextTimer_() == TimePoint::max()) return;
+
+        TimePoint now = TimePoint::clock::now();
+        if (now < nextTimer_()) return;
+
+        std::unique_lock run_lock(timer_run_lock_, std::try_to_lock);
+        if (!run_lock.owns_lock()) return;
+
+        std::vector<std::shared_ptr<Timer>> due;
+        {
+            std::lock_guard lock(timer_lock_);
+            for (auto& el : timers_)
+                if (el->next <= now) {
+                    due.push_back(el);
+                    el->next += el->period;
+                    if (el->next <= now) el->next = now + el->period;
+                }
+            updateNextTimer_();
+        }
+
+        for (auto& el : due)
+            if (!el->removed) el->task();
+    }
+
+    // timer_lock_ must be held.
+    void updateNextTimer_() {
+        TimePoint next = TimePoint::max();
+        for (auto& el : timers_) next = std::min(next, el->next);
+        next_timer_.store(next.time_since_epoch().count(),
+                          std::memory_order_release);
+    }
+
+    // Lets sleeping workers and the reactor pick up a new timer.
+    void wakeTimers_() {
+        std::lock_guard lock(wake_lock_);
+        event_queue_.wake();
+        for (auto& el : lanes_) el->wake();
+#ifdef __linux__
+        if (reactor_) reactor_->wake();
+#endif
+    }
+
+    void work_() {
+        Data data;
+
+        while (running_.load(std::memory_order_acquire)) {
+            runTimers_();
+            // A wake() may return on an empty queue that is filled and
+            // closed right after, it is left once closed and drained.
+            if (event_queue_.waitEvent(&data, nextTimer_()))
+                dispatch_(data);
+            else if (event_queue_.isClosed() && event_queue_.empty())
+                break;
+        }
+    }
+
+    void workLane_(size_t lane) {
+        Routed routed;
+        size_t counter = 0;
+
+        while (running_.load(std::memory_order_acquire)) {
+            runTimers_();
+            if (!lanes_[lane]->waitEvent(&routed, nextTimer_())) {
+                if (lanes_[lane]->isClosed() && lanes_[lane]->empty()) break;
+                continue;
+            }
+
+            dispatch_(routed.data);
+            partitions_[routed.partition].pending.fetch_sub(
+                1, std::memory_order_release);
+
+            if (++counter % rebalance_check_period == 0) checkRebalance_();
+        }
+    }
+
+    void checkRebalance_() {
+        if (rebalance_interval_.count() == 0) return;
+
+        auto now  = std::chrono::steady_clock::now().time_since_epoch().count();
+        auto next = next_rebalance_.load(std::memory_order_relaxed);
+        if (now < next ||
+            !next_rebalance_.compare_exchange_strong(
+                next, now + rebalance_interval_.count()))
+            return;
+
+        rebalance();
+    }
+
+    void lockPartitions_() {
+        for (size_t i = 0; i < partition_count_; ++i) partitions_[i].lock.lock();
+    }
+
+    void unlockPartitions_() {
+        for (size_t i = 0; i < partition_count_; ++i)
+            partitions_[i].lock.unlock();
+    }
+
+    // Partition lock must be held.
+    void routeLocked_(size_t partition, const Data& data,
+                      TimePoint deadline = TimePoint::max(),
+                      TimePoint enqueued = TimePoint()) {
+        if (!routing_) return event_queue_.push(data, deadline, enqueued);
+
+        Partition& current = partitions_[partition];
+        current.pending.fetch_add(1, std::memory_order_relaxed);
+        current.load.fetch_add(1, std::memory_order_relaxed);
+        lanes_[current.lane.load(std::memory_order_relaxed)]->push(
+            {partition, data}, deadline, enqueued);
+    }
+
+    void route_(const Data& data, TimePoint deadline = TimePoint::max()) {
+        size_t partition = partitioner_(data) % partition_count_;
+
+        std::lock_guard lock(partitions_[partition].lock);
+        routeLocked_(partition, data, deadline);
+    }
+
+    // Lanes order events like the controller queue. Events expiring
+    // in a lane are handed to the controller queue, which drops or
+    // diverts them and counts them in its statistics.
+    std::unique_ptr<Lane> makeLane_() {
+        auto lane = std::make_unique<Lane>(resource_);
+        lane->setMode(event_queue_.getMode());
+        lane->setDelayStats(event_queue_.hasDelayStats());
+        if (event_queue_.getExpiredPolicy() != ExpiredPolicy::Keep)
+            lane->setExpiredPolicy(
+                ExpiredPolicy::Divert, [this](const Routed& routed) {
+                    partitions_[routed.partition].pending.fetch_sub(
+                        1, std::memory_order_release);
+                    event_queue_.expire(routed.data);
+                });
+        return lane;
+    }
+
+    void startPartitioned_(size_t thread_count) {
+        {
+            std::lock_guard wake_lock(wake_lock_);
+            lanes_.clear();
+            for (size_t i = 0; i < thread_count; ++i)
+                lanes_.push_back(makeLane_());
+        }
+
+        lockPartitions_();
+        for (size_t i = 0; i < partition_count_; ++i) {
+            partitions_[i].lane    = i % thread_count;
+            partitions_[i].pending = 0;
+            partitions_[i].load    = 0;
+        }
+
+        routing_ = true;
+        Data data;
+        TimePoint deadline, enqueued;
+        while (event_queue_.moveEvent(&data, &deadline, &enqueued))
+            routeLocked_(partitioner_(data) % partition_count_, data,
+                         deadline, enqueued);
+        unlockPartitions_();
+
+        for (size_t i = 0; i < thread_count; ++i)
+            workers_.emplace_back([this, i]() { workLane_(i); });
+    }
+
+    // Events pushed once routing stopped, also by handlers of the
+    // draining workers, go to the controller queue. What is left in
+    // the lanes is moved back in front of them.
+    void stopPartitioned_(bool drain) {
+        lockPartitions_();
+        routing_ = false;
+        unlockPartitions_();
+
+        if (!drain) running_ = false;
+        for (auto& el : lanes_) el->close();
+        for (auto& el : workers_) el.join();
+        workers_.clear();
+
+        EQueue pushed(resource_);
+        pushed.splice(event_queue_);
+
+        Routed routed;
+        TimePoint deadline, enqueued;
+        for (auto& el : lanes_)
+            while (el->moveEvent(&routed, &deadline, &enqueued))
+                event_queue_.push(routed.data, deadline, enqueued);
+        event_queue_.splice(pushed);
+
+        std::lock_guard wake_lock(wake_lock_);
+        for (auto& el : lanes_)
+            event_queue_.mergeDelayStats(el->getDelayHistogram());
+        lanes_.clear();
+    }
+
  public:
     ControllerBase() = default;
-    ~ControllerBase() {}
+
+    /// Queue entries and partition lanes are allocated from
+    /// resource, e.g. NodePoolResource::getInstance().
+    explicit ControllerBase(std::pmr::memory_resource* resource)
+        : resource_(resource), event_queue_(resource) {}
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Queues events in an arena of arena_size bytes
+    /// owned by the controller. The arena is reset every time
+    /// the queue runs empty, so after each call() that drained
+    /// it, and only goes to the heap for the part of a burst
+    /// that does not fit.
+    ////////////////////////////////////////////////////////////
+    explicit ControllerBase(size_t arena_size)
+        : arena_(std::make_unique<ArenaResource>(arena_size)),
+          event_queue_(arena_.get()) {}
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Stops the workers. The members of a derived class
+    /// are destroyed before, so a derived class whose handlers,
+    /// timers or process() use them must call stop() in its
+    /// own destructor.
+    ////////////////////////////////////////////////////////////
+    virtual ~ControllerBase() { stop(); }
 
     void loadEvents(EQueue* event_queue) {
-        event_queue_.splice(*event_queue);
+        if (policy_.load(std::memory_order_relaxed) !=
+            DispatchPolicy::Partitioned) {
+            event_queue_.splice(*event_queue);
+            return notify_();
+        }
+
+        Data data;
+        while (event_queue->pollEvent(&data)) route_(data);
+    }
+
+#ifdef __linux__
+    /// Moves the events available in a queue shared with
+    /// another process into the controller.
+    void loadEvents(SharedQueue<Data>* queue) {
+        Data batch[shared_batch_size];
+        while (size_t count = queue->pollEvents(batch, shared_batch_size))
+            for (size_t i = 0; i < count; ++i) push(batch[i]);
+    }
+#endif
+
+    void push(const Data& data) { push(data, TimePoint::max()); }
+
+    /// Pushes an event that should be dispatched before deadline,
+    /// see EventQueue::setMode() and EventQueue::setExpiredPolicy().
+    void push(const Data& data, TimePoint deadline) {
+        if (policy_.load(std::memory_order_relaxed) ==
+            DispatchPolicy::Partitioned)
+            return route_(data, deadline);
+
+        event_queue_.push(data, deadline);
+        notify_();
+    }
+
+    /// Queue of the controller, used to set its mode, expired
+    /// policy and delay statistics. Partitioned dispatch copies
+    /// these settings into its lanes on start().
+    EQueue* getEventQueue() { return &event_queue_; }
+
+    /// Delay statistics of the controller queue, including the
+    /// lanes of partitioned dispatch.
+    QueueDelayStats getDelayStats() {
+        std::lock_guard wake_lock(wake_lock_);
+
+        QueueDelayStats queue = event_queue_.getDelayStats();
+        Histogram delay       = event_queue_.getDelayHistogram();
+        for (auto& el : lanes_) delay.merge(el->getDelayHistogram());
+        return QueueDelayStats::of(delay, queue.dropped, queue.diverted);
+    }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Dispatches events to list instead of the list of
+    /// the controller, e.g. to an IndexedHandlerList. list must
+    /// outlive the controller, nullptr goes back to its own
+    /// list. Must be called while nothing is dispatched.
+    ////////////////////////////////////////////////////////////
+    void setHandlerList(Container* list) {
+        handlers_ = list != nullptr ? list : &handler_list_;
+    }
+
+    Container* getHandlerList() { return handlers_; }
+
+    /// Diverts expired events of the controller queue to list.
+    void setDeadLetter(Container* list) {
+        event_queue_.setExpiredPolicy(
+            ExpiredPolicy::Divert, [list](const Data& data) { list->call(data); });
+    }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Exports the queue counters and the time spent
+    /// dispatching every event through MetricsRegistry under
+    /// name. Handlers are timed separately, see
+    /// HandlerBase::setMetrics().
+    ////////////////////////////////////////////////////////////
+    void setMetrics(const std::string& name) {
+        event_queue_.setMetrics(name);
+        metrics_ = MetricsRegistry::getInstance()->getHandlerMetrics(name);
+    }
+
+    void clearMetrics() {
+        event_queue_.clearMetrics();
+        metrics_ = nullptr;
     }
 
     void call() {
         Data data;
 
         while(event_queue_.pollEvent(&data))
-            handler_list_.call(data);
+            dispatch_(data);
+        runTimers_();
+    }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Runs task every period, first one period from
+    /// now. Timers fire on the workers, in call() or in the
+    /// reactor loop, so a controller nobody drives never runs
+    /// them. Returns the id for removeTimer().
+    ////////////////////////////////////////////////////////////
+    size_t addTimer(std::chrono::steady_clock::duration period,
+                    TimerTask&& task) {
+        auto timer    = std::make_shared<Timer>();
+        timer->period = period;
+        timer->next   = TimePoint::clock::now() + period;
+        timer->task   = std::move(task);
+
+        bool earlier;
+        {
+            std::lock_guard lock(timer_lock_);
+            timer->id = ++next_timer_id_;
+            timers_.push_back(timer);
+            earlier = timer->next < nextTimer_();
+            updateNextTimer_();
+        }
+
+        if (earlier) wakeTimers_();
+        return timer->id;
+    }
+
+    /// Once it returns the task is not running and never runs
+    /// again, it may be called from a timer task.
+    bool removeTimer(size_t id) {
+        std::lock_guard run_lock(timer_run_lock_);
+        std::lock_guard lock(timer_lock_);
+
+        for (auto it = timers_.begin(); it != timers_.end(); ++it)
+            if ((*it)->id == id) {
+                (*it)->removed = true;
+                timers_.erase(it);
+                updateNextTimer_();
+                return true;
+            }
+        return false;
+    }
+
+    /// Throws std::logic_error while the controller is running,
+    /// and for DispatchPolicy::Partitioned before
+    /// setPartitioner().
+    void setPolicy(DispatchPolicy policy) {
+        std::lock_guard lock(lock_);
+        if (running_)
+            throw std::logic_error(
+                "ec::ControllerBase policy changed while running");
+        if (policy == DispatchPolicy::Partitioned && !partitions_)
+            throw std::logic_error(
+                "ec::ControllerBase partitioned dispatch without a "
+                "partitioner");
+        policy_ = policy;
+    }
+
+    DispatchPolicy getPolicy() const { return policy_; }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Partitions for DispatchPolicy::Partitioned, which
+    /// is then chosen with setPolicy(). key returns the hash of
+    /// the entity an event belongs to, events are spread over
+    /// partition_count partitions that are assigned to worker
+    /// lanes. Throws std::logic_error while running.
+    ////////////////////////////////////////////////////////////
+    void setPartitioner(Partitioner key, size_t partition_count = 1024) {
+        std::lock_guard lock(lock_);
+        if (running_)
+            throw std::logic_error(
+                "ec::ControllerBase partitioner changed while running");
+
+        partitioner_     = std::move(key);
+        partition_count_ = std::max<size_t>(partition_count, 1);
+        partitions_.reset(new Partition[partition_count_]);
+    }
+
+    /// Interval of automatic rebalancing by the workers, zero
+    /// turns it off. Must be called while stopped.
+    void setRebalanceInterval(std::chrono::steady_clock::duration interval) {
+        rebalance_interval_ = interval;
+    }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Moves idle partitions from the most to the least
+    /// loaded lane, judging by events routed since the previous
+    /// rebalance. Returns false if the controller is busy
+    /// starting or stopping.
+    ////////////////////////////////////////////////////////////
+    bool rebalance() {
+        std::unique_lock lock(lock_, std::try_to_lock);
+        if (!lock.owns_lock()) return false;
+
+        size_t lane_count = lanes_.size();
+        if (!running_ || lane_count < 2) return true;
+
+        std::vector<size_t> lane_load(lane_count, 0);
+        std::vector<size_t> partition_load(partition_count_);
+        for (size_t i = 0; i < partition_count_; ++i) {
+            partition_load[i] = partitions_[i].load.exchange(0);
+            lane_load[partitions_[i].lane.load()] += partition_load[i];
+        }
+
+        // Every round moves load from the hottest lane to the coldest one.
+        for (size_t round = 1; round < lane_count; ++round) {
+            auto bounds = std::minmax_element(lane_load.begin(), lane_load.end());
+            size_t cold = bounds.first - lane_load.begin();
+            size_t hot  = bounds.second - lane_load.begin();
+            if (lane_load[hot] * 4 <= lane_load[cold] * 5) break;
+
+            std::vector<size_t> candidates;
+            for (size_t i = 0; i < partition_count_; ++i)
+                if (partitions_[i].lane.load() == hot && partition_load[i] != 0)
+                    candidates.push_back(i);
+            std::sort(candidates.begin(), candidates.end(),
+                      [&partition_load](size_t lhs, size_t rhs) {
+                          return partition_load[lhs] > partition_load[rhs];
+                      });
+
+            bool moved = false;
+            for (auto el : candidates) {
+                size_t load = partition_load[el];
+                if (lane_load[hot] - load < lane_load[cold] + load) continue;
+
+                Partition& partition = partitions_[el];
+                std::lock_guard partition_lock(partition.lock);
+                if (partition.pending.load(std::memory_order_acquire) != 0)
+                    continue;
+
+                partition.lane.store(cold, std::memory_order_relaxed);
+                lane_load[hot] -= load;
+                lane_load[cold] += load;
+                moved = true;
+            }
+            if (!moved) break;
+        }
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Starts thread_count workers that dispatch events
+    /// of the queue until stop() is called.
+    ////////////////////////////////////////////////////////////
+    void start(size_t thread_count) {
+        std::lock_guard lock(lock_);
+        if (running_) return;
+
+        event_queue_.open();
+        running_ = true;
+
+        if (policy_ == DispatchPolicy::Partitioned)
+            return startPartitioned_(std::max<size_t>(thread_count, 1));
+
+        for (size_t i = 0; i < thread_count; ++i)
+            workers_.emplace_back([this]() { work_(); });
+    }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Stops the workers. With drain set they finish
+    /// every queued event first, otherwise they leave after the
+    /// events they are dispatching and the rest stays queued.
+    ////////////////////////////////////////////////////////////
+    void stop(bool drain = true) {
+        std::lock_guard lock(lock_);
+        if (!running_) return;
+
+        if (!lanes_.empty()) {
+            stopPartitioned_(drain);
+            running_ = false;
+            return;
+        }
+
+        if (!drain) running_ = false;
+        event_queue_.close();
+
+        for (auto& el : workers_) el.join();
+        workers_.clear();
+        running_ = false;
+    }
+
+    bool isRunning() const { return running_; }
+
+#ifdef __linux__
+    ////////////////////////////////////////////////////////////
+    /// \brief Watches fd in the reactor. When it gets ready
+    /// the reader is called on the reactor thread and the
+    /// events it produced are dispatched right there.
+    ////////////////////////////////////////////////////////////
+    void watch(int fd, uint32_t events, Reader reader) {
+        getReactor_()->watch(
+            fd, events, [this, reader = std::move(reader)](int fd,
+                                                           uint32_t events) {
+                reader(fd, events, &reactor_batch_);
+            });
+    }
+
+    void unwatch(int fd) { getReactor_()->unwatch(fd); }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Runs the reactor loop on the calling thread until
+    /// stopReactor(). The loop dispatches events of watched
+    /// descriptors and of the controller queue, push() from
+    /// other threads wakes it through an eventfd.
+    ////////////////////////////////////////////////////////////
+    void runReactor() {
+        Reactor* reactor = getReactor_();
+
+        Data data;
+        while (!reactor_stop_.load(std::memory_order_acquire)) {
+            while (event_queue_.pollEvent(&data)) dispatch_(data);
+            runTimers_();
+
+            reactor_sleeping_.store(true, std::memory_order_seq_cst);
+            bool idle = event_queue_.empty() &&
+                        !reactor_stop_.load(std::memory_order_acquire);
+            reactor->poll(idle ? timeout_() : 0);
+            reactor_sleeping_.store(false, std::memory_order_relaxed);
+
+            for (auto& el : reactor_batch_) dispatch_(el);
+            reactor_batch_.clear();
+        }
+        reactor_stop_.store(false, std::memory_order_relaxed);
+    }
+
+    /// Makes the running reactor loop return. Called before the
+    /// loop started, the next runReactor() returns right away.
+    void stopReactor() {
+        reactor_stop_.store(true, std::memory_order_release);
+        getReactor_()->wake();
     }
+#endif
 
     virtual void process() = 0;
 };
 
 }  // namespace ec
 
-#endif
\ No newline at end of file
+#endif
@@ -1,71 +1,591 @@
 #ifndef _TMBEL_EVENT_QUEUE_HPP_
 #define _TMBEL_EVENT_QUEUE_HPP_
 
+#include <TMBEL/histogram.hpp>
+#include <TMBEL/memory_resource.hpp>
+#include <TMBEL/metrics.hpp>
+#include <TMBEL/tracing.hpp>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <list>
+#include <memory_resource>
 #include <mutex>
+#include <string>
+#include <vector>
 
 namespace ec {
 
+////////////////////////////////////////////////////////////
+/// \brief Order in which EventQueue gives out events.
+////////////////////////////////////////////////////////////
+enum class QueueMode {
+    Fifo,     ///< Push order.
+    Deadline  ///< Earliest deadline first, events without one go last.
+};
+
+////////////////////////////////////////////////////////////
+/// \brief What EventQueue does with events whose deadline
+/// passed before they were taken out.
+////////////////////////////////////////////////////////////
+enum class ExpiredPolicy {
+    Keep,   ///< Give them out as usual.
+    Drop,   ///< Discard them.
+    Divert  ///< Pass them to the expired callback instead.
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Time events spent in a queue, in nanoseconds.
+////////////////////////////////////////////////////////////
+struct QueueDelayStats {
+    uint64_t count    = 0;
+    uint64_t dropped  = 0;
+    uint64_t diverted = 0;
+    uint64_t p50      = 0;
+    uint64_t p90      = 0;
+    uint64_t p99      = 0;
+    uint64_t p999     = 0;
+    uint64_t max      = 0;
+
+    static QueueDelayStats of(const Histogram& delay, uint64_t dropped,
+                              uint64_t diverted) {
+        QueueDelayStats result;
+        result.count    = delay.count();
+        result.dropped  = dropped;
+        result.diverted = diverted;
+        result.p50      = delay.percentile(0.5);
+        result.p90      = delay.percentile(0.9);
+        result.p99      = delay.percentile(0.99);
+        result.p999     = delay.percentile(0.999);
+        result.max      = delay.max();
+        return result;
+    }
+};
+
 ////////////////////////////////////////////////////////////
 /// \brief Class that contains events and helps to operate
 /// with it.
+///
+/// Events are only timestamped when the queue needs it: in
+/// deadline mode, with an expired policy other than Keep, or
+/// with delay statistics turned on.
+///
+/// Entries are allocated from the memory resource given on
+/// construction. A queue built on an ArenaResource releases
+/// the arena every time it runs empty, so a queue that is
+/// drained between bursts never reaches the upstream
+/// allocator once the burst fits the initial buffer.
 ////////////////////////////////////////////////////////////
 template <typename Data>
 class EventQueue {
+ public:
+    using Clock     = std::chrono::steady_clock;
+    using TimePoint = Clock::time_point;
+    using Expired   = std::function<void(const Data&)>;
+
  protected:
-    using Self      = EventQueue<Data>;
-    using Container = std::list<Data>;
+    using Self = EventQueue<Data>;
+
+    struct Entry {
+        Data data;
+        TimePoint enqueued;
+        TimePoint deadline;
+        uint64_t sequence;
+        uint64_t event;  // trace correlation id, zero when untraced
+    };
+
+    // Heap comparator, the top is the earliest deadline.
+    struct Later {
+        bool operator()(const Entry& lhs, const Entry& rhs) const {
+            if (lhs.deadline != rhs.deadline) return lhs.deadline > rhs.deadline;
+            return lhs.sequence > rhs.sequence;
+        }
+    };
+
+    using Container = std::pmr::list<Entry>;
+    using Heap      = std::pmr::vector<Entry>;
     using Position  = typename Container::iterator;
 
     std::mutex lock_;
+    std::condition_variable wait_;
+    ArenaResource* arena_ = nullptr;
     Container resource_;
+    Heap heap_;
+    size_t waiters_   = 0;
+    uint64_t wakeups_ = 0;
+    bool closed_      = false;
+
+    QueueMode mode_               = QueueMode::Fifo;
+    ExpiredPolicy expired_policy_ = ExpiredPolicy::Keep;
+    Expired expired_;
+    bool timed_        = false;
+    bool delay_stats_  = false;
+    uint64_t sequence_ = 0;
+
+    Histogram delay_;
+    uint64_t dropped_  = 0;
+    uint64_t diverted_ = 0;
+
+    uint64_t enqueued_ = 0;
+    uint64_t dequeued_ = 0;
+    bool watched_      = false;
+    MetricsRegistry::Position metrics_position_ = 0;
+
+    void updateTimed_() {
+        timed_ = mode_ == QueueMode::Deadline ||
+                 expired_policy_ != ExpiredPolicy::Keep || delay_stats_;
+    }
+
+    bool empty_() const {
+        return mode_ == QueueMode::Fifo ? resource_.empty() : heap_.empty();
+    }
+
+    size_t size_() const {
+        return mode_ == QueueMode::Fifo ? resource_.size() : heap_.size();
+    }
+
+    // Called once the queue ran empty, nothing allocated is alive then.
+    void drained_() {
+        if (arena_ == nullptr) return;
+
+        Heap(heap_.get_allocator()).swap(heap_);
+        arena_->release();
+    }
+
+    uint64_t traceEnqueue_() {
+        if (!Tracer::enabled()) return 0;
+
+        uint64_t event = Tracer::newEvent();
+        Tracer::record(TraceKind::Enqueue, event, this);
+        return event;
+    }
+
+    // enqueued is kept for events moved from another queue.
+    void push_(const Data& data, TimePoint deadline, uint64_t event,
+               TimePoint enqueued = TimePoint()) {
+        TimePoint now = enqueued;
+        if (now == TimePoint() && timed_) now = Clock::now();
+        ++enqueued_;
+
+        if (mode_ == QueueMode::Fifo) {
+            resource_.push_back({data, now, deadline, 0, event});
+        } else {
+            heap_.push_back({data, now, deadline, sequence_++, event});
+            std::push_heap(heap_.begin(), heap_.end(), Later());
+        }
+    }
+
+    Entry& front_() {
+        return mode_ == QueueMode::Fifo ? resource_.front() : heap_.front();
+    }
+
+    void popFront_() {
+        if (mode_ == QueueMode::Fifo) {
+            resource_.pop_front();
+        } else {
+            std::pop_heap(heap_.begin(), heap_.end(), Later());
+            heap_.pop_back();
+        }
+    }
+
+    // Takes the next live event, moving expired ones into diverted.
+    bool take_(Data* data, std::vector<Data>* diverted) {
+        TimePoint now = timed_ ? Clock::now() : TimePoint();
+
+        while (!empty_()) {
+            Entry& entry = front_();
+
+            if (expired_policy_ != ExpiredPolicy::Keep && entry.deadline < now) {
+                if (expired_policy_ == ExpiredPolicy::Divert && expired_) {
+                    diverted->push_back(std::move(entry.data));
+                    ++diverted_;
+                } else {
+                    ++dropped_;
+                }
+                popFront_();
+                continue;
+            }
+
+            // Events pushed before timing was on carry no stamp.
+            if (delay_stats_ && entry.enqueued != TimePoint())
+                delay_.record(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        now - entry.enqueued)
+                        .count());
+
+            if (Tracer::enabled()) {
+                if (entry.event != 0)
+                    Tracer::record(TraceKind::Dequeue, entry.event, this);
+                Tracer::setCurrent(entry.event);
+            }
+
+            *data = std::move(entry.data);
+            popFront_();
+            ++dequeued_;
+            if (empty_()) drained_();
+            return true;
+        }
+        drained_();
+        return false;
+    }
+
+    static void divert_(const Expired& expired, std::vector<Data>& diverted) {
+        for (auto& el : diverted) expired(el);
+    }
 
  public:
-    EventQueue()                  = default;
+    EventQueue() = default;
+
+    /// Entries come from resource, which has to outlive the
+    /// queue.
+    explicit EventQueue(std::pmr::memory_resource* resource)
+        : resource_(resource), heap_(resource) {}
+
+    /// Entries come from arena, which is released whenever the
+    /// queue runs empty. The arena must outlive the queue and
+    /// must not be shared.
+    explicit EventQueue(ArenaResource* arena)
+        : arena_(arena), resource_(arena), heap_(arena) {}
+
     EventQueue(const Self&) = delete;
     EventQueue(Self&& other) { *this = std::move(other); }
-    ~EventQueue() { std::lock_guard lock(lock_); }
+    ~EventQueue() {
+        clearMetrics();
+        std::lock_guard lock(lock_);
+    }
 
     Self& operator=(Self&& other) {
         other.lock_.lock();
         this->lock_.lock();
 
         resource_ = std::move(other.resource_);
+        heap_     = std::move(other.heap_);
+        mode_     = other.mode_;
 
         this->lock_.unlock();
         other.lock_.unlock();
+
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Switches the order of events, events already in
+    /// the queue are reordered.
+    ////////////////////////////////////////////////////////////
+    void setMode(QueueMode mode) {
+        std::lock_guard lock(lock_);
+        if (mode == mode_) return;
+
+        if (mode == QueueMode::Deadline) {
+            for (auto& el : resource_) {
+                el.sequence = sequence_++;
+                heap_.push_back(std::move(el));
+            }
+            resource_.clear();
+            std::make_heap(heap_.begin(), heap_.end(), Later());
+        } else {
+            std::sort_heap(heap_.begin(), heap_.end(), Later());
+            for (auto el = heap_.rbegin(); el != heap_.rend(); ++el)
+                resource_.push_back(std::move(*el));
+            heap_.clear();
+        }
+
+        mode_ = mode;
+        updateTimed_();
+    }
+
+    QueueMode getMode() {
+        std::lock_guard lock(lock_);
+        return mode_;
+    }
+
+    /// expired is called outside of the queue lock by the
+    /// thread that takes events out.
+    void setExpiredPolicy(ExpiredPolicy policy, Expired expired = nullptr) {
+        std::lock_guard lock(lock_);
+        expired_policy_ = policy;
+        expired_        = std::move(expired);
+        updateTimed_();
+    }
+
+    void setDelayStats(bool enabled) {
+        std::lock_guard lock(lock_);
+        delay_stats_ = enabled;
+        updateTimed_();
+    }
+
+    bool hasDelayStats() {
+        std::lock_guard lock(lock_);
+        return delay_stats_;
+    }
+
+    ExpiredPolicy getExpiredPolicy() {
+        std::lock_guard lock(lock_);
+        return expired_policy_;
+    }
+
+    QueueDelayStats getDelayStats() {
+        std::lock_guard lock(lock_);
+        return QueueDelayStats::of(delay_, dropped_, diverted_);
+    }
+
+    Histogram getDelayHistogram() {
+        std::lock_guard lock(lock_);
+        return delay_;
+    }
+
+    /// Adds the delays recorded by another queue, e.g. one the
+    /// events were moved to.
+    void mergeDelayStats(const Histogram& delay) {
+        std::lock_guard lock(lock_);
+        delay_.merge(delay);
+    }
+
+    void resetDelayStats() {
+        std::lock_guard lock(lock_);
+        delay_.clear();
+        dropped_  = 0;
+        diverted_ = 0;
+    }
+
+    QueueCounters getCounters() {
+        std::lock_guard lock(lock_);
+
+        QueueCounters result;
+        result.depth    = size_();
+        result.enqueued = enqueued_;
+        result.dequeued = dequeued_;
+        return result;
+    }
+
+    /// Exports the counters through MetricsRegistry under name
+    /// until clearMetrics() or destruction.
+    void setMetrics(const std::string& name) {
+        clearMetrics();
+        auto position = MetricsRegistry::getInstance()->watchQueue(
+            name, [this]() { return getCounters(); });
+
+        std::lock_guard lock(lock_);
+        metrics_position_ = position;
+        watched_          = true;
+    }
+
+    void clearMetrics() {
+        MetricsRegistry::Position position;
+        {
+            std::lock_guard lock(lock_);
+            if (!watched_) return;
+            position = metrics_position_;
+            watched_ = false;
+        }
+        MetricsRegistry::getInstance()->unwatchQueue(position);
     }
 
     bool pollEvent(Data* data) {
+        std::vector<Data> diverted;
+        Expired expired;
+        bool result;
+        {
+            std::lock_guard lock(lock_);
+            result = take_(data, &diverted);
+            if (!diverted.empty()) expired = expired_;
+        }
+
+        divert_(expired, diverted);
+        return result;
+    }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Takes the next event out with its deadline and
+    /// enqueue time, to move it into another queue. It is
+    /// neither expired nor counted in the delay statistics.
+    ////////////////////////////////////////////////////////////
+    bool moveEvent(Data* data, TimePoint* deadline, TimePoint* enqueued) {
         std::lock_guard lock(lock_);
-        if (resource_.empty()) return false;
+        if (empty_()) return false;
 
-        *data = resource_.front();
-        resource_.pop_front();
+        Entry& entry = front_();
+        *data        = std::move(entry.data);
+        *deadline    = entry.deadline;
+        *enqueued    = entry.enqueued;
+        popFront_();
+        ++dequeued_;
+        if (empty_()) drained_();
         return true;
     }
 
+    ////////////////////////////////////////////////////////////
+    /// \brief Applies the expired policy to an event that
+    /// expired in another queue it was moved to: counts it as
+    /// dropped or passes it to the expired callback.
+    ////////////////////////////////////////////////////////////
+    void expire(const Data& data) {
+        Expired expired;
+        {
+            std::lock_guard lock(lock_);
+            if (expired_policy_ == ExpiredPolicy::Divert && expired_) {
+                ++diverted_;
+                expired = expired_;
+            } else {
+                ++dropped_;
+            }
+        }
+        if (expired) expired(data);
+    }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Blocks until an event arrives. Returns false once
+    /// the queue is closed and empty.
+    ////////////////////////////////////////////////////////////
+    bool waitEvent(Data* data) {
+        std::vector<Data> diverted;
+        Expired expired;
+        bool result = false;
+        {
+            std::unique_lock lock(lock_);
+
+            ++waiters_;
+            while (true) {
+                wait_.wait(lock, [this]() { return !empty_() || closed_; });
+                if (take_(data, &diverted)) {
+                    result = true;
+                    break;
+                }
+                if (closed_) break;
+            }
+            --waiters_;
+            if (!diverted.empty()) expired = expired_;
+        }
+
+        divert_(expired, diverted);
+        return result;
+    }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Like waitEvent(), but also gives up at until or
+    /// when wake() is called.
+    ////////////////////////////////////////////////////////////
+    bool waitEvent(Data* data, TimePoint until) {
+        if (until == TimePoint::max()) return waitEvent(data);
+
+        std::vector<Data> diverted;
+        Expired expired;
+        bool result = false;
+        {
+            std::unique_lock lock(lock_);
+
+            ++waiters_;
+            uint64_t wakeups = wakeups_;
+            while (true) {
+                bool ready = wait_.wait_until(lock, until, [&]() {
+                    return !empty_() || closed_ || wakeups_ != wakeups;
+                });
+                if (take_(data, &diverted)) {
+                    result = true;
+                    break;
+                }
+                if (!ready || closed_ || wakeups_ != wakeups) break;
+            }
+            --waiters_;
+            if (!diverted.empty()) expired = expired_;
+        }
+
+        divert_(expired, diverted);
+        return result;
+    }
+
+    /// Makes the waiters of waitEvent(data, until) return.
+    void wake() {
+        std::lock_guard lock(lock_);
+        ++wakeups_;
+        if (waiters_ != 0) wait_.notify_all();
+    }
+
     void splice(Self& other) {
-        other.lock_.lock();
-        this->lock_.lock();
+        // Both orders are taken, e.g. to put events back in front.
+        std::scoped_lock lock(other.lock_, this->lock_);
 
-        resource_.splice(resource_.end(), other.resource_);
+        if (mode_ == QueueMode::Fifo && other.mode_ == QueueMode::Fifo &&
+            resource_.get_allocator() == other.resource_.get_allocator()) {
+            // Entries of a queue that did not time them count from now.
+            if (timed_ && !other.timed_) {
+                TimePoint now = Clock::now();
+                for (auto& el : other.resource_)
+                    if (el.enqueued == TimePoint()) el.enqueued = now;
+            }
+            enqueued_ += other.resource_.size();
+            resource_.splice(resource_.end(), other.resource_);
+        } else {
+            Data data;
+            TimePoint deadline, enqueued;
+            uint64_t event;
+            while (!other.empty_()) {
+                Entry& entry = other.front_();
+                deadline     = entry.deadline;
+                enqueued     = entry.enqueued;
+                event        = entry.event;
+                data         = std::move(entry.data);
+                other.popFront_();
+                push_(data, deadline, event, enqueued);
+            }
+            other.drained_();
+        }
+        if (waiters_ != 0) wait_.notify_all();
+    }
 
-        this->lock_.unlock();
-        other.lock_.unlock();
+    void push(const Data& data) { push(data, TimePoint::max()); }
+
+    void push(const Data& data, TimePoint deadline) {
+        std::lock_guard lock(lock_);
+        push_(data, deadline, traceEnqueue_());
+        if (waiters_ != 0) wait_.notify_one();
     }
 
-    void push(const Data& data) {
+    /// Pushes an event taken out with moveEvent(), keeping the
+    /// time it was first enqueued.
+    void push(const Data& data, TimePoint deadline, TimePoint enqueued) {
         std::lock_guard lock(lock_);
-        resource_.emplace_back(data);
+        push_(data, deadline, traceEnqueue_(), enqueued);
+        if (waiters_ != 0) wait_.notify_one();
     }
 
     void clear() {
         std::lock_guard lock(lock_);
         resource_.clear();
+        heap_.clear();
+        drained_();
+    }
+
+    /// Wakes every waiter, waitEvent() stops blocking once the
+    /// remaining events are drained.
+    void close() {
+        std::lock_guard lock(lock_);
+        closed_ = true;
+        wait_.notify_all();
+    }
+
+    void open() {
+        std::lock_guard lock(lock_);
+        closed_ = false;
+    }
+
+    bool isClosed() {
+        std::lock_guard lock(lock_);
+        return closed_;
+    }
+
+    bool empty() {
+        std::lock_guard lock(lock_);
+        return empty_();
+    }
+
+    size_t size() {
+        std::lock_guard lock(lock_);
+        return size_();
     }
 };
 
 }  // namespace ec
 
-#endif
\ No newline at end of file
+#endif
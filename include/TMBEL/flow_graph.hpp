@@ -0,0 +1,443 @@
+#ifndef _TMBEL_FLOW_GRAPH_HPP_
+#define _TMBEL_FLOW_GRAPH_HPP_
+
+#include <TMBEL/handler.hpp>
+#include <TMBEL/inplace_function.hpp>
+#include <TMBEL/payload.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <typeindex>
+#include <vector>
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+/// \brief How an edge of a FlowGraph delivers events.
+////////////////////////////////////////////////////////////
+enum class EdgeMode {
+    Auto,  ///< Async into blocking nodes, sync otherwise.
+    Sync,  ///< Called on the thread of the producing node.
+    Async  ///< Handed to a task of the consuming node.
+};
+
+class FlowGraph;
+
+////////////////////////////////////////////////////////////
+/// \brief Handle to a node of a FlowGraph whose output
+/// events are Ty (for sinks, their input).
+////////////////////////////////////////////////////////////
+template <typename Ty>
+class FlowNode {
+ protected:
+    friend class FlowGraph;
+
+    size_t id_ = SIZE_MAX;
+
+    explicit FlowNode(size_t id) : id_(id) {}
+
+ public:
+    using value_type = Ty;
+
+    FlowNode() = default;
+
+    size_t getId() const { return id_; }
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Builder and executor of a graph of sources,
+/// stages and sinks.
+///
+/// The topology is described first: sources, filter and map
+/// stages, existing Processors and ParserBase groups, merges
+/// for fan-in, sinks that are functions or existing
+/// handlers, and extra edges with connect(). Nodes with
+/// several outputs fan out. build() validates the graph,
+/// rejecting cycles and nodes without inputs, and compiles
+/// it:
+///
+/// - Auto edges become async when they lead into a node
+///   marked with setBlocking(), sync otherwise.
+/// - A sync edge that is the only output of its node and
+///   the only input of the next one is chained: the next
+///   stage is called directly instead of walking an output
+///   list. Every stage stays one indirect call.
+/// - Outputs are plain arrays fixed at build time, events
+///   cross the graph without locks, virtual handler calls or
+///   HandlerList iterations, except into and out of existing
+///   handlers, processors and parsers.
+///
+/// Every node with async inputs has one worker thread that
+/// takes copies of the events (Shared handles) in the order
+/// they were posted, so an async edge keeps the order of its
+/// producer thread. Posting blocks while setQueueCapacity()
+/// events wait for the worker. dump() prints the compiled
+/// plan. A built graph cannot change.
+////////////////////////////////////////////////////////////
+class FlowGraph {
+ public:
+    enum class Kind { Source, Filter, Map, Process, Parse, Group, Merge, Sink };
+
+    static constexpr size_t default_queue_capacity = 1024;
+
+ protected:
+    using Self = FlowGraph;
+
+    // Runs the async inputs of a node on one thread, in the order they
+    // were posted.
+    class Worker {
+     public:
+        using Task = InplaceFunction<void()>;
+
+     protected:
+        std::mutex lock_;
+        std::condition_variable ready_;  // tasks posted or closed
+        std::condition_variable done_;   // a task taken or finished
+        std::deque<Task> tasks_;
+        size_t capacity_;
+        bool busy_   = false;
+        bool closed_ = false;
+        std::thread thread_;
+
+        void run_();
+
+     public:
+        explicit Worker(size_t capacity);
+        ~Worker();
+
+        /// Blocks while capacity tasks wait.
+        void post(Task&& task);
+
+        /// Waits until every posted task ran.
+        void drain();
+    };
+
+    struct Step;
+
+    using Apply = InplaceFunction<void(const void* value, const Step& self)>;
+    using Post  = void (*)(const void* value, Step* target);
+
+    struct Edge {
+        Step* step;
+        EdgeMode mode;
+    };
+
+    struct Step {
+        std::string name;
+        Kind kind;
+        std::type_index type;  // of the output events, input for sinks
+        Apply apply;
+        Post post;  // copies an output event into a task of a target
+        bool blocking = false;
+
+        std::vector<size_t> inputs;
+        std::vector<EdgeMode> input_modes;
+
+        // Compiled
+        std::vector<Edge> outputs;
+        Step* next = nullptr;  // only successor, called directly
+        std::unique_ptr<Worker> worker;
+
+        Step(const std::string& name, Kind kind, std::type_index type)
+            : name(name), kind(kind), type(type) {}
+
+        void forward(const void* value) const {
+            if (next != nullptr) return next->apply(value, *next);
+
+            for (auto& el : outputs) {
+                if (el.mode == EdgeMode::Async)
+                    post(value, el.step);
+                else
+                    el.step->apply(value, *el.step);
+            }
+        }
+    };
+
+    template <typename Ty>
+    class Input : public Handler<Ty> {
+     protected:
+        Step* step_;
+
+     public:
+        explicit Input(Step* step) : step_(step) {}
+        ~Input() override { this->detach(); }
+
+        void call(const Ty& data) override { step_->apply(&data, *step_); }
+    };
+
+    // Attached to a processor, sends its results to the outputs of
+    // the node.
+    template <typename Ty>
+    class Output : public Handler<Ty> {
+     protected:
+        Step* step_;
+
+     public:
+        explicit Output(Step* step) : step_(step) {}
+        ~Output() override { this->detach(); }
+
+        void call(const Ty& data) override { step_->forward(&data); }
+    };
+
+    std::vector<std::unique_ptr<Step>> steps_;
+    std::vector<std::unique_ptr<HandlerBase>> inputs_;
+    std::vector<size_t> order_;  // topological, set by build()
+    size_t queue_capacity_ = default_queue_capacity;
+    bool built_            = false;
+
+    template <typename Ty>
+    static void post_(const void* value, Step* target) {
+        auto data = Shared<Ty>::make(*static_cast<const Ty*>(value));
+        target->worker->post(
+            [target, data]() { target->apply(data.get(), *target); });
+    }
+
+    static void forward_(const void* value, const Step& self) {
+        self.forward(value);
+    }
+
+    template <typename Ty>
+    Step* add_(const std::string& name, Kind kind, Apply&& apply) {
+        if (built_) throw std::logic_error("ec::FlowGraph is already built");
+
+        auto step   = std::make_unique<Step>(name, kind, typeid(Ty));
+        step->apply = std::move(apply);
+        step->post  = &post_<Ty>;
+        steps_.push_back(std::move(step));
+        return steps_.back().get();
+    }
+
+    template <typename Ty>
+    Step* step_(FlowNode<Ty> node) const {
+        if (node.id_ >= steps_.size() || steps_[node.id_]->type != typeid(Ty))
+            throw std::invalid_argument("ec::FlowGraph unknown node");
+        return steps_[node.id_].get();
+    }
+
+    void link_(size_t from, Step* to, EdgeMode mode);
+
+    void validate_();
+    void compile_();
+
+ public:
+    FlowGraph() = default;
+    FlowGraph(const Self&) = delete;
+    ~FlowGraph();
+
+    Self& operator=(const Self&) = delete;
+
+    /// Entry point, events come from push() or input().
+    template <typename Ty>
+    FlowNode<Ty> source(const std::string& name) {
+        add_<Ty>(name, Kind::Source, &forward_);
+        return FlowNode<Ty>(steps_.size() - 1);
+    }
+
+    /// Passes the events predicate accepts.
+    template <typename Ty, typename Predicate>
+    FlowNode<Ty> filter(FlowNode<Ty> input, const std::string& name,
+                        Predicate&& predicate,
+                        EdgeMode mode = EdgeMode::Auto) {
+        step_(input);
+        add_<Ty>(name, Kind::Filter,
+                 [predicate = std::forward<Predicate>(predicate)](
+                     const void* value, const Step& self) {
+                     if (predicate(*static_cast<const Ty*>(value)))
+                         self.forward(value);
+                 });
+        link_(input.id_, steps_.back().get(), mode);
+        return FlowNode<Ty>(steps_.size() - 1);
+    }
+
+    /// Transforms every event into a Result.
+    template <typename Result, typename Ty, typename Func>
+    FlowNode<Result> map(FlowNode<Ty> input, const std::string& name,
+                         Func&& func, EdgeMode mode = EdgeMode::Auto) {
+        step_(input);
+        add_<Result>(name, Kind::Map,
+                     [func = std::forward<Func>(func)](const void* value,
+                                                       const Step& self) {
+                         Result result = func(*static_cast<const Ty*>(value));
+                         self.forward(&result);
+                     });
+        link_(input.id_, steps_.back().get(), mode);
+        return FlowNode<Result>(steps_.size() - 1);
+    }
+
+    /// Joins the events of inputs (fan-in), more can be added
+    /// with connect().
+    template <typename Ty>
+    FlowNode<Ty> merge(const std::string& name,
+                       std::initializer_list<FlowNode<Ty>> inputs) {
+        for (auto& el : inputs) step_(el);
+        Step* step = add_<Ty>(name, Kind::Merge, &forward_);
+        for (auto& el : inputs) link_(el.id_, step, EdgeMode::Auto);
+        return FlowNode<Ty>(steps_.size() - 1);
+    }
+
+    /// Calls func with every event.
+    template <typename Ty, typename Func,
+              typename =
+                  std::enable_if_t<std::is_invocable_v<Func&, const Ty&>>>
+    FlowNode<Ty> sink(FlowNode<Ty> input, const std::string& name, Func&& func,
+                      EdgeMode mode = EdgeMode::Auto) {
+        step_(input);
+        add_<Ty>(name, Kind::Sink,
+                 [func = std::forward<Func>(func)](const void* value,
+                                                   const Step&) {
+                     func(*static_cast<const Ty*>(value));
+                 });
+        link_(input.id_, steps_.back().get(), mode);
+        return FlowNode<Ty>(steps_.size() - 1);
+    }
+
+    /// Runs the events through an existing processor, its
+    /// results are the events of the node. The processor must
+    /// outlive the graph and have no other subscribers.
+    template <typename Result, typename Ty>
+    FlowNode<Result> process(FlowNode<Ty> input, const std::string& name,
+                             Processor<Ty, Result>* processor,
+                             EdgeMode mode = EdgeMode::Auto) {
+        step_(input);
+        Step* step = add_<Result>(name, Kind::Process,
+                                  [processor](const void* value, const Step&) {
+                                      processor->call(
+                                          *static_cast<const Ty*>(value));
+                                  });
+        link_(input.id_, step, mode);
+
+        auto output = std::make_unique<Output<Result>>(step);
+        processor->attach(output.get());
+        inputs_.push_back(std::move(output));
+        return FlowNode<Result>(steps_.size() - 1);
+    }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Runs the events through an existing parser, the
+    /// node i of the result carries the events of group i. The
+    /// parser must outlive the graph.
+    ////////////////////////////////////////////////////////////
+    template <typename Ty>
+    std::vector<FlowNode<Ty>> parse(FlowNode<Ty> input,
+                                    const std::string& name,
+                                    ParserBase<Ty>* parser, size_t groups,
+                                    EdgeMode mode = EdgeMode::Auto) {
+        step_(input);
+        Step* step = add_<Ty>(name, Kind::Parse,
+                              [parser](const void* value, const Step&) {
+                                  parser->call(*static_cast<const Ty*>(value));
+                              });
+        link_(input.id_, step, mode);
+        size_t parser_id = steps_.size() - 1;
+
+        // The groups hang off the parser step, so the graph sees the
+        // data flow, but are fed by the parser.
+        std::vector<FlowNode<Ty>> result;
+        for (size_t i = 0; i < groups; ++i) {
+            Step* group = add_<Ty>(name + "." + std::to_string(i),
+                                   Kind::Group, &forward_);
+            link_(parser_id, group, EdgeMode::Sync);
+
+            auto output = std::make_unique<Input<Ty>>(group);
+            parser->attach(i, output.get());
+            inputs_.push_back(std::move(output));
+            result.push_back(FlowNode<Ty>(steps_.size() - 1));
+        }
+        return result;
+    }
+
+    /// Delivers every event to an existing handler, which must
+    /// outlive the graph.
+    template <typename Ty>
+    FlowNode<Ty> sink(FlowNode<Ty> input, const std::string& name,
+                      Handler<Ty>* handler, EdgeMode mode = EdgeMode::Auto) {
+        step_(input);
+        add_<Ty>(name, Kind::Sink,
+                 [handler](const void* value, const Step&) {
+                     handler->call(*static_cast<const Ty*>(value));
+                 });
+        link_(input.id_, steps_.back().get(), mode);
+        return FlowNode<Ty>(steps_.size() - 1);
+    }
+
+    /// Adds an edge, to must not be a source.
+    template <typename Ty>
+    void connect(FlowNode<Ty> from, FlowNode<Ty> to,
+                 EdgeMode mode = EdgeMode::Auto) {
+        step_(from);
+        link_(from.id_, step_(to), mode);
+    }
+
+    /// Events an async node may have waiting before posting
+    /// into it blocks, default_queue_capacity by default.
+    void setQueueCapacity(size_t capacity) {
+        if (built_) throw std::logic_error("ec::FlowGraph is already built");
+        if (capacity == 0)
+            throw std::invalid_argument("ec::FlowGraph zero queue capacity");
+        queue_capacity_ = capacity;
+    }
+
+    /// Marks node as slow or blocking, Auto edges into it become
+    /// async.
+    template <typename Ty>
+    void setBlocking(FlowNode<Ty> node, bool blocking = true) {
+        if (built_) throw std::logic_error("ec::FlowGraph is already built");
+        step_(node)->blocking = blocking;
+    }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Validates and compiles the graph. Throws
+    /// std::logic_error naming the nodes of a cycle, a node
+    /// without inputs or a sink with outputs.
+    ////////////////////////////////////////////////////////////
+    void build();
+
+    bool isBuilt() const { return built_; }
+
+    /// Sends data into source, on the calling thread.
+    template <typename Ty>
+    void push(FlowNode<Ty> source,
+              const typename FlowNode<Ty>::value_type& data) const {
+        if (!built_) throw std::logic_error("ec::FlowGraph is not built");
+
+        const Step* step = step_(source);
+        if (step->kind != Kind::Source)
+            throw std::invalid_argument("ec::FlowGraph push into a non-source");
+        step->apply(&data, *step);
+    }
+
+    /// Handler that pushes into source, to be attached to a
+    /// HandlerList or a controller once the graph is built.
+    /// Owned by the graph.
+    template <typename Ty>
+    Handler<Ty>* input(FlowNode<Ty> source) {
+        if (!built_) throw std::logic_error("ec::FlowGraph is not built");
+
+        Step* step = step_(source);
+        if (step->kind != Kind::Source)
+            throw std::invalid_argument("ec::FlowGraph input of a non-source");
+
+        auto handler = std::make_unique<Input<Ty>>(step);
+        Handler<Ty>* result = handler.get();
+        inputs_.push_back(std::move(handler));
+        return result;
+    }
+
+    /// Waits for the events posted to async nodes so far.
+    void wait();
+
+    /// The compiled plan: chains of directly called nodes and
+    /// the edges between them, one per line.
+    std::string dump() const;
+};
+
+}  // namespace ec
+
+#endif
@@ -1,10 +1,13 @@
 #ifndef _TMBEL_GLOBAL_CONTAINER_HPP_
 #define _TMBEL_GLOBAL_CONTAINER_HPP_
 
+#include <TMBEL/concurrent_map.hpp>
 #include <TMBEL/handler.hpp>
+#include <TMBEL/slot_map.hpp>
 #include <list>
 #include <map>
 #include <mutex>
+#include <stdexcept>
 #include <vector>
 
 namespace ec {
@@ -38,7 +41,8 @@ class GlobalMapBase {
 
     Position push(Position index, ObjContainer* handler) {
         std::lock_guard lock(lock_);
-        return resource_.insert(std::make_pair(index, handler));
+        resource_.insert(std::make_pair(index, handler));
+        return index;
     }
 
     ObjContainer* pop(Position index) {
@@ -49,52 +53,91 @@ class GlobalMapBase {
     }
 };
 
+////////////////////////////////////////////////////////////
+/// \brief GlobalMapBase with a sharded hash map backend.
+/// get() takes no locks, push() and pop() lock one shard.
+////////////////////////////////////////////////////////////
+template <typename Index, typename Data, typename Hash = std::hash<Index>>
+class GlobalHashMapBase {
+ protected:
+    using Object       = Handler<Data>;
+    using ObjContainer = HandlerList<Data>;
+    using Container    = ConcurrentMap<Index, ObjContainer*, Hash>;
+    using Position     = Index;
+
+    using HandlerPos = typename ObjContainer::Position;
+
+    Container resource_;
+
+ public:
+    GlobalHashMapBase() = default;
+    GlobalHashMapBase(size_t shard_count) : resource_(shard_count) {}
+
+    ObjContainer* get(Position index) {
+        ObjContainer* handler;
+        if (!resource_.find(index, &handler))
+            throw std::out_of_range("ec::GlobalHashMapBase::get");
+        return handler;
+    }
+
+    Position push(Position index, ObjContainer* handler) {
+        resource_.insert(index, handler);
+        return index;
+    }
+
+    ObjContainer* pop(Position index) {
+        ObjContainer* handler;
+        if (!resource_.erase(index, &handler))
+            throw std::out_of_range("ec::GlobalHashMapBase::pop");
+        return handler;
+    }
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Dense integer addressed handler lists. Positions
+/// are generation-checked handles, so a handle of a popped
+/// list never reaches a list pushed later into its slot.
+////////////////////////////////////////////////////////////
 template <typename Data>
 class GlobalMasBase {
  protected:
 
     using Object       = Handler<Data>;
     using ObjContainer = HandlerList<Data>;
-    using Container    = std::vector<ObjContainer*>;
-    using Position     = uint32_t;
+    using Container    = SlotMap<ObjContainer>;
+    using Position     = SlotHandle;
 
     using HandlerPos = typename ObjContainer::Position;
 
     Container resource_;
-    std::recursive_mutex lock_;
 
 
  public:
-    GlobalMasBase() : resource_(0, nullptr) {}
+    GlobalMasBase() = default;
 
-    void setCount(Position new_count) { resource_.resize(new_count, nullptr); }
+    /// Reserves indices below new_count for push(index, ...).
+    void setCount(uint32_t new_count) { resource_.setCount(new_count); }
 
     ObjContainer* get(Position index) {
-        std::lock_guard lock(lock_);
-        return resource_.at(index);
-    }
-
-    Position push(ObjContainer* handler) {
-        std::lock_guard lock(lock_);
-
-        resource_.push_back(handler);
-        return resource_.size() - 1;
+        ObjContainer* handler = resource_.get(index);
+        if (handler == nullptr)
+            throw std::out_of_range("ec::GlobalMasBase::get");
+        return handler;
     }
 
-    Position push(Position index, ObjContainer* handler) {
-        std::lock_guard lock(lock_);
-        if (resource_.at(index) != nullptr) throw;
+    Position push(ObjContainer* handler) { return resource_.push(handler); }
 
-        resource_.at(index) = handler;
-        return index;
+    Position push(uint32_t index, ObjContainer* handler) {
+        Position result;
+        if (!resource_.push(index, handler, &result))
+            throw std::out_of_range("ec::GlobalMasBase::push");
+        return result;
     }
 
     ObjContainer* pop(Position index) {
-        std::lock_guard lock(lock_);
-        if (resource_.at(index) == nullptr) throw;
-
-        ObjContainer* handler = resource_.at(index);
-        resource_.at(index)   = nullptr;
+        ObjContainer* handler = resource_.pop(index);
+        if (handler == nullptr)
+            throw std::out_of_range("ec::GlobalMasBase::pop");
         return handler;
     }
 };
@@ -1,13 +1,30 @@
 #ifndef _TMBEL_HANDLER_HPP_
 #define _TMBEL_HANDLER_HPP_
 
+#include <TMBEL/adaptive_mutex.hpp>
+#include <TMBEL/inplace_function.hpp>
 #include <TMBEL/lock_handler.hpp>
+#include <TMBEL/metrics.hpp>
 #include <TMBEL/multithread_list.hpp>
+#include <TMBEL/payload.hpp>
 #include <TMBEL/process_list.hpp>
+#include <TMBEL/tracing.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
 #include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
 namespace ec {
@@ -16,9 +33,30 @@ namespace ec {
 /// \brief Base class of all handlers.
 ////////////////////////////////////////////////////////////
 class HandlerBase {
+ protected:
+    std::atomic<HandlerMetrics*> metrics_{nullptr};
+    bool named_ = false;
+
  public:
     virtual ~HandlerBase();
     virtual void onRemove();
+
+    /// Name of the handler in traces and lock profiles, see
+    /// ec::Tracer.
+    void setName(const std::string& name);
+    std::string getName() const;
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Turns on counting and timing of the calls made
+    /// through HandlerList, recorded in MetricsRegistry under
+    /// name.
+    ////////////////////////////////////////////////////////////
+    void setMetrics(const std::string& name);
+    void clearMetrics();
+
+    HandlerMetrics* getMetrics() const {
+        return metrics_.load(std::memory_order_relaxed);
+    }
 };
 
 ////////////////////////////////////////////////////////////
@@ -41,6 +79,100 @@ class Handler : public HandlerBase, public SubObjectBase<Handler<Data>> {
     virtual ~Handler() override = default;
 
     virtual void call(const Data& data) = 0;
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Calls handler the way lists and processors
+    /// dispatch: recorded by the Tracer when it is enabled and
+    /// timed into the metrics of the handler when it has them.
+    ////////////////////////////////////////////////////////////
+    static void invoke(Self* handler, const Data& data) {
+        if (!Tracer::enabled()) return measure_(handler, data);
+
+        const HandlerBase* object = handler;
+        uint64_t event            = Tracer::current();
+        Tracer::record(TraceKind::HandlerBegin, event, object);
+        measure_(handler, data);
+        Tracer::record(TraceKind::HandlerEnd, event, object);
+    }
+
+ protected:
+    static void measure_(Self* handler, const Data& data) {
+        HandlerMetrics* metrics = handler->getMetrics();
+        if (metrics == nullptr || !metrics->count()) return handler->call(data);
+
+        uint64_t begin = MetricsClock::now();
+        handler->call(data);
+        metrics->record(MetricsClock::now() - begin);
+    }
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Lets the removal of a handler wait for the
+/// dispatches that call handlers from a copy of a list.
+///
+/// A dispatch holds a Guard while it calls handlers without
+/// holding the list, synchronize() returns once every guard
+/// taken before it was released. Guards of the calling
+/// thread are not waited for, so a handler may detach itself
+/// or another handler of the list it is called from.
+////////////////////////////////////////////////////////////
+class DispatchGate {
+ protected:
+    struct Readers {
+        std::atomic<size_t> count{0};
+    };
+
+ public:
+    class Guard {
+     protected:
+        friend class DispatchGate;
+
+        const DispatchGate* gate_;
+        Readers* readers_;
+        Guard* outer_;
+
+     public:
+        explicit Guard(DispatchGate& gate) : gate_(&gate), outer_(guards_) {
+            std::lock_guard lock(gate.lock_);
+            readers_ = gate.current_.get();
+            readers_->count.fetch_add(1, std::memory_order_relaxed);
+            guards_ = this;
+        }
+
+        ~Guard() {
+            guards_ = outer_;
+            readers_->count.fetch_sub(1, std::memory_order_release);
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+
+ protected:
+    // Guards of the calling thread, innermost first.
+    static inline thread_local Guard* guards_ = nullptr;
+
+    AdaptiveMutex lock_;
+    std::shared_ptr<Readers> current_;
+    // Earlier generations that still had readers at a synchronize().
+    std::vector<std::shared_ptr<Readers>> retired_;
+
+    static size_t held_(const Readers* readers);
+
+ public:
+    DispatchGate();
+    DispatchGate(const DispatchGate&) = delete;
+    DispatchGate& operator=(const DispatchGate&) = delete;
+
+    void synchronize();
+
+    /// True while the calling thread holds a guard of the gate,
+    /// synchronize() does not wait for those.
+    bool held() const {
+        for (auto el = guards_; el != nullptr; el = el->outer_)
+            if (el->gate_ == this) return true;
+        return false;
+    }
 };
 
 template <typename Data>
@@ -49,12 +181,94 @@ class HandlerList : public ObsObjectBase<Handler<Data>> {
     using Self = HandlerList<Data>;
     using Base = ObsObjectBase<Handler<Data>>;
 
+    struct Handlers {
+        size_t version;  // of the list when it was copied
+        std::vector<Handler<Data>*> handlers;
+    };
+
+    using Snapshot = std::shared_ptr<const Handlers>;
+
+    AdaptiveMutex snapshot_lock_;
+    Snapshot snapshot_;
+    DispatchGate gate_;
+
+    static void invoke_(Handler<Data>* handler, const Data& data) {
+        Handler<Data>::invoke(handler, data);
+    }
+
+    Snapshot getSnapshot_() {
+        std::lock_guard lock(snapshot_lock_);
+
+        size_t version = Base::sub_list_.version();
+        if (!snapshot_ || snapshot_->version != version) {
+            auto snapshot     = std::make_shared<Handlers>();
+            snapshot->version = version;
+            Base::sub_list_.map([&snapshot](Handler<Data>* el) {
+                snapshot->handlers.push_back(el);
+            });
+            snapshot_ = std::move(snapshot);
+        }
+        return snapshot_;
+    }
+
+    // Detaching waits for the dispatches that may still call the
+    // handler, see callConcurrent().
+    void watchErase_() {
+        Base::sub_list_.setEraseHook([this]() { gate_.synchronize(); });
+    }
+
  public:
-    HandlerList() = default;
-    virtual ~HandlerList() override = default;
+    HandlerList() { watchErase_(); }
+    explicit HandlerList(std::pmr::memory_resource* resource) : Base(resource) {
+        watchErase_();
+    }
+    HandlerList(const Self& other) : Base(other) { watchErase_(); }
+    virtual ~HandlerList() override { Base::sub_list_.setEraseHook(nullptr); }
+
+    Self& operator=(const Self& other) {
+        Base::operator=(other);
+        return *this;
+    }
+
+    // Virtual so that lists with their own dispatch, like
+    // IndexedHandlerList, also work through a HandlerList*.
+    virtual typename Base::Position attach(Handler<Data>* object) {
+        return Base::attach(object);
+    }
 
-    inline void call(const Data& data) {
-        this->map([&data](Handler<Data>* el) { el->call(data); });
+    virtual typename Base::Position attach(typename Base::Position position,
+                                           Handler<Data>* object) {
+        return Base::attach(position, object);
+    }
+
+    /// Calls handlers one by one holding the list, concurrent
+    /// calls of the same list are serialized.
+    virtual void call(const Data& data) {
+        this->map([&data](Handler<Data>* el) { invoke_(el, data); });
+    }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Calls handlers from a cached copy of the list
+    /// without holding it, so several threads can dispatch
+    /// through the same list.
+    ///
+    /// Detaching a handler waits for the dispatches that may
+    /// still call it, so it can be destroyed once detach()
+    /// returned. A handler detached during call() of the same
+    /// list waits while that call holds the list, handlers of
+    /// concurrent dispatches must not change the list then.
+    ////////////////////////////////////////////////////////////
+    virtual void callConcurrent(const Data& data) {
+        while (true) {
+            Snapshot snapshot = getSnapshot_();
+            DispatchGate::Guard guard(gate_);
+
+            // Copied before a detach that did not see the guard.
+            if (snapshot->version != Base::sub_list_.version()) continue;
+
+            for (auto el : snapshot->handlers) invoke_(el, data);
+            return;
+        }
     }
 };
 
@@ -68,13 +282,18 @@ class Processor : public ObsObjectBase<Handler<Result>>,
  protected:
     using Self    = Processor<Data, Result>;
     using SubBase = Handler<Data>;
-    using ObsBase = HandlerList<Result>;
+    using ObsBase = ObsObjectBase<Handler<Result>>;
 
     using Sub     = Handler<Result>;
-    using Process = std::function<Result(const Data&)>;
+    using Process = InplaceFunction<Result(const Data&)>;
 
     Process process_;
 
+    /// Sends result to the subscribers.
+    void emit_(const Result& result) {
+        sub_list_.map([&result](Sub*& el) { Sub::invoke(el, result); });
+    }
+
  private:
     using Container = typename SubBase::Container;
     using Position  = typename SubBase::Position;
@@ -86,15 +305,12 @@ class Processor : public ObsObjectBase<Handler<Result>>,
     Processor(Container* container) : SubBase(container) {}
     Processor(Position position, Container* container)
         : SubBase(position, container) {}
-    Processor(Process process) : process_(process) {}
+    Processor(Process&& process) : process_(std::move(process)) {}
     virtual ~Processor() override = default;
 
-    void setProcess(Process process) { process_ = process; }
+    void setProcess(Process&& process) { process_ = std::move(process); }
 
-    void call(const Data& data) override {
-        Result result = process_(data);
-        sub_list_.call(data);
-    }
+    void call(const Data& data) override { emit_(process_(data)); }
 };
 
 ////////////////////////////////////////////////////////////
@@ -140,10 +356,65 @@ class FuncHandlerBase : public Handler<Data> {
     using Base = Handler<Data>;
 
  protected:
-    using Func = std::function<void(const Data&)>;
+    using Func = InplaceFunction<void(const Data&)>;
+
+    // Marks the handler as running its function on this thread while
+    // it is in scope.
+    class Running {
+     protected:
+        const Self* handler_;
+        Running* outer_;
+
+     public:
+        explicit Running(const Self* handler)
+            : handler_(handler), outer_(running_) {
+            running_ = this;
+        }
+
+        ~Running() { running_ = outer_; }
+
+        Running(const Running&) = delete;
+        Running& operator=(const Running&) = delete;
+
+        static bool contains(const Self* handler) {
+            for (auto el = running_; el != nullptr; el = el->outer_)
+                if (el->handler_ == handler) return true;
+            return false;
+        }
+    };
+
+    static inline thread_local Running* running_ = nullptr;
 
     Func function_;
-    mutable std::recursive_mutex lock_;
+    mutable std::shared_mutex lock_;
+
+    // Set from inside function_, applied once it returned.
+    std::mutex pending_lock_;
+    Func pending_;
+    std::atomic<bool> has_pending_{false};
+
+    // Shared lock of lock_, left empty when the function of the handler
+    // runs further up on this thread and already holds one. Taking the
+    // shared_mutex twice on one thread would deadlock against a waiting
+    // setFunction().
+    std::shared_lock<std::shared_mutex> lockShared_() const {
+        if (Running::contains(this)) return {};
+        return std::shared_lock(lock_);
+    }
+
+    // Called after function_ returned and lock_ was released.
+    void applyPending_() {
+        if (!has_pending_.load(std::memory_order_acquire) ||
+            Running::contains(this))
+            return;
+
+        std::unique_lock lock(lock_);
+        std::lock_guard pending_lock(pending_lock_);
+        if (!has_pending_.load(std::memory_order_relaxed)) return;
+
+        function_ = std::move(pending_);
+        has_pending_.store(false, std::memory_order_relaxed);
+    }
 
  public:
     FuncHandlerBase() {}
@@ -152,9 +423,25 @@ class FuncHandlerBase : public Handler<Data> {
     }
     virtual ~FuncHandlerBase() = default;
 
+    ////////////////////////////////////////////////////////////
+    /// \brief Replaces the function, waiting for the calls and
+    /// async tasks that run the old one. Called from inside
+    /// the function, also through another handler it calls, it
+    /// takes effect once the function returned.
+    ////////////////////////////////////////////////////////////
     virtual void setFunction(Func&& function) {
-        std::lock_guard lock(lock_);
+        if (Running::contains(this)) {
+            std::lock_guard pending_lock(pending_lock_);
+            pending_ = std::move(function);
+            has_pending_.store(true, std::memory_order_release);
+            return;
+        }
+
+        std::unique_lock lock(lock_);
+        std::lock_guard pending_lock(pending_lock_);
         function_ = std::move(function);
+        pending_  = nullptr;
+        has_pending_.store(false, std::memory_order_relaxed);
     }
 
     virtual Mutex getMutex() const = 0;
@@ -162,6 +449,14 @@ class FuncHandlerBase : public Handler<Data> {
     virtual void setMutex(const Mutex& lock) const = 0;
 
     virtual void clearMutex() const = 0;
+
+    /// Declares whether the handler reads or writes the state
+    /// guarded by its group.
+    void setAccess(MutexAccess access) const {
+        setMutex(getMutex().withAccess(access));
+    }
+
+    MutexAccess getAccess() const { return getMutex().getAccess(); }
 };
 
 ////////////////////////////////////////////////////////////
@@ -174,7 +469,6 @@ class SyncFuncHandler : public FuncHandlerBase<Data> {
     using Base = FuncHandlerBase<Data>;
 
     using Func = typename Base::Func;
-    using Base::lock_;
 
     mutable Mutex global_lock_;
 
@@ -183,63 +477,517 @@ class SyncFuncHandler : public FuncHandlerBase<Data> {
     SyncFuncHandler(Func&& function) : Base(std::move(function)) {}
     virtual ~SyncFuncHandler() override = default;
 
-    void setMutex(const Mutex& lock) const { global_lock_ = lock; }
+    void setMutex(const Mutex& lock) const {
+        global_lock_ = lock;
+        global_lock_.setOwner(this);
+    }
 
     void clearMutex() const {
-        global_lock_ = MutexList::getInstance()->getMutex();
+        setMutex(MutexList::getInstance()->getMutex());
     }
 
     Mutex getMutex() const { return global_lock_; }
 
     void call(const Data& data) override {
-        std::lock_guard lock(lock_);
-        if (Base::function_) {
-            std::lock_guard lock(global_lock_);
+        {
+            auto lock = Base::lockShared_();
+            if (!Base::function_) return;
+
+            typename Base::Running running(this);
+            std::lock_guard global_lock(global_lock_);
             Base::function_(data);
         }
+        Base::applyPending_();
     }
 };
 
 ////////////////////////////////////////////////////////////
 /// \brief Handler that can asynchronously call function
 /// that will be set.
+///
+/// Every task keeps its own copy of the event data, so it
+/// stays valid after the dispatch returns. Small events are
+/// copied into the inline buffer of ProcessList::Task, larger
+/// ones into a Shared block. Events with large payloads
+/// should carry a Shared or SharedBuffer handle, which is
+/// copied by reference count. Tasks call the function of the
+/// handler, setFunction() waits for the running ones.
 ////////////////////////////////////////////////////////////
 template <typename Data>
-class AsyncFuncHandler : public Handler<Data> {
+class AsyncFuncHandler : public FuncHandlerBase<Data> {
  protected:
     using Self = AsyncFuncHandler<Data>;
-    using Base = Handler<Data>;
+    using Base = FuncHandlerBase<Data>;
 
     using Func = typename Base::Func;
-    using Base::lock_;
+
+    // Whether a copy fits into a task next to the handler and a
+    // trace id, with room for padding.
+    static constexpr bool inline_copy_ =
+        sizeof(Data) + alignof(Data) + sizeof(void*) + sizeof(uint64_t) <=
+            ProcessList::Task::capacity &&
+        alignof(Data) <= alignof(std::max_align_t);
+
+    using Copy = std::conditional_t<inline_copy_, Data, Shared<Data>>;
 
     ProcessList process_list_;
 
+    static Copy copy_(const Data& data) {
+        if constexpr (inline_copy_)
+            return data;
+        else
+            return Copy::make(data);
+    }
+
+    static const Data& get_(const Copy& copy) {
+        if constexpr (inline_copy_)
+            return copy;
+        else
+            return *copy.get();
+    }
+
+    void run_(const Data& data) {
+        {
+            auto lock = Base::lockShared_();
+            if (!Base::function_) return;
+
+            typename Base::Running running(this);
+            Base::function_(data);
+        }
+        Base::applyPending_();
+    }
+
  public:
     AsyncFuncHandler() = default;
 
-    AsyncFuncHandler(const Mutex& lock) : Base() {
-        process_list_.setMutex(lock);
-    }
+    AsyncFuncHandler(const Mutex& lock) : Base() { setMutex(lock); }
 
     AsyncFuncHandler(Func&& function) : Base(std::move(function)) {}
     AsyncFuncHandler(Func&& function, const Mutex& lock)
         : Base(std::move(function)) {
-        process_list_.setMutex(lock);
+        setMutex(lock);
     }
 
     virtual ~AsyncFuncHandler() override = default;
 
-    void setMutex(const Mutex& lock) const { process_list_.setMutex(lock); }
+    void setMutex(const Mutex& lock) const {
+        Mutex reference(lock);
+        reference.setOwner(this);
+        process_list_.setMutex(reference);
+    }
 
-    void clearMutex() const { process_list_.clearMutex(); }
+    void clearMutex() const {
+        setMutex(MutexList::getInstance()->getMutex());
+    }
 
     Mutex getMutex() const { return process_list_.getMutex(); }
 
     void call(const Data& data) override {
-        std::lock_guard lock(lock_);
-        if (Base::function_)
-            process_list_.exec(Base::function_, std::ref(data));
+        auto lock = Base::lockShared_();
+        if (!Base::function_) return;
+        if (!Tracer::enabled())
+            return process_list_.exec(
+                [this, copy = copy_(data)]() { run_(get_(copy)); });
+
+        uint64_t event = Tracer::current();
+        Tracer::record(TraceKind::AsyncBegin, event,
+                       static_cast<const HandlerBase*>(this));
+
+        process_list_.exec([this, event, copy = copy_(data)]() {
+            const HandlerBase* object = this;
+            Tracer::setCurrent(event);
+            Tracer::record(TraceKind::AsyncEnd, event, object);
+            Tracer::record(TraceKind::HandlerBegin, event, object);
+            run_(get_(copy));
+            Tracer::record(TraceKind::HandlerEnd, event, object);
+        });
+    }
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Base of the flow-control stages, handlers that
+/// forward only some of the events they receive.
+///
+/// A stage is attached to a HandlerList and is itself the
+/// list the protected handlers attach to. Rejected events
+/// are dropped or, with setOverflow(), diverted to another
+/// list. Deciding is lock-free, so a stage in front of an
+/// expensive handler is the cheapest way to shed load.
+////////////////////////////////////////////////////////////
+template <typename Data>
+class FlowStage : public HandlerList<Data>, virtual public Handler<Data> {
+ protected:
+    using Self    = FlowStage<Data>;
+    using SubBase = Handler<Data>;
+    using ObsBase = HandlerList<Data>;
+
+    std::atomic<HandlerList<Data>*> overflow_{nullptr};
+    std::atomic<uint64_t> passed_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    static int64_t now_() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    void pass_(const Data& data) {
+        passed_.fetch_add(1, std::memory_order_relaxed);
+        ObsBase::call(data);
+    }
+
+    void reject_(const Data& data) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        if (auto list = overflow_.load(std::memory_order_acquire))
+            list->call(data);
+    }
+
+ public:
+    FlowStage() = default;
+    FlowStage(const Self&) = delete;
+    virtual ~FlowStage() override = default;
+
+    Self& operator=(const Self&) = delete;
+
+    void call(const Data& data) override = 0;
+
+    /// Rejected events go to list instead of being dropped.
+    void setOverflow(HandlerList<Data>* list) { overflow_ = list; }
+    void clearOverflow() { overflow_ = nullptr; }
+
+    uint64_t getPassed() const {
+        return passed_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t getDropped() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Token bucket that passes rate events per second
+/// on average and bursts of up to burst events.
+///
+/// Kept as the theoretical arrival time of the next event
+/// (GCRA), one CAS per event.
+////////////////////////////////////////////////////////////
+template <typename Data>
+class RateLimiter : public FlowStage<Data> {
+ protected:
+    using Self = RateLimiter<Data>;
+    using Base = FlowStage<Data>;
+
+    std::atomic<int64_t> arrival_{0};
+    std::atomic<int64_t> interval_{0};   // nanoseconds per token
+    std::atomic<int64_t> tolerance_{0};  // how far arrival_ may run ahead
+
+ public:
+    RateLimiter(double rate, size_t burst = 1) { setRate(rate, burst); }
+    virtual ~RateLimiter() override = default;
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Throws std::invalid_argument unless rate is
+    /// positive and finite. The interval between events and
+    /// the burst span are kept between one nanosecond and 2^60
+    /// (about 36 years), so arrival times cannot overflow and
+    /// faster rates pass one event per nanosecond.
+    ////////////////////////////////////////////////////////////
+    void setRate(double rate, size_t burst = 1) {
+        if (!(rate > 0) || !std::isfinite(rate))
+            throw std::invalid_argument("ec::RateLimiter invalid rate");
+
+        constexpr double max_interval = double(int64_t(1) << 60);
+        double interval = std::clamp(1e9 / rate, 1.0, max_interval);
+        double span     = interval * double(burst > 0 ? burst - 1 : 0);
+
+        interval_  = int64_t(interval);
+        tolerance_ = int64_t(std::min(span, max_interval));
+    }
+
+    void call(const Data& data) override {
+        int64_t now       = Base::now_();
+        int64_t interval  = interval_.load(std::memory_order_relaxed);
+        int64_t tolerance = tolerance_.load(std::memory_order_relaxed);
+        int64_t arrival   = arrival_.load(std::memory_order_relaxed);
+
+        while (true) {
+            int64_t next = std::max(arrival, now);
+            if (next - now > tolerance) return Base::reject_(data);
+            if (arrival_.compare_exchange_weak(arrival, next + interval,
+                                               std::memory_order_relaxed))
+                break;
+        }
+        Base::pass_(data);
+    }
+};
+
+////////////////////////////////////////////////////////////
+/// \brief How Throttle paces the events of a key.
+////////////////////////////////////////////////////////////
+enum class ThrottleMode {
+    Leading,  ///< At most one event per interval.
+    Debounce  ///< Only events after interval of silence.
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Per-key throttle or debounce.
+///
+/// The time of every key lives in a fixed table of atomic
+/// slots claimed by the hash of the key with linear probing.
+/// Keys of the same hash, or keys that find no free slot
+/// once the table is crowded, share a slot, so capacity
+/// should stay well above the number of live keys.
+///
+/// Suppressed events are rejected, or with setMerge() folded
+/// into a pending event of the key that goes out, merged
+/// with the event that passes next. flush() sends the
+/// pending events of keys that went quiet. Only merging
+/// takes a short spin lock on the slot.
+////////////////////////////////////////////////////////////
+template <typename Data, typename Key = uint64_t,
+          typename Hash = std::hash<Key>>
+class Throttle : public FlowStage<Data> {
+ public:
+    using KeyFunc = InplaceFunction<Key(const Data&)>;
+    using Merge =
+        InplaceFunction<Data(const Data& pending, const Data& data)>;
+
+ protected:
+    using Self = Throttle<Data, Key, Hash>;
+    using Base = FlowStage<Data>;
+
+    struct Slot {
+        std::atomic<uint64_t> tag{0};  // 0 while free
+        std::atomic<int64_t> last{0};  // 0 before the first event
+        std::atomic<bool> busy{false};
+        std::optional<Data> pending;
+    };
+
+    static constexpr size_t max_probes = 16;
+
+    KeyFunc key_;
+    Merge merge_;
+    Hash hasher_;
+    ThrottleMode mode_;
+    int64_t interval_;  // nanoseconds
+    size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> merged_{0};
+
+    static uint64_t mix_(uint64_t hash) {
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ULL;
+        return hash ^ (hash >> 33);
+    }
+
+    Slot* slot_(const Key& key) {
+        uint64_t hash = mix_(hasher_(key));
+        uint64_t tag  = hash | 1;
+        Slot* slot    = nullptr;
+
+        for (size_t i = 0; i < max_probes; ++i) {
+            slot             = &slots_[(hash + i) & mask_];
+            uint64_t current = slot->tag.load(std::memory_order_acquire);
+            if (current == 0 &&
+                slot->tag.compare_exchange_strong(current, tag,
+                                                  std::memory_order_acq_rel))
+                return slot;
+            if (current == tag) return slot;
+        }
+        return slot;
+    }
+
+    // Claims the time slot of the key, true if data may pass.
+    bool admit_(Slot* slot, int64_t now) {
+        if (mode_ == ThrottleMode::Debounce) {
+            int64_t last = slot->last.exchange(now, std::memory_order_relaxed);
+            return last == 0 || now - last >= interval_;
+        }
+
+        int64_t last = slot->last.load(std::memory_order_relaxed);
+        while (last == 0 || now - last >= interval_)
+            if (slot->last.compare_exchange_weak(last, now,
+                                                 std::memory_order_relaxed))
+                return true;
+        return false;
+    }
+
+    void lock_(Slot* slot) {
+        while (slot->busy.exchange(true, std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+
+    void unlock_(Slot* slot) {
+        slot->busy.store(false, std::memory_order_release);
+    }
+
+ public:
+    Throttle(KeyFunc&& key, std::chrono::nanoseconds interval,
+             ThrottleMode mode = ThrottleMode::Leading, size_t capacity = 4096)
+        : key_(std::move(key)), mode_(mode), interval_(interval.count()) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        mask_  = size - 1;
+        slots_ = std::make_unique<Slot[]>(size);
+    }
+    virtual ~Throttle() override = default;
+
+    /// Merges suppressed events instead of rejecting them, set
+    /// before events arrive.
+    void setMerge(Merge&& merge) { merge_ = std::move(merge); }
+
+    void call(const Data& data) override {
+        Slot* slot = slot_(key_(data));
+        bool pass  = admit_(slot, Base::now_());
+
+        if (!merge_) {
+            if (pass) return Base::pass_(data);
+            return Base::reject_(data);
+        }
+
+        std::optional<Data> result;
+        lock_(slot);
+        if (pass) {
+            if (slot->pending) result = merge_(*slot->pending, data);
+            slot->pending.reset();
+        } else {
+            if (slot->pending)
+                slot->pending = merge_(*slot->pending, data);
+            else
+                slot->pending = data;
+        }
+        unlock_(slot);
+
+        if (!pass)
+            merged_.fetch_add(1, std::memory_order_relaxed);
+        else if (result)
+            Base::pass_(*result);
+        else
+            Base::pass_(data);
+    }
+
+    /// Sends the pending merged events, for example from a
+    /// periodic task. Returns how many were sent.
+    size_t flush() {
+        size_t result = 0;
+        for (size_t i = 0; i <= mask_; ++i) {
+            Slot* slot = &slots_[i];
+            if (slot->tag.load(std::memory_order_acquire) == 0) continue;
+
+            lock_(slot);
+            std::optional<Data> pending = std::move(slot->pending);
+            slot->pending.reset();
+            unlock_(slot);
+
+            if (pending) {
+                Base::pass_(*pending);
+                ++result;
+            }
+        }
+        return result;
+    }
+
+    uint64_t getMerged() const {
+        return merged_.load(std::memory_order_relaxed);
+    }
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Passes every n-th event.
+////////////////////////////////////////////////////////////
+template <typename Data>
+class Sampler : public FlowStage<Data> {
+ protected:
+    using Self = Sampler<Data>;
+    using Base = FlowStage<Data>;
+
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> every_;
+
+ public:
+    explicit Sampler(uint64_t every) : every_(every > 0 ? every : 1) {}
+    virtual ~Sampler() override = default;
+
+    void setEvery(uint64_t every) { every_ = every > 0 ? every : 1; }
+
+    void call(const Data& data) override {
+        uint64_t count = count_.fetch_add(1, std::memory_order_relaxed);
+        if (count % every_.load(std::memory_order_relaxed) == 0)
+            return Base::pass_(data);
+        Base::reject_(data);
+    }
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Keeps a uniform sample of size events (reservoir
+/// sampling) and sends it on flush().
+///
+/// Whether an event enters the reservoir is decided with a
+/// counter and a per-thread generator, the reservoir is only
+/// locked to store a chosen event, which gets rarer as the
+/// stream grows. Events that are not chosen or are pushed
+/// out of the reservoir are rejected, as are events chosen
+/// while flush() starts a new sample: they belong to the
+/// stream that was sent.
+////////////////////////////////////////////////////////////
+template <typename Data>
+class ReservoirSampler : public FlowStage<Data> {
+ protected:
+    using Self = ReservoirSampler<Data>;
+    using Base = FlowStage<Data>;
+
+    const size_t size_;
+
+    std::mutex lock_;
+    std::vector<std::optional<Data>> reservoir_;
+    std::atomic<uint64_t> seen_{0};
+    std::atomic<uint64_t> period_{0};  // flush() calls so far
+
+    static uint64_t random_(uint64_t bound) {
+        thread_local std::mt19937_64 generator(std::random_device{}());
+        return std::uniform_int_distribution<uint64_t>(0, bound)(generator);
+    }
+
+ public:
+    explicit ReservoirSampler(size_t size) : size_(size), reservoir_(size) {}
+    virtual ~ReservoirSampler() override = default;
+
+    void call(const Data& data) override {
+        uint64_t period = period_.load(std::memory_order_acquire);
+        uint64_t index  = seen_.fetch_add(1, std::memory_order_relaxed);
+        if (index >= size_) index = random_(index);
+        if (index >= size_) return Base::reject_(data);
+
+        std::optional<Data> evicted;
+        {
+            std::lock_guard lock(lock_);
+            if (period != period_.load(std::memory_order_relaxed))
+                evicted = data;
+            else
+                evicted = std::exchange(reservoir_[index], data);
+        }
+        if (evicted) Base::reject_(*evicted);
+    }
+
+    /// Sends the sample and starts a new one, returns its size.
+    size_t flush() {
+        std::vector<std::optional<Data>> sample(size_);
+        {
+            std::lock_guard lock(lock_);
+            sample.swap(reservoir_);
+            seen_ = 0;
+            period_.fetch_add(1, std::memory_order_release);
+        }
+
+        size_t result = 0;
+        for (auto& el : sample)
+            if (el) {
+                Base::pass_(*el);
+                ++result;
+            }
+        return result;
     }
 };
 
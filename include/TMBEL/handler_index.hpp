@@ -0,0 +1,332 @@
+#ifndef _TMBEL_HANDLER_INDEX_HPP_
+#define _TMBEL_HANDLER_INDEX_HPP_
+
+#include <TMBEL/adaptive_mutex.hpp>
+#include <TMBEL/handler.hpp>
+#include <TMBEL/inplace_function.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+/// \brief Conjunction of predicates on numeric fields of an
+/// event, the subscription of a handler in
+/// IndexedHandlerList. An empty filter matches everything.
+////////////////////////////////////////////////////////////
+class SubscriptionFilter {
+ public:
+    /// Inclusive bounds, low equals high for equality.
+    struct Predicate {
+        uint32_t field;
+        int64_t low;
+        int64_t high;
+
+        bool isEqual() const { return low == high; }
+    };
+
+ protected:
+    using Self = SubscriptionFilter;
+
+    std::vector<Predicate> predicates_;
+
+ public:
+    Self& equal(size_t field, int64_t value);
+    Self& range(size_t field, int64_t low, int64_t high);
+
+    const std::vector<Predicate>& getPredicates() const { return predicates_; }
+
+    /// Predicate the index looks the filter up by: the first
+    /// equality, else the first range. Empty filters have none.
+    const Predicate* anchor() const;
+
+    /// values holds the extracted value of every field.
+    bool matches(const int64_t* values) const;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Static interval tree (centered), finds the
+/// intervals that contain a point in O(log n + matches).
+///
+/// Nodes and their interval lists live in flat arrays. Every
+/// node keeps the intervals that contain its center twice,
+/// sorted by low and by high, so a query only reads entries
+/// that match plus one per visited node.
+////////////////////////////////////////////////////////////
+class IntervalIndex {
+ public:
+    struct Interval {
+        int64_t low;
+        int64_t high;
+        uint32_t id;
+    };
+
+ protected:
+    struct Node {
+        int64_t center;
+        uint32_t begin;  // of the node in by_low_ and by_high_
+        uint32_t end;
+        int32_t left  = -1;
+        int32_t right = -1;
+    };
+
+    std::vector<Node> nodes_;
+    std::vector<Interval> by_low_;
+    std::vector<Interval> by_high_;
+
+    int32_t build_(std::vector<Interval>& intervals);
+
+ public:
+    IntervalIndex() = default;
+    explicit IntervalIndex(std::vector<Interval> intervals);
+
+    bool empty() const { return nodes_.empty(); }
+
+    /// Calls visit(id) for every interval that contains point.
+    template <typename Visit>
+    void query(int64_t point, Visit&& visit) const {
+        int32_t index = nodes_.empty() ? -1 : 0;
+
+        while (index >= 0) {
+            const Node& node = nodes_[index];
+            if (point < node.center) {
+                for (uint32_t i = node.begin;
+                     i < node.end && by_low_[i].low <= point; ++i)
+                    visit(by_low_[i].id);
+                index = node.left;
+            } else {
+                for (uint32_t i = node.begin;
+                     i < node.end && by_high_[i].high >= point; ++i)
+                    visit(by_high_[i].id);
+                index = node.right;
+            }
+        }
+    }
+};
+
+////////////////////////////////////////////////////////////
+/// \brief HandlerList whose handlers subscribe with filters
+/// on fields of the event, call() only visits the handlers
+/// whose filter matches.
+///
+/// Fields are numeric values extracted from the event,
+/// registered with addField() before handlers subscribe. The
+/// filters are compiled into an index on the first call
+/// after the subscriptions changed, other calls read the
+/// published index without a lock. Every filter is found
+/// through one predicate, equalities by hash of the value
+/// and ranges in an IntervalIndex per field, and the other
+/// predicates of the found filters are checked on the
+/// extracted values. A call costs one lookup per field plus
+/// the matching handlers instead of a virtual call per
+/// handler.
+///
+/// Handlers attached without a filter get every event.
+/// Handlers are called from the compiled index without
+/// holding the list, like callConcurrent(), and in no
+/// particular order. call() and attach() override the ones
+/// of HandlerList, so the index is also used through a
+/// HandlerList*, e.g. by ControllerBase::setHandlerList().
+////////////////////////////////////////////////////////////
+template <typename Data>
+class IndexedHandlerList : public HandlerList<Data> {
+ public:
+    using Field = InplaceFunction<int64_t(const Data&)>;
+
+    static constexpr size_t max_fields = 16;
+
+ protected:
+    using Self   = IndexedHandlerList<Data>;
+    using Base   = HandlerList<Data>;
+    using Object = Handler<Data>;
+
+    struct FieldIndex {
+        std::unordered_map<int64_t, std::vector<uint32_t>> equal;
+        IntervalIndex ranges;
+    };
+
+    struct Compiled {
+        size_t version;  // of list and filters before the list was walked
+        std::vector<Object*> always;
+        std::vector<Object*> handlers;  // by id
+        std::vector<SubscriptionFilter> filters;
+        std::vector<FieldIndex> fields;
+    };
+
+    using Index = std::shared_ptr<const Compiled>;
+
+    std::vector<Field> fields_;
+
+    // Guards filters_ and the owners of the indexes, call() reads
+    // current_ under a DispatchGate guard instead.
+    AdaptiveMutex index_lock_;
+    std::unordered_map<const Object*, SubscriptionFilter> filters_;
+    std::atomic<size_t> filters_version_{0};
+    std::atomic<const Compiled*> current_{nullptr};
+    Index index_;
+    // Replaced indexes that dispatches may still read.
+    std::vector<Index> retired_;
+
+    size_t version_() const {
+        return Base::sub_list_.version() +
+               filters_version_.load(std::memory_order_acquire);
+    }
+
+    Index compile_() {
+        auto index     = std::make_shared<Compiled>();
+        index->version = version_();
+        index->fields.resize(fields_.size());
+
+        std::unordered_map<const Object*, SubscriptionFilter> filters;
+        std::vector<std::vector<IntervalIndex::Interval>> ranges(
+            fields_.size());
+
+        Base::sub_list_.map([&](Object* el) {
+            auto found = filters_.find(el);
+            if (found == filters_.end() || !found->second.anchor()) {
+                index->always.push_back(el);
+                return;
+            }
+
+            auto id     = uint32_t(index->handlers.size());
+            auto anchor = found->second.anchor();
+            if (anchor->isEqual())
+                index->fields[anchor->field].equal[anchor->low].push_back(id);
+            else
+                ranges[anchor->field].push_back(
+                    {anchor->low, anchor->high, id});
+
+            index->handlers.push_back(el);
+            index->filters.push_back(found->second);
+            filters.insert(*found);
+        });
+
+        for (size_t i = 0; i < ranges.size(); ++i)
+            index->fields[i].ranges = IntervalIndex(std::move(ranges[i]));
+
+        // Forget the filters of handlers that left the list.
+        filters_.swap(filters);
+        return index;
+    }
+
+    void dispatch_(const Compiled& index, const Data& data) {
+        for (auto el : index.always) Base::invoke_(el, data);
+        if (index.handlers.empty()) return;
+
+        int64_t values[max_fields];
+        for (size_t i = 0; i < fields_.size(); ++i)
+            values[i] = fields_[i](data);
+
+        auto visit = [&](uint32_t id) {
+            if (index.filters[id].matches(values))
+                Base::invoke_(index.handlers[id], data);
+        };
+
+        for (size_t i = 0; i < index.fields.size(); ++i) {
+            const FieldIndex& field = index.fields[i];
+            if (!field.equal.empty()) {
+                auto found = field.equal.find(values[i]);
+                if (found != field.equal.end())
+                    for (auto id : found->second) visit(id);
+            }
+            field.ranges.query(values[i], visit);
+        }
+    }
+
+    // Publishes a new index unless another thread already did.
+    // Replaced ones are freed once no dispatch can read them,
+    // which a thread dispatching from this list cannot wait for.
+    void recompile_() {
+        std::vector<Index> retired;
+        {
+            std::lock_guard lock(index_lock_);
+
+            if (index_ && index_->version == version_()) return;
+            if (index_) retired_.push_back(std::move(index_));
+            index_ = compile_();
+            current_.store(index_.get(), std::memory_order_release);
+            if (!Base::gate_.held()) retired.swap(retired_);
+        }
+        if (!retired.empty()) Base::gate_.synchronize();
+    }
+
+ public:
+    IndexedHandlerList() = default;
+    IndexedHandlerList(const Self&) = delete;
+    virtual ~IndexedHandlerList() override = default;
+
+    Self& operator=(const Self&) = delete;
+
+    /// Registers a field and returns its number for filters,
+    /// must be called before handlers subscribe.
+    size_t addField(Field&& field) {
+        if (fields_.size() == max_fields)
+            throw std::length_error("ec::IndexedHandlerList too many fields");
+
+        fields_.push_back(std::move(field));
+        return fields_.size() - 1;
+    }
+
+    size_t getFieldCount() const { return fields_.size(); }
+
+    // Every attach() holds index_lock_ so that no compile sees the
+    // handler without its filter.
+    typename Base::Position attach(Object* object) override {
+        std::lock_guard lock(index_lock_);
+        if (filters_.erase(object) != 0) filters_version_.fetch_add(1);
+        return Base::attach(object);
+    }
+
+    typename Base::Position attach(typename Base::Position position,
+                                   Object* object) override {
+        std::lock_guard lock(index_lock_);
+        if (filters_.erase(object) != 0) filters_version_.fetch_add(1);
+        return Base::attach(position, object);
+    }
+
+    /// Subscribes object to the events filter matches.
+    typename Base::Position attach(Object* object,
+                                   const SubscriptionFilter& filter) {
+        for (auto& el : filter.getPredicates())
+            if (el.field >= fields_.size())
+                throw std::out_of_range("ec::IndexedHandlerList field");
+
+        std::lock_guard lock(index_lock_);
+        filters_[object] = filter;
+        filters_version_.fetch_add(1);
+        return Base::attach(object);
+    }
+
+    /// Detaching a handler waits for the calls that may still
+    /// reach it through the index, like callConcurrent(). A
+    /// call that recompiles waits the same way for the calls
+    /// still reading the replaced index.
+    void call(const Data& data) override {
+        while (true) {
+            {
+                DispatchGate::Guard guard(Base::gate_);
+                const Compiled* index =
+                    current_.load(std::memory_order_acquire);
+
+                // Also stale when compiled before a detach that did
+                // not see the guard.
+                if (index != nullptr && index->version == version_()) {
+                    dispatch_(*index, data);
+                    return;
+                }
+            }
+            recompile_();
+        }
+    }
+
+    void callConcurrent(const Data& data) override { call(data); }
+};
+
+}  // namespace ec
+
+#endif
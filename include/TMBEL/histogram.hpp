@@ -0,0 +1,70 @@
+#ifndef _TMBEL_HISTOGRAM_HPP_
+#define _TMBEL_HISTOGRAM_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+/// \brief Log-linear histogram of durations or sizes.
+///
+/// Every power of two range is split into 16 buckets, so a
+/// percentile is within ~6% of the recorded value for any
+/// magnitude. Not synchronized.
+////////////////////////////////////////////////////////////
+class Histogram {
+ public:
+    static constexpr size_t sub_bucket_bits  = 4;
+    static constexpr size_t sub_bucket_count = 1 << sub_bucket_bits;
+    static constexpr size_t bucket_count =
+        sub_bucket_count + (64 - sub_bucket_bits) * sub_bucket_count;
+
+ protected:
+    std::array<uint64_t, bucket_count> buckets_;
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t max_;
+
+ public:
+    static size_t bucketOf(uint64_t value);
+
+    /// Largest value that falls into bucket.
+    static uint64_t bucketValue(size_t bucket);
+
+    Histogram();
+
+    void record(uint64_t value) {
+        ++buckets_[bucketOf(value)];
+        ++count_;
+        sum_ += value;
+        if (value > max_) max_ = value;
+    }
+
+    /// Records count samples of value at once.
+    void record(uint64_t value, uint64_t count) {
+        if (count == 0) return;
+        buckets_[bucketOf(value)] += count;
+        count_ += count;
+        sum_ += value * count;
+        if (value > max_) max_ = value;
+    }
+
+    void merge(const Histogram& other);
+    void clear();
+
+    uint64_t count() const;
+    uint64_t sum() const;
+    uint64_t max() const;
+    double mean() const;
+
+    /// Value below which fraction q (0..1) of samples lie.
+    uint64_t percentile(double q) const;
+
+    uint64_t bucket(size_t index) const;
+};
+
+}  // namespace ec
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef _TMBEL_INPLACE_FUNCTION_HPP_
+#define _TMBEL_INPLACE_FUNCTION_HPP_
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#ifndef TMBEL_FUNCTION_CAPACITY
+#define TMBEL_FUNCTION_CAPACITY 64
+#endif
+
+namespace ec {
+
+/// Inline buffer of handler functions, async tasks and map()
+/// visitors, set with the FUNCTION_CAPACITY cmake option.
+constexpr size_t function_capacity = TMBEL_FUNCTION_CAPACITY;
+
+template <typename Signature, size_t Capacity = function_capacity>
+class InplaceFunction;
+
+////////////////////////////////////////////////////////////
+/// \brief Move-only callable wrapper that never allocates.
+///
+/// The callable is stored in a Capacity bytes buffer inside
+/// the object, a callable that does not fit is a compile
+/// error instead of a heap allocation. Like std::function
+/// it can be called through a const reference.
+////////////////////////////////////////////////////////////
+template <typename Result, typename... Args, size_t Capacity>
+class InplaceFunction<Result(Args...), Capacity> {
+ protected:
+    using Self = InplaceFunction;
+
+    using Invoke = Result (*)(void* storage, Args&&... args);
+    // Moves the callable to destination and destroys the source, only
+    // destroys it when destination is null.
+    using Manage = void (*)(void* destination, void* source);
+
+    alignas(std::max_align_t) unsigned char storage_[Capacity];
+    Invoke invoke_ = nullptr;
+    Manage manage_ = nullptr;
+
+    template <typename Func>
+    static Result callStored_(void* storage, Args&&... args) {
+        return std::invoke(*static_cast<Func*>(storage),
+                           std::forward<Args>(args)...);
+    }
+
+    template <typename Func>
+    static void manageStored_(void* destination, void* source) {
+        auto func = static_cast<Func*>(source);
+        if (destination != nullptr) new (destination) Func(std::move(*func));
+        func->~Func();
+    }
+
+    template <typename Func>
+    static bool isNull_(const Func& func) {
+        if constexpr (std::is_pointer_v<Func> || std::is_member_pointer_v<Func>)
+            return func == nullptr;
+        else
+            return false;
+    }
+
+    template <typename Signature>
+    static bool isNull_(const std::function<Signature>& func) {
+        return !func;
+    }
+
+    void take_(Self& other) {
+        if (other.manage_ == nullptr) return;
+
+        other.manage_(storage_, other.storage_);
+        invoke_       = other.invoke_;
+        manage_       = other.manage_;
+        other.invoke_ = nullptr;
+        other.manage_ = nullptr;
+    }
+
+ public:
+    static constexpr size_t capacity = Capacity;
+
+    InplaceFunction() = default;
+    InplaceFunction(std::nullptr_t) {}
+
+    template <typename Func,
+              typename Stored = std::decay_t<Func>,
+              typename        = std::enable_if_t<
+                  !std::is_same_v<Stored, Self> &&
+                  std::is_invocable_r_v<Result, Stored&, Args...>>>
+    InplaceFunction(Func&& func) {
+        static_assert(sizeof(Stored) <= Capacity,
+                      "Callable does not fit into ec::InplaceFunction, "
+                      "capture less or raise its capacity.");
+        static_assert(alignof(Stored) <= alignof(std::max_align_t),
+                      "Callable is over-aligned for ec::InplaceFunction.");
+
+        if (isNull_(func)) return;
+
+        new (storage_) Stored(std::forward<Func>(func));
+        invoke_ = &callStored_<Stored>;
+        manage_ = &manageStored_<Stored>;
+    }
+
+    InplaceFunction(const Self&) = delete;
+    InplaceFunction(Self&& other) noexcept { take_(other); }
+    ~InplaceFunction() { reset(); }
+
+    Self& operator=(const Self&) = delete;
+
+    Self& operator=(Self&& other) noexcept {
+        if (this != &other) {
+            reset();
+            take_(other);
+        }
+        return *this;
+    }
+
+    Self& operator=(std::nullptr_t) {
+        reset();
+        return *this;
+    }
+
+    void reset() {
+        if (manage_ != nullptr) manage_(nullptr, storage_);
+        invoke_ = nullptr;
+        manage_ = nullptr;
+    }
+
+    explicit operator bool() const { return invoke_ != nullptr; }
+
+    Result operator()(Args... args) const {
+        if (invoke_ == nullptr) throw std::bad_function_call();
+        return invoke_(const_cast<unsigned char*>(storage_),
+                       std::forward<Args>(args)...);
+    }
+};
+
+}  // namespace ec
+
+#endif
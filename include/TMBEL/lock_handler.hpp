@@ -1,37 +1,99 @@
 #ifndef _TMBEL_LOCK_HANDLER_HPP_
 #define _TMBEL_LOCK_HANDLER_HPP_
 
+#include <TMBEL/adaptive_mutex.hpp>
+#include <TMBEL/lock_profile.hpp>
 #include <TMBEL/multithread_list.hpp>
 #include <TMBEL/singleton.hpp>
+#include <atomic>
 #include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
 
 namespace ec {
 
+////////////////////////////////////////////////////////////
+/// \brief Lock implementation that backs a group of
+/// handlers.
+////////////////////////////////////////////////////////////
+enum class MutexType {
+    Recursive,  ///< std::recursive_mutex, handlers may re-enter the group.
+    Adaptive,   ///< ec::AdaptiveMutex, cheaper but not re-entrant.
+    Shared      ///< std::shared_mutex, readers of the group run in parallel.
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Access that a handler declares to its group.
+/// Read access is only shared for MutexType::Shared groups,
+/// other groups treat it as Write.
+////////////////////////////////////////////////////////////
+enum class MutexAccess { Read, Write };
+
 class MutexObjectBase {
  protected:
-    size_t ref_counter_;
+    std::atomic<size_t> ref_counter_;
+    MutexType type_;
     std::recursive_mutex lock_;
+    AdaptiveMutex adaptive_lock_;
+    std::shared_mutex shared_lock_;
+
+#ifdef TMBEL_LOCK_PROFILING
+    // Renaming may race with getProfile() on another thread.
+    mutable std::mutex name_lock_;
+    std::string name_;
+    LockProfile profile_;
+#endif
+
+    void rawLock_();
+    bool rawTryLock_();
+    void rawUnlock_();
+    void rawLockShared_();
+    bool rawTryLockShared_();
+    void rawUnlockShared_();
 
  public:
-    MutexObjectBase();
+    MutexObjectBase(MutexType type = MutexType::Recursive);
     virtual ~MutexObjectBase();
 
-    std::recursive_mutex& get();
+    MutexType getType() const;
+
+    /// Name of the group in lock profiles, always empty
+    /// without TMBEL_LOCK_PROFILING.
+    void setName(const std::string& name);
+    std::string getName() const;
+
+    /// Owner is only used by lock profiling to attribute wait
+    /// time to the handler taking the lock.
+    void lock(const HandlerBase* owner = nullptr);
+    void unlock();
+    void lock_shared(const HandlerBase* owner = nullptr);
+    void unlock_shared();
     void increase();
     void decrease();
 
+    /// Counters of the group, empty when built without
+    /// TMBEL_LOCK_PROFILING.
+    LockProfileSnapshot getProfile(size_t top_count = 8) const;
+    void resetProfile();
+
 };
 
 class Mutex {
  protected:
     MutexObjectBase* reference_;
+    MutexAccess access_;
+
+#ifdef TMBEL_LOCK_PROFILING
+    const HandlerBase* owner_;
+#endif
 
     void decrease_();
     void increase_();
 
  public:
     Mutex();
-    Mutex(MutexObjectBase* pointer);
+    Mutex(MutexObjectBase* pointer, MutexAccess access = MutexAccess::Write);
     Mutex(const Mutex& other);
     Mutex(Mutex&& other);
     ~Mutex();
@@ -39,9 +101,29 @@ class Mutex {
     Mutex& operator=(const Mutex& other);
     Mutex& operator=(Mutex&& other);
 
+    /// Locks the group in the mode given by getAccess().
     void lock();
     void unlock();
 
+    void lock_shared();
+    void unlock_shared();
+
+    bool isEmpty() const;
+    MutexType getType() const;
+    MutexAccess getAccess() const;
+
+    /// Names the group in lock profiles.
+    void setName(const std::string& name);
+
+    /// Attributes waits through this reference to owner in
+    /// lock profiles. No-op without TMBEL_LOCK_PROFILING.
+    void setOwner(const HandlerBase* owner);
+
+    /// Reference to the same group with another access mode.
+    Mutex withAccess(MutexAccess access) const;
+    Mutex reader() const;
+    Mutex writer() const;
+
 };
 
 class MutexObject : protected MutexObjectBase, public SubObjectBase<MutexObject> {
@@ -51,9 +133,12 @@ class MutexObject : protected MutexObjectBase, public SubObjectBase<MutexObject>
     
 
  public:
-    MutexObject();
+    MutexObject(MutexType type = MutexType::Recursive);
     ~MutexObject() override;
     Mutex createRef();
+
+    LockProfileSnapshot getProfile(size_t top_count) const;
+    void resetProfile();
 };
 
 class MutexList : protected ObsObjectBase<MutexObject>, public Singleton<MutexList> {
@@ -67,7 +152,12 @@ class MutexList : protected ObsObjectBase<MutexObject>, public Singleton<MutexLi
     friend Singleton<MutexList>;
 
  public:
-    Mutex getMutex();
+    Mutex getMutex(MutexType type = MutexType::Recursive);
+
+    /// Snapshot of every live group, empty when built without
+    /// TMBEL_LOCK_PROFILING.
+    std::vector<LockProfileSnapshot> getProfile(size_t top_count = 8);
+    void resetProfile();
 
 };
 
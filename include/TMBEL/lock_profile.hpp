@@ -0,0 +1,105 @@
+#ifndef _TMBEL_LOCK_PROFILE_HPP_
+#define _TMBEL_LOCK_PROFILE_HPP_
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef TMBEL_LOCK_PROFILING
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#endif
+
+namespace ec {
+
+class HandlerBase;
+
+#ifdef TMBEL_LOCK_PROFILING
+constexpr bool lock_profiling_enabled = true;
+#else
+constexpr bool lock_profiling_enabled = false;
+#endif
+
+////////////////////////////////////////////////////////////
+/// \brief Histogram of durations, bucket i counts samples in
+/// [2^i, 2^(i+1)) nanoseconds.
+////////////////////////////////////////////////////////////
+constexpr size_t lock_histogram_size = 40;
+
+using LockHistogram = std::array<uint64_t, lock_histogram_size>;
+
+////////////////////////////////////////////////////////////
+/// \brief Time one handler spent waiting for a contended
+/// group. name is the one given with HandlerBase::setName(),
+/// empty for unnamed handlers and waits without owner.
+////////////////////////////////////////////////////////////
+struct LockWaiterStats {
+    const HandlerBase* owner = nullptr;
+    std::string name;
+    uint64_t contended     = 0;
+    uint64_t wait_ns_total = 0;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Copy of the counters of one ec::Mutex group.
+////////////////////////////////////////////////////////////
+struct LockProfileSnapshot {
+    const void* group = nullptr;
+    std::string name;
+
+    uint64_t acquisitions  = 0;
+    uint64_t contended     = 0;
+    uint64_t wait_ns_total = 0;
+    uint64_t hold_ns_total = 0;
+
+    LockHistogram wait_histogram{};
+    LockHistogram hold_histogram{};
+
+    /// Sorted by wait_ns_total, most waiting first.
+    std::vector<LockWaiterStats> top_waiters;
+};
+
+#ifdef TMBEL_LOCK_PROFILING
+
+////////////////////////////////////////////////////////////
+/// \brief Counters of one lock group. Uncontended paths only
+/// touch relaxed atomics, the waiter table is updated on the
+/// contended path only.
+////////////////////////////////////////////////////////////
+class LockProfile {
+ protected:
+    using Histogram = std::array<std::atomic<uint64_t>, lock_histogram_size>;
+
+    std::atomic<uint64_t> acquisitions_;
+    std::atomic<uint64_t> contended_;
+    std::atomic<uint64_t> wait_ns_total_;
+    std::atomic<uint64_t> hold_ns_total_;
+
+    Histogram wait_histogram_;
+    Histogram hold_histogram_;
+
+    mutable std::mutex waiters_lock_;
+    std::unordered_map<const HandlerBase*, LockWaiterStats> waiters_;
+
+ public:
+    static uint64_t now();
+
+    LockProfile();
+
+    /// Called after the lock was taken. wait_ns is zero when
+    /// it was acquired without contention.
+    void onAcquire(const HandlerBase* owner, bool contended,
+                   uint64_t wait_ns);
+    void onRelease();
+
+    void snapshot(LockProfileSnapshot* result, size_t top_count) const;
+    void reset();
+};
+
+#endif
+
+}  // namespace ec
+
+#endif
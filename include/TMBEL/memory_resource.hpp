@@ -0,0 +1,107 @@
+#ifndef _TMBEL_MEMORY_RESOURCE_HPP_
+#define _TMBEL_MEMORY_RESOURCE_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+/// \brief Monotonic arena with an owned initial buffer.
+///
+/// Deallocation is a no-op, memory comes back all at once
+/// with release(). The initial buffer is kept by release(),
+/// so a container that drains between bursts reuses it
+/// without touching the upstream allocator. Not synchronized,
+/// the owner has to serialize allocations.
+////////////////////////////////////////////////////////////
+class ArenaResource : public std::pmr::memory_resource {
+ protected:
+    std::unique_ptr<std::byte[]> buffer_;
+    std::pmr::monotonic_buffer_resource arena_;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const memory_resource& other) const noexcept override;
+
+ public:
+    static constexpr size_t default_size = 64 << 10;
+
+    explicit ArenaResource(size_t initial_size = default_size,
+                           std::pmr::memory_resource* upstream =
+                               std::pmr::get_default_resource());
+
+    ArenaResource(const ArenaResource&) = delete;
+    ArenaResource& operator=(const ArenaResource&) = delete;
+
+    /// Frees everything allocated since the last release().
+    void release();
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Process-wide recycler of small blocks such as list
+/// nodes, shared by all threads.
+///
+/// Every thread keeps its own free lists per size class, so
+/// allocation and deallocation take no locks. Blocks freed by
+/// another thread than the one that allocated them (a queue
+/// node pushed by a producer and popped by a consumer) are
+/// moved between threads in batches through a locked depot.
+/// Blocks above max_block_size, such as multi-KB payloads,
+/// are pooled by a synchronized_pool_resource up to
+/// max_large_size. Memory is kept for reuse and never
+/// returned.
+////////////////////////////////////////////////////////////
+class NodePoolResource : public std::pmr::memory_resource {
+ public:
+    static constexpr size_t granularity    = 16;
+    static constexpr size_t max_block_size = 512;
+    static constexpr size_t class_count    = max_block_size / granularity;
+    static constexpr size_t batch_size     = 64;
+    static constexpr size_t max_large_size = 64 << 10;
+
+    struct Block {
+        Block* next;
+    };
+
+    // Linked batch of batch_size blocks.
+    struct Batch {
+        Block* head;
+        size_t count;
+    };
+
+ protected:
+    struct Depot {
+        std::mutex lock;
+        std::vector<Batch> batches;
+    };
+
+    Depot depots_[class_count];
+    std::pmr::memory_resource* upstream_;
+    std::pmr::synchronized_pool_resource large_;
+
+    NodePoolResource();
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const memory_resource& other) const noexcept override;
+
+ public:
+    static NodePoolResource* getInstance();
+
+    NodePoolResource(const NodePoolResource&) = delete;
+    NodePoolResource& operator=(const NodePoolResource&) = delete;
+
+    /// Hands a batch of size class to the depot.
+    void pushBatch(size_t size_class, Batch batch);
+
+    /// Takes a batch of size class, count is zero when none.
+    Batch popBatch(size_t size_class);
+};
+
+}  // namespace ec
+
+#endif
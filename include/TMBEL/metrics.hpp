@@ -0,0 +1,269 @@
+#ifndef _TMBEL_METRICS_HPP_
+#define _TMBEL_METRICS_HPP_
+
+#include <TMBEL/histogram.hpp>
+#include <TMBEL/singleton.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+/// \brief Cheap timestamps for latency metrics. Ticks are
+/// TSC cycles on x86 and nanoseconds elsewhere, they are
+/// converted to nanoseconds only when metrics are read.
+////////////////////////////////////////////////////////////
+class MetricsClock {
+ public:
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+#endif
+    }
+
+    /// Calibrated against steady_clock since the start of the
+    /// program, the first call may wait a few milliseconds.
+    static double nsPerTick();
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Counters of one EventQueue.
+////////////////////////////////////////////////////////////
+struct QueueCounters {
+    uint64_t depth    = 0;
+    uint64_t enqueued = 0;
+    uint64_t dequeued = 0;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Calls and latency of one handler name, latencies
+/// are in nanoseconds. Percentiles come from the timed calls
+/// only and total_ns is extrapolated from them to all calls.
+////////////////////////////////////////////////////////////
+struct HandlerMetricsSnapshot {
+    std::string name;
+    uint64_t calls    = 0;
+    uint64_t timed    = 0;
+    uint64_t total_ns = 0;
+    uint64_t p50      = 0;
+    uint64_t p90      = 0;
+    uint64_t p99      = 0;
+    uint64_t p999     = 0;
+    uint64_t max      = 0;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Depth and throughput of one queue. Rates are
+/// events per second since the previous snapshot.
+////////////////////////////////////////////////////////////
+struct QueueMetricsSnapshot {
+    std::string name;
+    uint64_t depth      = 0;
+    uint64_t enqueued   = 0;
+    uint64_t dequeued   = 0;
+    double enqueue_rate = 0;
+    double dequeue_rate = 0;
+};
+
+struct MetricsSnapshot {
+    std::vector<HandlerMetricsSnapshot> handlers;
+    std::vector<QueueMetricsSnapshot> queues;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Call count and latency histogram of a handler.
+///
+/// Every thread records into its own shard with plain
+/// relaxed stores, so recording takes no locks and no atomic
+/// read-modify-write. Shards are merged when the metrics are
+/// read. Threads beyond max_threads share one shard that is
+/// updated with atomic adds.
+///
+/// Calls are always counted, but only every sample period-th
+/// call of a thread is timed, every 16th by default. Reading
+/// the clock twice is the bulk of the cost, so a longer
+/// period keeps the overhead low where the TSC is slow to
+/// read, e.g. in some VMs.
+////////////////////////////////////////////////////////////
+class HandlerMetrics {
+ public:
+    static constexpr size_t max_threads = 128;
+
+    static constexpr uint32_t default_sample_period = 16;
+
+ protected:
+    using Counter = std::atomic<uint64_t>;
+
+    struct alignas(64) Shard {
+        Counter calls{0};
+        Counter countdown{0};
+        Counter timed{0};
+        Counter ticks_total{0};
+        Counter max{0};
+        Counter buckets[Histogram::bucket_count];
+
+        Shard();
+    };
+
+    static constexpr size_t shared_slot = max_threads;
+    static constexpr size_t no_slot     = SIZE_MAX;
+
+    // Constant initialized, so reading it needs no TLS guard.
+    static inline thread_local size_t thread_slot_ = no_slot;
+
+    std::string name_;
+    std::atomic<Shard*> shards_[max_threads + 1];
+    std::atomic<uint32_t> sample_period_{default_sample_period};
+
+    // Takes a slot for the calling thread on its first record.
+    static size_t assignSlot_();
+
+    static size_t threadSlot_() {
+        size_t slot = thread_slot_;
+        return slot != no_slot ? slot : assignSlot_();
+    }
+
+    static void add_(Counter& counter, uint64_t value, bool shared) {
+        if (shared)
+            counter.fetch_add(value, std::memory_order_relaxed);
+        else
+            counter.store(counter.load(std::memory_order_relaxed) + value,
+                          std::memory_order_relaxed);
+    }
+
+    Shard* allocate_(size_t slot);
+
+ public:
+    HandlerMetrics(const std::string& name);
+    ~HandlerMetrics();
+
+    HandlerMetrics(const HandlerMetrics&) = delete;
+    HandlerMetrics& operator=(const HandlerMetrics&) = delete;
+
+    const std::string& getName() const;
+
+    /// Every period-th call is timed, 1 times all of them.
+    void setSamplePeriod(uint32_t period);
+    uint32_t getSamplePeriod() const;
+
+    /// Counts one call, returns true when it should be timed
+    /// and passed to record().
+    bool count() {
+        size_t slot  = threadSlot_();
+        Shard* shard = shards_[slot].load(std::memory_order_acquire);
+        if (shard == nullptr) shard = allocate_(slot);
+
+        uint32_t period = sample_period_.load(std::memory_order_relaxed);
+        if (slot == shared_slot)
+            return shard->calls.fetch_add(1, std::memory_order_relaxed) %
+                       period ==
+                   0;
+
+        add_(shard->calls, 1, false);
+        if (period <= 1) return true;
+
+        uint64_t countdown = shard->countdown.load(std::memory_order_relaxed);
+        if (countdown != 0) {
+            shard->countdown.store(countdown - 1, std::memory_order_relaxed);
+            return false;
+        }
+        shard->countdown.store(period - 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /// Records one timed call that took ticks of MetricsClock.
+    void record(uint64_t ticks) {
+        size_t slot  = threadSlot_();
+        Shard* shard = shards_[slot].load(std::memory_order_acquire);
+
+        bool shared = slot == shared_slot;
+        add_(shard->timed, 1, shared);
+        add_(shard->ticks_total, ticks, shared);
+        add_(shard->buckets[Histogram::bucketOf(ticks)], 1, shared);
+
+        uint64_t max = shard->max.load(std::memory_order_relaxed);
+        if (!shared) {
+            if (ticks > max) shard->max.store(ticks, std::memory_order_relaxed);
+        } else {
+            while (ticks > max &&
+                   !shard->max.compare_exchange_weak(max, ticks,
+                                                     std::memory_order_relaxed))
+                ;
+        }
+    }
+
+    void snapshot(HandlerMetricsSnapshot* result) const;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Registry of the handler and queue metrics of the
+/// process, exports them as Prometheus text.
+////////////////////////////////////////////////////////////
+class MetricsRegistry : public Singleton<MetricsRegistry> {
+ public:
+    using Position = uint64_t;
+    using Source   = std::function<QueueCounters()>;
+
+ protected:
+    using Self = MetricsRegistry;
+
+    friend Singleton<MetricsRegistry>;
+
+    struct Queue {
+        std::string name;
+        Source source;
+        QueueCounters last;
+        std::chrono::steady_clock::time_point last_time;
+    };
+
+    std::mutex lock_;
+    std::map<std::string, std::unique_ptr<HandlerMetrics>> handlers_;
+    std::map<Position, Queue> queues_;
+    Position next_position_ = 0;
+
+    MetricsRegistry();
+
+ public:
+    virtual ~MetricsRegistry() override;
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Metrics recorded under name, created on first
+    /// use. They live as long as the registry, so handlers
+    /// with the same name share and keep their counters.
+    ////////////////////////////////////////////////////////////
+    HandlerMetrics* getHandlerMetrics(const std::string& name);
+
+    /// source is called under the registry lock until the
+    /// queue is unwatched.
+    Position watchQueue(const std::string& name, Source source);
+    void unwatchQueue(Position position);
+
+    MetricsSnapshot snapshot();
+
+    /// Prometheus text exposition format.
+    void writeText(std::ostream& stream);
+
+    /// Writes the text to a temporary file renamed over path,
+    /// so scrapers never see a partial file.
+    bool writeText(const std::string& path);
+};
+
+}  // namespace ec
+
+#endif
@@ -1,8 +1,10 @@
 #ifndef _TMBEL_MULTITHREAD_LIST_HPP_
 #define _TMBEL_MULTITHREAD_LIST_HPP_
 
-#include <functional>
+#include <TMBEL/inplace_function.hpp>
+#include <atomic>
 #include <list>
+#include <memory_resource>
 #include <mutex>
 #include <type_traits>
 
@@ -12,11 +14,51 @@ template <typename Ty>
 class MtListBase {
  protected:
     using Self      = MtListBase;
-    using Container = std::list<Ty>;
+    using Container = std::pmr::list<Ty>;
 
     mutable std::recursive_mutex lock_;
     Container resource_;
 
+    // Bumped on every modification so that readers can cache copies.
+    std::atomic<size_t> version_{0};
+
+    // Running map() calls of the thread that holds the lock. Elements can
+    // be erased from inside func, erase() moves their next position on.
+    struct Iteration {
+        typename Container::iterator next;
+        Iteration* outer;
+    };
+
+    Iteration* iterations_ = nullptr;
+
+    // Run after elements were erased, see setEraseHook().
+    InplaceFunction<void()> erase_hook_;
+
+    void skip_(typename Container::iterator position) {
+        for (auto el = iterations_; el != nullptr; el = el->outer)
+            if (el->next == position) ++el->next;
+    }
+
+    // Lists with different resources cannot relink nodes.
+    void splice_(typename Container::iterator position, Container& other) {
+        if (resource_.get_allocator() == other.get_allocator()) {
+            resource_.splice(position, other);
+            return;
+        }
+        for (auto& el : other) resource_.insert(position, std::move(el));
+        other.clear();
+    }
+
+    template <typename Func>
+    void iterate_(Func& func) {
+        std::lock_guard lock(lock_);
+
+        Iteration iteration{resource_.begin(), iterations_};
+        iterations_ = &iteration;
+        while (iteration.next != resource_.end()) func(*iteration.next++);
+        iterations_ = iteration.outer;
+    }
+
  public:
     using Position        = typename Container::iterator;
     using value_type      = Ty;
@@ -26,7 +68,10 @@ class MtListBase {
     using const_reference = const value_type&;
     using distance_type   = ptrdiff_t;
 
-    MtListBase() = default;
+    /// Nodes come from resource, which has to outlive the list.
+    explicit MtListBase(std::pmr::memory_resource* resource =
+                            std::pmr::get_default_resource())
+        : resource_(resource) {}
     MtListBase(const Self& other) { *this = other; }
     MtListBase(Self&& other) { *this = std::move(other); }
     ~MtListBase() {
@@ -39,6 +84,7 @@ class MtListBase {
         this->lock_.lock();
 
         resource_ = other.resource_;
+        ++version_;
 
         this->lock_.unlock();
         other.lock_.unlock();
@@ -51,6 +97,7 @@ class MtListBase {
         this->lock_.lock();
 
         resource_ = std::move(other.resource_);
+        ++version_;
 
         this->lock_.unlock();
         other.lock_.unlock();
@@ -61,23 +108,27 @@ class MtListBase {
     Position push_back(const value_type& object) {
         std::lock_guard lock(lock_);
         resource_.push_back(object);
+        ++version_;
         return std::prev(resource_.end());
     }
 
     Position push_front(const value_type& object) {
         std::lock_guard lock(lock_);
         resource_.push_front(object);
+        ++version_;
         return resource_.begin();
     }
 
     Position insert(Position position, const value_type& object) {
         std::lock_guard lock(lock_);
+        ++version_;
         return resource_.insert(position, object);
     }
 
     template <typename... Args>
     Position emplace(Position position, Args&&... args) {
         std::lock_guard lock(lock_);
+        ++version_;
         return resource_.emplace(position, std::move(args...));
     }
 
@@ -85,6 +136,7 @@ class MtListBase {
     Position emplace_back(Args&&... args) {
         std::lock_guard lock(lock_);
         resource_.emplace_back(std::move(args...));
+        ++version_;
         return std::prev(resource_.end());
     }
 
@@ -92,29 +144,48 @@ class MtListBase {
     Position emplace_front(Args&&... args) {
         std::lock_guard lock(lock_);
         resource_.emplace_front(std::move(args...));
+        ++version_;
         return resource_.begin();
     }
 
     void erase(Position position) {
-        std::lock_guard lock(lock_);
-        resource_.erase(position);
+        {
+            std::lock_guard lock(lock_);
+            skip_(position);
+            resource_.erase(position);
+            ++version_;
+        }
+        if (erase_hook_) erase_hook_();
     }
 
     void erase(Position begin, Position end) {
-        std::lock_guard lock(lock_);
-        resource_.erase(begin, end);
+        {
+            std::lock_guard lock(lock_);
+            for (auto el = begin; el != end; ++el) skip_(el);
+            resource_.erase(begin, end);
+            ++version_;
+        }
+        if (erase_hook_) erase_hook_();
     }
 
     void clear() {
-        std::lock_guard lock(lock_);
-        resource_.clear();
+        {
+            std::lock_guard lock(lock_);
+            for (auto el = iterations_; el != nullptr; el = el->outer)
+                el->next = resource_.end();
+            resource_.clear();
+            ++version_;
+        }
+        if (erase_hook_) erase_hook_();
     }
 
     void splice(Position position, Self& other) {
         other.lock_.lock();
         this->lock_.lock();
 
-        resource_.splice(position, other);
+        splice_(position, other.resource_);
+        ++version_;
+        ++other.version_;
 
         this->lock_.unlock();
         other.lock_.unlock();
@@ -124,7 +195,9 @@ class MtListBase {
         other.lock_.lock();
         this->lock_.lock();
 
-        resource_.splice(position, std::move(other));
+        splice_(position, other.resource_);
+        ++version_;
+        ++other.version_;
 
         this->lock_.unlock();
         other.lock_.unlock();
@@ -140,17 +213,36 @@ class MtListBase {
         return resource_.empty();
     }
 
-    void map(std::function<void(Ty&)> func) {
-        std::lock_guard lock(lock_);
-        for (auto& el : resource_) func(el);
+    size_t version() const { return version_.load(std::memory_order_acquire); }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief hook runs after erase() and clear(), once the
+    /// elements are gone, e.g. to wait for readers of copies of
+    /// the list. It is not copied with the list and has to be
+    /// reset before the owner of the hook is destroyed.
+    ////////////////////////////////////////////////////////////
+    void setEraseHook(InplaceFunction<void()>&& hook) {
+        erase_hook_ = std::move(hook);
     }
 
-    void map(std::function<void(const Ty&)> func) const {
-        std::lock_guard lock(lock_);
-        for (auto& el : resource_) func(el);
+    std::pmr::memory_resource* getResource() const {
+        return resource_.get_allocator().resource();
+    }
+
+    /// func may erase any element of the list, including the
+    /// one it was called for.
+    void map(InplaceFunction<void(Ty&)> func) { iterate_(func); }
+
+    void map(InplaceFunction<void(const Ty&)> func) const {
+        // Elements are only passed as const, the iteration itself has to
+        // be registered for erase().
+        const_cast<Self*>(this)->iterate_(func);
     }
 };
 
+template <typename SubType>
+class ObsObjectBase;
+
 template <typename SubType>
 class SubObjectBase {
  protected:
@@ -158,6 +250,8 @@ class SubObjectBase {
 
     using Container = MtListBase<SubType*>;
 
+    friend class ObsObjectBase<SubType>;
+
  public:
     using Position = typename Container::Position;
 
@@ -165,6 +259,9 @@ class SubObjectBase {
     Position position_;
     Container* container_;
 
+    // Called by the list that is destroyed while the object is attached.
+    void release_() { container_ = nullptr; }
+
  public:
     SubObjectBase() : container_(nullptr) {}
     SubObjectBase(Container* container) { attachTo(container); }
@@ -208,13 +305,21 @@ class ObsObjectBase {
  public:
     using Position = typename Container::Position;
 
-    ObsObjectBase()          = default;
-    virtual ~ObsObjectBase() = default;
+    ObsObjectBase() = default;
+    explicit ObsObjectBase(std::pmr::memory_resource* resource)
+        : sub_list_(resource) {}
+    virtual ~ObsObjectBase() {
+        sub_list_.map([](SubType* el) {
+            static_cast<SubObjectBase<SubType>*>(el)->release_();
+        });
+    }
 
-    inline void map(std::function<void(SubType*)> func) { sub_list_.map(func); }
+    inline void map(InplaceFunction<void(SubType*)> func) {
+        sub_list_.map([&func](SubType*& el) { func(el); });
+    }
 
-    inline void map(std::function<void(const SubType*)> func) const {
-        sub_list_.map(func);
+    inline void map(InplaceFunction<void(const SubType*)> func) const {
+        sub_list_.map([&func](SubType* const& el) { func(el); });
     }
 
     inline Position attach(Object* object) {
@@ -0,0 +1,167 @@
+#ifndef _TMBEL_PAYLOAD_HPP_
+#define _TMBEL_PAYLOAD_HPP_
+
+#include <TMBEL/memory_resource.hpp>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <utility>
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+/// \brief Handle to an immutable value shared by reference
+/// count.
+///
+/// Used as event data when one event fans out to many
+/// handlers: EventQueue and HandlerList pass the handle, so
+/// copying it (for example into an AsyncFuncHandler task)
+/// costs one atomic increment whatever the size of the
+/// value. The count lives next to the value in a block of
+/// NodePoolResource. A default constructed handle is empty.
+////////////////////////////////////////////////////////////
+template <typename Ty>
+class Shared {
+ protected:
+    using Self = Shared<Ty>;
+
+    struct Block {
+        std::atomic<size_t> references{1};
+        const Ty value;
+
+        template <typename... Args>
+        Block(Args&&... args) : value(std::forward<Args>(args)...) {}
+    };
+
+    Block* block_ = nullptr;
+
+    explicit Shared(Block* block) : block_(block) {}
+
+    void acquire_() const {
+        if (block_ != nullptr)
+            block_->references.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release_() {
+        if (block_ == nullptr ||
+            block_->references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+
+        block_->~Block();
+        NodePoolResource::getInstance()->deallocate(block_, sizeof(Block),
+                                                    alignof(Block));
+    }
+
+ public:
+    using element_type = const Ty;
+
+    /// Builds the value in place from args.
+    template <typename... Args>
+    static Self make(Args&&... args) {
+        void* memory = NodePoolResource::getInstance()->allocate(
+            sizeof(Block), alignof(Block));
+        try {
+            return Self(new (memory) Block(std::forward<Args>(args)...));
+        } catch (...) {
+            NodePoolResource::getInstance()->deallocate(memory, sizeof(Block),
+                                                        alignof(Block));
+            throw;
+        }
+    }
+
+    Shared() = default;
+    Shared(const Self& other) : block_(other.block_) { acquire_(); }
+    Shared(Self&& other) noexcept : block_(other.block_) {
+        other.block_ = nullptr;
+    }
+    ~Shared() { release_(); }
+
+    Self& operator=(const Self& other) {
+        other.acquire_();
+        release_();
+        block_ = other.block_;
+        return *this;
+    }
+
+    Self& operator=(Self&& other) noexcept {
+        if (this != &other) {
+            release_();
+            block_       = other.block_;
+            other.block_ = nullptr;
+        }
+        return *this;
+    }
+
+    void reset() {
+        release_();
+        block_ = nullptr;
+    }
+
+    const Ty* get() const { return block_ ? &block_->value : nullptr; }
+    const Ty& operator*() const { return block_->value; }
+    const Ty* operator->() const { return &block_->value; }
+
+    explicit operator bool() const { return block_ != nullptr; }
+
+    size_t useCount() const {
+        return block_ ? block_->references.load(std::memory_order_relaxed) : 0;
+    }
+
+    bool operator==(const Self& other) const { return block_ == other.block_; }
+    bool operator!=(const Self& other) const { return block_ != other.block_; }
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Immutable byte buffer shared by reference count.
+///
+/// The bytes are copied once on creation into a single
+/// pooled block behind the count, every further copy of
+/// the buffer only copies the handle.
+////////////////////////////////////////////////////////////
+class SharedBuffer {
+ protected:
+    using Self = SharedBuffer;
+
+    struct alignas(16) Header {
+        std::atomic<size_t> references{1};
+        size_t size;
+    };
+
+    Header* header_ = nullptr;
+
+    explicit SharedBuffer(Header* header) : header_(header) {}
+
+    void acquire_() const;
+    void release_();
+
+ public:
+    /// Copies size bytes of data into a new buffer.
+    static Self copy(const void* data, size_t size);
+    static Self copy(std::string_view data);
+
+    SharedBuffer() = default;
+    SharedBuffer(const Self& other);
+    SharedBuffer(Self&& other) noexcept;
+    ~SharedBuffer();
+
+    Self& operator=(const Self& other);
+    Self& operator=(Self&& other) noexcept;
+
+    void reset();
+
+    const std::byte* data() const;
+    size_t size() const;
+    bool empty() const;
+
+    std::string_view view() const;
+
+    size_t useCount() const;
+
+    bool operator==(const Self& other) const;
+    bool operator!=(const Self& other) const;
+};
+
+}  // namespace ec
+
+#endif
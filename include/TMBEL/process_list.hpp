@@ -1,6 +1,7 @@
 #ifndef _TMBEL_PROCESS_LIST_HPP_
 #define _TMBEL_PROCESS_LIST_HPP_
 
+#include <TMBEL/inplace_function.hpp>
 #include <TMBEL/lock_handler.hpp>
 #include <TMBEL/multithread_list.hpp>
 #include <thread>
@@ -8,6 +9,9 @@
 namespace ec {
 
 class ProcessList {
+ public:
+    using Task = InplaceFunction<void()>;
+
  protected:
     using Container = MtListBase<std::thread>;
 
@@ -23,12 +27,12 @@ class ProcessList {
     Mutex getMutex() const;
     void clearMutex() const;
 
-    template<typename Callable, typename... Args>
-    void exec(Callable&& callable, Args&&... args) {
+    /// Runs task on a new thread holding the mutex.
+    void exec(Task&& task) {
         std::lock_guard lock(lock_);
-        resource_.emplace_back([this, callable, args...](){
+        resource_.emplace_back([this, task = std::move(task)]() {
             global_lock_.lock();
-            callable(std::move<Args>(args)...);
+            task();
             global_lock_.unlock();
         });
     }
@@ -0,0 +1,63 @@
+#ifndef _TMBEL_REACTOR_HPP_
+#define _TMBEL_REACTOR_HPP_
+
+#ifdef __linux__
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+/// \brief Thin epoll wrapper that calls a callback when a
+/// watched file descriptor becomes ready.
+///
+/// Descriptors are watched edge-triggered, so a callback has
+/// to read until EAGAIN. An eventfd is always watched to let
+/// other threads interrupt poll() with wake().
+////////////////////////////////////////////////////////////
+class Reactor {
+ public:
+    using Callback = std::function<void(int fd, uint32_t events)>;
+
+ protected:
+    using Self = Reactor;
+
+    static constexpr int batch_size = 64;
+
+    int epoll_fd_;
+    int wake_fd_;
+
+    std::mutex lock_;
+    std::unordered_map<int, std::shared_ptr<Callback>> callbacks_;
+
+ public:
+    Reactor();
+    Reactor(const Self&) = delete;
+    ~Reactor();
+
+    Self& operator=(const Self&) = delete;
+
+    /// Watches fd for events (EPOLLIN, EPOLLOUT, ...), EPOLLET
+    /// is added implicitly. Replaces the callback if fd is
+    /// already watched.
+    void watch(int fd, uint32_t events, Callback callback);
+    void unwatch(int fd);
+
+    /// Waits up to timeout_ms (-1 forever) and runs callbacks
+    /// of ready descriptors. Returns the number of callbacks
+    /// called, wake-ups are not counted.
+    size_t poll(int timeout_ms);
+
+    /// Interrupts a poll() running in another thread.
+    void wake();
+};
+
+}  // namespace ec
+
+#endif
+
+#endif
@@ -0,0 +1,318 @@
+#ifndef _TMBEL_RECORDER_HPP_
+#define _TMBEL_RECORDER_HPP_
+
+#include <TMBEL/controller.hpp>
+#include <TMBEL/handler.hpp>
+#include <TMBEL/payload.hpp>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+/// \brief Turns events into bytes for EventRecorder and
+/// back for Replayer.
+///
+/// Trivially copyable types are stored as they are in
+/// memory, std::string and SharedBuffer as their bytes.
+/// Other types need a specialization with the same two
+/// static functions, or a serializer passed to
+/// RecordHandler and Replayer as template argument.
+////////////////////////////////////////////////////////////
+template <typename Data, typename = void>
+struct Serializer;
+
+template <typename Data>
+struct Serializer<Data,
+                  std::enable_if_t<std::is_trivially_copyable<Data>::value>> {
+    static void write(const Data& data, std::string* out) {
+        out->append(reinterpret_cast<const char*>(&data), sizeof(Data));
+    }
+
+    static bool read(std::string_view in, Data* data) {
+        if (in.size() != sizeof(Data)) return false;
+        std::memcpy(data, in.data(), sizeof(Data));
+        return true;
+    }
+};
+
+template <>
+struct Serializer<std::string> {
+    static void write(const std::string& data, std::string* out) {
+        out->append(data);
+    }
+
+    static bool read(std::string_view in, std::string* data) {
+        data->assign(in);
+        return true;
+    }
+};
+
+template <>
+struct Serializer<SharedBuffer> {
+    static void write(const SharedBuffer& data, std::string* out) {
+        out->append(data.view());
+    }
+
+    static bool read(std::string_view in, SharedBuffer* data) {
+        *data = SharedBuffer::copy(in);
+        return true;
+    }
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Writes timestamped records to a binary file.
+///
+/// The file starts with the magic "TMBELREC" and a version,
+/// every record is the time since the previous one in
+/// nanoseconds and the size of its bytes as varints, then
+/// the bytes. Records are appended to a buffer that is
+/// written when full, by the calling thread or, in async
+/// mode, by a writer thread while the next buffer fills.
+////////////////////////////////////////////////////////////
+class EventRecorder {
+ public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr char magic[8] = {'T', 'M', 'B', 'E', 'L', 'R', 'E', 'C'};
+    static constexpr uint32_t version   = 1;
+    static constexpr size_t header_size = 16;
+
+ protected:
+    using Self = EventRecorder;
+
+    std::mutex lock_;
+    std::FILE* file_ = nullptr;
+    std::string buffer_;
+    size_t buffer_size_;
+    Clock::time_point origin_;
+    uint64_t last_  = 0;
+    uint64_t count_ = 0;
+
+    bool async_ = false;
+    std::thread writer_;
+    std::condition_variable wait_;
+    std::vector<std::string> pending_;
+    std::vector<std::string> spare_;
+    bool writing_  = false;
+    bool stopping_ = false;
+    int error_     = 0;
+
+    // Returns false with errno set on a failed write.
+    bool writeFile_(const std::string& buffer);
+    void record_(std::unique_lock<std::mutex>& lock, uint64_t time,
+                 std::string_view bytes);
+    void submit_(std::unique_lock<std::mutex>& lock);
+    void throwError_();
+    void work_();
+
+ public:
+    ////////////////////////////////////////////////////////////
+    /// \brief Creates or truncates path. Times are counted from
+    /// the construction.
+    ////////////////////////////////////////////////////////////
+    explicit EventRecorder(const std::string& path, bool async = false,
+                           size_t buffer_size = 1 << 16);
+    EventRecorder(const Self&) = delete;
+    ~EventRecorder();
+
+    Self& operator=(const Self&) = delete;
+
+    /// Appends a record stamped with the current time.
+    void record(std::string_view bytes);
+
+    /// Appends a record with an explicit time in nanoseconds
+    /// since the start, times must not decrease.
+    void record(uint64_t time, std::string_view bytes);
+
+    /// Writes everything recorded so far to the file.
+    void flush();
+
+    /// Flushes and closes the file, later records are dropped.
+    /// The file is closed even if the flush fails, the write
+    /// error is thrown after that.
+    void close();
+
+    uint64_t count();
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Reads the records of an EventRecorder file, which
+/// is loaded into memory at once.
+////////////////////////////////////////////////////////////
+class RecordReader {
+ protected:
+    std::string data_;
+    size_t position_ = EventRecorder::header_size;
+    uint64_t time_   = 0;
+
+ public:
+    explicit RecordReader(const std::string& path);
+
+    /// Gives out the next record, time in nanoseconds since
+    /// the start of the recording. bytes point into the
+    /// reader. Returns false at the end and throws on a
+    /// truncated record.
+    bool next(uint64_t* time, std::string_view* bytes);
+
+    void rewind();
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Handler that records every event it receives.
+///
+/// Can be attached to any HandlerList next to the real
+/// handlers, serialization happens on the dispatching
+/// thread into a buffer that is reused.
+////////////////////////////////////////////////////////////
+template <typename Data, typename Serial = Serializer<Data>>
+class RecordHandler : public Handler<Data> {
+ protected:
+    using Self = RecordHandler<Data, Serial>;
+
+    EventRecorder recorder_;
+
+ public:
+    explicit RecordHandler(const std::string& path, bool async = false,
+                           size_t buffer_size = 1 << 16)
+        : recorder_(path, async, buffer_size) {}
+
+    // Detached before recorder_ closes the file.
+    ~RecordHandler() override { this->detach(); }
+
+    void call(const Data& data) override {
+        thread_local std::string bytes;
+        bytes.clear();
+        Serial::write(data, &bytes);
+        recorder_.record(bytes);
+    }
+
+    EventRecorder* getRecorder() { return &recorder_; }
+};
+
+////////////////////////////////////////////////////////////
+/// \brief How Replayer paces the events.
+////////////////////////////////////////////////////////////
+enum class ReplayMode {
+    Throughput,  ///< As fast as possible.
+    Timed        ///< With the recorded gaps between events.
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Result of Replayer::replay(), times in
+/// nanoseconds. Lag is how late a timed event was pushed.
+////////////////////////////////////////////////////////////
+struct ReplayStats {
+    uint64_t events   = 0;
+    uint64_t elapsed  = 0;
+    uint64_t max_lag  = 0;
+    uint64_t mean_lag = 0;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Feeds a recording into a controller.
+///
+/// The recording is decoded up front, so a replay only
+/// pushes ready events and every replay of a file pushes
+/// the same events in the same order. A controller without
+/// running workers is drained with call() after every event
+/// in timed mode and after every batch_size events in
+/// throughput mode, which also makes the dispatch order the
+/// same on every run.
+////////////////////////////////////////////////////////////
+template <typename Data, typename Serial = Serializer<Data>>
+class Replayer {
+ public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t batch_size = 256;
+
+ protected:
+    using Self = Replayer<Data, Serial>;
+
+    // Sleeps until this much before an event and spins the rest.
+    static constexpr std::chrono::microseconds spin_time{50};
+
+    std::vector<uint64_t> times_;
+    std::vector<Data> events_;
+
+ public:
+    /// Throws std::runtime_error on a record Serial rejects.
+    explicit Replayer(const std::string& path) {
+        RecordReader reader(path);
+        uint64_t time;
+        std::string_view bytes;
+
+        while (reader.next(&time, &bytes)) {
+            Data data;
+            if (!Serial::read(bytes, &data))
+                throw std::runtime_error("ec::Replayer cannot decode record " +
+                                         std::to_string(events_.size()) +
+                                         " of " + path);
+            times_.push_back(time);
+            events_.push_back(std::move(data));
+        }
+    }
+
+    size_t size() const { return events_.size(); }
+
+    const std::vector<Data>& getEvents() const { return events_; }
+
+    /// In timed mode speed scales the recorded gaps, 2 replays
+    /// twice as fast.
+    ReplayStats replay(ControllerBase<Data>* controller, ReplayMode mode,
+                       double speed = 1.0) const {
+        ReplayStats result;
+        result.events = events_.size();
+        if (events_.empty()) return result;
+
+        bool drain       = !controller->isRunning();
+        uint64_t lag_sum = 0;
+        auto begin       = Clock::now();
+
+        for (size_t i = 0; i < events_.size(); ++i) {
+            if (mode == ReplayMode::Timed) {
+                auto target =
+                    begin + std::chrono::duration_cast<Clock::duration>(
+                                std::chrono::duration<double, std::nano>(
+                                    (times_[i] - times_.front()) / speed));
+                if (Clock::now() < target - spin_time)
+                    std::this_thread::sleep_until(target - spin_time);
+                while (Clock::now() < target) {}
+
+                uint64_t lag =
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        Clock::now() - target)
+                        .count();
+                lag_sum += lag;
+                result.max_lag = std::max(result.max_lag, lag);
+            }
+
+            controller->push(events_[i]);
+            if (drain && (mode == ReplayMode::Timed || i % batch_size == 0))
+                controller->call();
+        }
+        if (drain) controller->call();
+
+        result.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             Clock::now() - begin)
+                             .count();
+        if (mode == ReplayMode::Timed) result.mean_lag = lag_sum / result.events;
+        return result;
+    }
+};
+
+}  // namespace ec
+
+#endif
@@ -0,0 +1,333 @@
+#ifndef _TMBEL_SHARED_QUEUE_HPP_
+#define _TMBEL_SHARED_QUEUE_HPP_
+
+#ifdef __linux__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+/// \brief Who may use the two ends of a SharedQueue.
+////////////////////////////////////////////////////////////
+enum class SharedQueueMode : uint32_t {
+    Spsc,  ///< One producer and one consumer, no atomic read-modify-writes.
+    Mpsc   ///< Any number of producers, ends are claimed with a CAS.
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Mapping of a shared memory queue, the part of
+/// SharedQueue that does not depend on the event type.
+///
+/// The region starts with a Header followed by capacity
+/// slots of slot_size bytes. Blocking uses process-shared
+/// futexes on words of the header, a side only issues the
+/// wake syscall when the other one announced it sleeps.
+////////////////////////////////////////////////////////////
+class SharedQueueBase {
+ protected:
+    using Self = SharedQueueBase;
+
+    static constexpr uint64_t magic   = 0x5453424d4551484dULL;
+    static constexpr uint32_t version = 1;
+
+    struct alignas(64) Header {
+        uint64_t magic;
+        uint32_t version;
+        SharedQueueMode mode;
+        uint64_t slot_size;
+        uint64_t type;  // hash of the mangled name of the event type
+        uint64_t capacity;
+
+        alignas(64) std::atomic<uint64_t> tail;  // next slot to write
+        alignas(64) std::atomic<uint64_t> head;  // next slot to read
+
+        // Futex words, bumped when a sleeping side has to wake up.
+        alignas(64) std::atomic<uint32_t> readable;
+        std::atomic<uint32_t> consumers_waiting;
+        std::atomic<uint32_t> closed;
+        alignas(64) std::atomic<uint32_t> writable;
+        std::atomic<uint32_t> producers_waiting;
+    };
+
+    int fd_           = -1;
+    size_t size_      = 0;
+    Header* header_   = nullptr;
+    std::byte* slots_ = nullptr;
+
+    SharedQueueBase() = default;
+
+    /// Creates the region on fd (sized by this call) or maps the
+    /// existing one, checking it was made for the same type.
+    void create_(int fd, size_t capacity, size_t slot_size,
+                 const std::type_info& type, SharedQueueMode mode);
+    void map_(int fd, size_t slot_size, const std::type_info& type);
+
+    static uint64_t typeHash_(const std::type_info& type);
+
+    static int createFd_(const std::string& name);
+    static int openFd_(const std::string& name);
+    static int anonymousFd_();
+    static int duplicateFd_(int fd);
+
+    // Wakes consumers sleeping in waitReadable_() after a push.
+    void notifyReadable_() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (header_->consumers_waiting.load(std::memory_order_relaxed) != 0)
+            wakeReadable_();
+    }
+
+    // Wakes producers sleeping in waitWritable_() after a pop.
+    void notifyWritable_() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (header_->producers_waiting.load(std::memory_order_relaxed) != 0)
+            wakeWritable_();
+    }
+
+    void wakeReadable_();
+    void wakeWritable_();
+
+    /// Sleeps until a push or close() changes the readable word
+    /// from seen. The caller announced itself in
+    /// consumers_waiting and checked the queue after that.
+    void waitReadable_(uint32_t seen);
+    void waitWritable_(uint32_t seen);
+
+ public:
+    SharedQueueBase(const Self&) = delete;
+    SharedQueueBase(Self&& other) noexcept;
+    ~SharedQueueBase();
+
+    Self& operator=(const Self&) = delete;
+    Self& operator=(Self&& other) noexcept;
+
+    static void unlink(const std::string& name);
+
+    /// Descriptor of the region, to be inherited by fork() or
+    /// sent with SCM_RIGHTS and opened with open(fd).
+    int getFd() const { return fd_; }
+
+    size_t capacity() const { return header_->capacity; }
+    SharedQueueMode getMode() const { return header_->mode; }
+
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+
+    /// Wakes every waiter, waitEvent() returns false once the
+    /// queue is drained and push() drops events.
+    void close();
+    bool isClosed() const;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Bounded event queue in shared memory that another
+/// process can push to or consume from.
+///
+/// Events are copied into and out of the slots of a ring
+/// (Vyukov's bounded queue), nothing goes through the
+/// kernel unless a side has to sleep. Data must be trivially
+/// copyable and must not contain pointers into the address
+/// space of one process. In Mpsc mode several consumers are
+/// tolerated as well, every event is taken once.
+///
+/// The queue keeps the EventQueue interface (push(),
+/// pollEvent(), waitEvent()) and adds pollEvents() to drain
+/// a batch, ControllerBase::loadEvents() accepts it.
+////////////////////////////////////////////////////////////
+template <typename Data>
+class SharedQueue : public SharedQueueBase {
+    static_assert(std::is_trivially_copyable<Data>::value,
+                  "SharedQueue events are copied between processes.");
+
+ protected:
+    using Self = SharedQueue<Data>;
+    using Base = SharedQueueBase;
+
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        Data data;
+    };
+
+    // Spins on an empty or full queue before sleeping.
+    static constexpr size_t spin_count = 64;
+
+    Slot& slot_(uint64_t position) {
+        return reinterpret_cast<Slot*>(slots_)[position &
+                                               (header_->capacity - 1)];
+    }
+
+    bool single_() const { return header_->mode == SharedQueueMode::Spsc; }
+
+    bool tryPush_(const Data& data) {
+        std::atomic<uint64_t>& tail = header_->tail;
+        uint64_t position           = tail.load(std::memory_order_relaxed);
+
+        while (true) {
+            Slot& slot        = slot_(position);
+            uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            int64_t diff      = int64_t(sequence - position);
+
+            if (diff == 0) {
+                if (single_()) {
+                    tail.store(position + 1, std::memory_order_relaxed);
+                    break;
+                }
+                if (tail.compare_exchange_weak(position, position + 1,
+                                               std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        Slot& slot = slot_(position);
+        slot.data  = data;
+        slot.sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop_(Data* data) {
+        std::atomic<uint64_t>& head = header_->head;
+        uint64_t position           = head.load(std::memory_order_relaxed);
+
+        while (true) {
+            Slot& slot        = slot_(position);
+            uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            int64_t diff      = int64_t(sequence - (position + 1));
+
+            if (diff == 0) {
+                if (single_()) {
+                    head.store(position + 1, std::memory_order_relaxed);
+                    break;
+                }
+                if (head.compare_exchange_weak(position, position + 1,
+                                               std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+
+        Slot& slot = slot_(position);
+        *data      = slot.data;
+        slot.sequence.store(position + header_->capacity,
+                            std::memory_order_release);
+        return true;
+    }
+
+ public:
+    using value_type = Data;
+
+    SharedQueue() = default;
+
+    /// Creates a named queue (shm_open) of at least capacity
+    /// events, failing if the name exists.
+    static Self create(const std::string& name, size_t capacity,
+                       SharedQueueMode mode = SharedQueueMode::Mpsc) {
+        Self result;
+        result.create_(createFd_(name), capacity, sizeof(Slot), typeid(Data),
+                       mode);
+        return result;
+    }
+
+    /// Creates an anonymous queue (memfd), shared through
+    /// getFd().
+    static Self create(size_t capacity,
+                       SharedQueueMode mode = SharedQueueMode::Mpsc) {
+        Self result;
+        result.create_(anonymousFd_(), capacity, sizeof(Slot), typeid(Data),
+                       mode);
+        return result;
+    }
+
+    static Self open(const std::string& name) {
+        Self result;
+        result.map_(openFd_(name), sizeof(Slot), typeid(Data));
+        return result;
+    }
+
+    /// Maps the queue of fd, which stays owned by the caller.
+    static Self open(int fd) {
+        Self result;
+        result.map_(duplicateFd_(fd), sizeof(Slot), typeid(Data));
+        return result;
+    }
+
+    /// Returns false when the queue is full or closed.
+    bool tryPush(const Data& data) {
+        if (isClosed() || !tryPush_(data)) return false;
+        notifyReadable_();
+        return true;
+    }
+
+    /// Waits for space while the queue is full, the event is
+    /// dropped if the queue is closed.
+    void push(const Data& data) {
+        for (size_t spin = 0;; ++spin) {
+            if (isClosed()) return;
+            if (tryPush_(data)) break;
+            if (spin < spin_count) continue;
+
+            uint32_t seen = header_->writable.load(std::memory_order_acquire);
+            header_->producers_waiting.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool pushed = tryPush_(data);
+            if (!pushed && !isClosed()) waitWritable_(seen);
+            header_->producers_waiting.fetch_sub(1, std::memory_order_relaxed);
+            if (pushed) break;
+        }
+        notifyReadable_();
+    }
+
+    bool pollEvent(Data* data) {
+        if (!tryPop_(data)) return false;
+        notifyWritable_();
+        return true;
+    }
+
+    /// Takes up to count events into events, returns how many.
+    size_t pollEvents(Data* events, size_t count) {
+        size_t result = 0;
+        while (result < count && tryPop_(events + result)) ++result;
+        if (result != 0) notifyWritable_();
+        return result;
+    }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Blocks until an event arrives. Returns false once
+    /// the queue is closed and empty.
+    ////////////////////////////////////////////////////////////
+    bool waitEvent(Data* data) {
+        for (size_t spin = 0;; ++spin) {
+            if (pollEvent(data)) return true;
+            if (spin < spin_count) continue;
+            if (isClosed()) return pollEvent(data);
+
+            uint32_t seen = header_->readable.load(std::memory_order_acquire);
+            header_->consumers_waiting.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool found = tryPop_(data);
+            if (!found && !isClosed()) waitReadable_(seen);
+            header_->consumers_waiting.fetch_sub(1, std::memory_order_relaxed);
+            if (found) {
+                notifyWritable_();
+                return true;
+            }
+        }
+    }
+};
+
+}  // namespace ec
+
+#endif
+
+#endif
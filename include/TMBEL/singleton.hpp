@@ -31,7 +31,7 @@ void clearResource();
 
 class SingletonBase {
  private:
-    using Position = std::list<SingletonBase*>::iterator;
+    using Position = SingletonList::Position;
 
     Position position_;
 
@@ -0,0 +1,212 @@
+#ifndef _TMBEL_SLOT_MAP_HPP_
+#define _TMBEL_SLOT_MAP_HPP_
+
+#include <atomic>
+#include <cstdint>
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+/// \brief Reference to a slot of ec::SlotMap. Generation is
+/// odd while the slot is occupied and changes every time the
+/// slot is freed, so stale handles never match a new value.
+////////////////////////////////////////////////////////////
+struct SlotHandle {
+    uint32_t index      = 0;
+    uint32_t generation = 0;
+
+    bool operator==(const SlotHandle& other) const {
+        return index == other.index && generation == other.generation;
+    }
+    bool operator!=(const SlotHandle& other) const { return !(*this == other); }
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Lock-free table of pointers addressed by
+/// generation-checked handles.
+///
+/// get() is wait-free, push() and pop() reuse freed slots
+/// through a lock-free free-list. Slots live in segments of
+/// growing size that are never moved or freed before the map
+/// itself, so a slot address stays valid forever.
+///
+/// Slots reserved with setCount() are addressed by index with
+/// push(index, value) and never given out by push(value).
+////////////////////////////////////////////////////////////
+template <typename Ty>
+class SlotMap {
+ protected:
+    using Self = SlotMap<Ty>;
+
+    struct Slot {
+        std::atomic<uint32_t> generation{0};
+        std::atomic<Ty*> value{nullptr};
+        std::atomic<uint32_t> next_free{0};
+        std::atomic<bool> reserved{false};
+    };
+
+    static constexpr uint32_t npos               = UINT32_MAX;
+    static constexpr uint64_t first_segment_size = 64;
+    static constexpr size_t segment_count        = 27;
+
+    std::atomic<Slot*> segments_[segment_count];
+    std::atomic<uint32_t> next_index_;
+    std::atomic<uint64_t> free_head_;  // ABA tag << 32 | index
+
+    static size_t segmentOf_(uint32_t index) {
+        return 63 - __builtin_clzll(index / first_segment_size + 1);
+    }
+
+    static uint64_t segmentBegin_(size_t segment) {
+        return first_segment_size * ((uint64_t(1) << segment) - 1);
+    }
+
+    Slot* locate_(uint32_t index) const {
+        size_t segment = segmentOf_(index);
+        Slot* slots    = segments_[segment].load(std::memory_order_acquire);
+        if (slots == nullptr) return nullptr;
+        return slots + (index - segmentBegin_(segment));
+    }
+
+    Slot* allocate_(uint32_t index) {
+        size_t segment = segmentOf_(index);
+        Slot* slots    = segments_[segment].load(std::memory_order_acquire);
+
+        if (slots == nullptr) {
+            Slot* created = new Slot[first_segment_size << segment];
+            if (segments_[segment].compare_exchange_strong(
+                    slots, created, std::memory_order_acq_rel))
+                slots = created;
+            else
+                delete[] created;
+        }
+        return slots + (index - segmentBegin_(segment));
+    }
+
+    void pushFree_(uint32_t index, Slot* slot) {
+        uint64_t head = free_head_.load(std::memory_order_relaxed);
+        uint64_t next;
+        do {
+            slot->next_free.store(static_cast<uint32_t>(head),
+                                  std::memory_order_relaxed);
+            next = (((head >> 32) + 1) << 32) | index;
+        } while (!free_head_.compare_exchange_weak(head, next,
+                                                   std::memory_order_release,
+                                                   std::memory_order_relaxed));
+    }
+
+    uint32_t popFree_() {
+        uint64_t head = free_head_.load(std::memory_order_acquire);
+        while (static_cast<uint32_t>(head) != npos) {
+            uint32_t index = static_cast<uint32_t>(head);
+            uint32_t next =
+                locate_(index)->next_free.load(std::memory_order_relaxed);
+            if (free_head_.compare_exchange_weak(
+                    head, (((head >> 32) + 1) << 32) | next,
+                    std::memory_order_acquire, std::memory_order_acquire))
+                return index;
+        }
+        return npos;
+    }
+
+ public:
+    SlotMap() : next_index_(0), free_head_(npos) {
+        for (auto& el : segments_) el.store(nullptr, std::memory_order_relaxed);
+    }
+
+    SlotMap(const Self&) = delete;
+    Self& operator=(const Self&) = delete;
+
+    ~SlotMap() {
+        for (auto& el : segments_) delete[] el.load(std::memory_order_relaxed);
+    }
+
+    /// Reserves fixed slots up to count. Does nothing for
+    /// indices that are already in use.
+    void setCount(uint32_t count) {
+        uint32_t current = next_index_.load(std::memory_order_relaxed);
+        while (current < count &&
+               !next_index_.compare_exchange_weak(current, count,
+                                                  std::memory_order_acq_rel))
+            ;
+
+        for (uint32_t i = current; i < count; ++i)
+            allocate_(i)->reserved.store(true, std::memory_order_release);
+    }
+
+    /// Returns nullptr when the handle is stale or invalid.
+    Ty* get(SlotHandle handle) const {
+        if (handle.index >= next_index_.load(std::memory_order_acquire))
+            return nullptr;
+
+        Slot* slot = locate_(handle.index);
+        if (slot == nullptr ||
+            slot->generation.load(std::memory_order_acquire) !=
+                handle.generation)
+            return nullptr;
+
+        Ty* value = slot->value.load(std::memory_order_acquire);
+        if (slot->generation.load(std::memory_order_acquire) !=
+            handle.generation)
+            return nullptr;
+        return value;
+    }
+
+    SlotHandle push(Ty* value) {
+        uint32_t index = popFree_();
+        if (index == npos)
+            index = next_index_.fetch_add(1, std::memory_order_acq_rel);
+
+        Slot* slot = allocate_(index);
+        uint32_t generation =
+            slot->generation.load(std::memory_order_relaxed) + 1;
+
+        slot->value.store(value, std::memory_order_release);
+        slot->generation.store(generation, std::memory_order_release);
+        return {index, generation};
+    }
+
+    /// Occupies reserved slot index. Returns false when the
+    /// slot is not reserved or already occupied.
+    bool push(uint32_t index, Ty* value, SlotHandle* handle) {
+        if (index >= next_index_.load(std::memory_order_acquire)) return false;
+
+        Slot* slot = locate_(index);
+        if (slot == nullptr || !slot->reserved.load(std::memory_order_acquire))
+            return false;
+
+        uint32_t generation = slot->generation.load(std::memory_order_acquire);
+        if ((generation & 1) ||
+            !slot->generation.compare_exchange_strong(
+                generation, generation + 1, std::memory_order_acq_rel))
+            return false;
+
+        slot->value.store(value, std::memory_order_release);
+        *handle = {index, generation + 1};
+        return true;
+    }
+
+    /// Frees the slot and returns its value, or nullptr when
+    /// the handle is stale or invalid.
+    Ty* pop(SlotHandle handle) {
+        if (!(handle.generation & 1) ||
+            handle.index >= next_index_.load(std::memory_order_acquire))
+            return nullptr;
+
+        Slot* slot = locate_(handle.index);
+        uint32_t generation = handle.generation;
+        if (slot == nullptr ||
+            !slot->generation.compare_exchange_strong(
+                generation, generation + 1, std::memory_order_acq_rel))
+            return nullptr;
+
+        Ty* value = slot->value.exchange(nullptr, std::memory_order_acq_rel);
+        if (!slot->reserved.load(std::memory_order_relaxed))
+            pushFree_(handle.index, slot);
+        return value;
+    }
+};
+
+}  // namespace ec
+
+#endif
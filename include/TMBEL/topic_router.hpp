@@ -0,0 +1,349 @@
+#ifndef _TMBEL_TOPIC_ROUTER_HPP_
+#define _TMBEL_TOPIC_ROUTER_HPP_
+
+#include <TMBEL/handler.hpp>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+/// \brief Routes events published to hierarchical topics
+/// like "market.eu.xetra.trades" to handler lists subscribed
+/// with patterns.
+///
+/// Levels are split by '.', '*' matches exactly one level
+/// and '#' matches zero or more levels and must be the last
+/// one. Resolved subscriber sets are cached per concrete
+/// topic, cached topics matched by a pattern are invalidated
+/// when the pattern is subscribed or unsubscribed. The cached
+/// topics are kept in a trie as well, so a change only walks
+/// the cached topics its pattern can reach. A full cache
+/// evicts one entry for every new one.
+////////////////////////////////////////////////////////////
+template <typename Data>
+class TopicRouter {
+ protected:
+    using Self         = TopicRouter<Data>;
+    using ObjContainer = HandlerList<Data>;
+
+ public:
+    using Position    = uint64_t;
+    using Subscribers = std::vector<ObjContainer*>;
+    using Resolved    = std::shared_ptr<const Subscribers>;
+
+ protected:
+    struct Node {
+        std::unordered_map<std::string, std::unique_ptr<Node>> children;
+        std::unique_ptr<Node> any_one;   // '*'
+        std::unique_ptr<Node> any_many;  // '#'
+        std::vector<std::pair<Position, ObjContainer*>> subscribers;
+
+        bool empty() const {
+            return children.empty() && !any_one && !any_many &&
+                   subscribers.empty();
+        }
+    };
+
+    // Trie of the cached topics
+    struct CacheNode {
+        std::unordered_map<std::string, std::unique_ptr<CacheNode>> children;
+        bool cached = false;  // the path to the node is a key of cache_
+    };
+
+    struct Subscription {
+        std::string pattern;
+        ObjContainer* handler;
+    };
+
+    using Levels = std::vector<std::string_view>;
+
+    mutable std::shared_mutex lock_;
+    Node root_;
+    std::unordered_map<Position, Subscription> subscriptions_;
+    Position next_position_;
+
+    mutable std::shared_mutex cache_lock_;
+    mutable std::unordered_map<std::string, Resolved> cache_;
+    mutable CacheNode cache_root_;
+    mutable size_t evict_bucket_;
+    std::atomic<uint64_t> generation_;
+    size_t cache_limit_;
+
+    static Levels split_(std::string_view topic) {
+        Levels result;
+        size_t begin = 0;
+        while (true) {
+            size_t end = topic.find('.', begin);
+            result.push_back(topic.substr(begin, end - begin));
+            if (end == std::string_view::npos) break;
+            begin = end + 1;
+        }
+        return result;
+    }
+
+    static void validate_(const Levels& levels) {
+        for (size_t i = 0; i + 1 < levels.size(); ++i)
+            if (levels[i] == "#")
+                throw std::invalid_argument(
+                    "ec::TopicRouter: '#' must be the last level");
+    }
+
+    static void collect_(const Node* node, const Levels& levels, size_t i,
+                         Subscribers* result) {
+        if (node->any_many)
+            for (auto& el : node->any_many->subscribers)
+                result->push_back(el.second);
+
+        if (i == levels.size()) {
+            for (auto& el : node->subscribers) result->push_back(el.second);
+            return;
+        }
+
+        auto child = node->children.find(std::string(levels[i]));
+        if (child != node->children.end())
+            collect_(child->second.get(), levels, i + 1, result);
+        if (node->any_one) collect_(node->any_one.get(), levels, i + 1, result);
+    }
+
+    Node* find_(Node* node, std::string_view level, bool create) {
+        std::unique_ptr<Node>* child;
+        if (level == "*")
+            child = &node->any_one;
+        else if (level == "#")
+            child = &node->any_many;
+        else if (create)
+            child = &node->children[std::string(level)];
+        else {
+            auto position = node->children.find(std::string(level));
+            if (position == node->children.end()) return nullptr;
+            child = &position->second;
+        }
+
+        if (!*child && create) *child = std::make_unique<Node>();
+        return child->get();
+    }
+
+    // Removes subscription from the branch and prunes empty nodes on the
+    // way back. Returns true when node became empty.
+    bool remove_(Node* node, const Levels& levels, size_t i,
+                 Position position) {
+        if (i == levels.size()) {
+            auto& list = node->subscribers;
+            list.erase(std::remove_if(list.begin(), list.end(),
+                                      [position](const auto& el) {
+                                          return el.first == position;
+                                      }),
+                       list.end());
+            return node->empty();
+        }
+
+        Node* child = find_(node, levels[i], false);
+        if (child != nullptr && remove_(child, levels, i + 1, position)) {
+            if (levels[i] == "*")
+                node->any_one.reset();
+            else if (levels[i] == "#")
+                node->any_many.reset();
+            else
+                node->children.erase(std::string(levels[i]));
+        }
+        return node->empty();
+    }
+
+    // Appends the level of a child of a node at depth to topic, the path
+    // of the node.
+    static void descend_(std::string* topic, size_t depth,
+                         const std::string& level) {
+        if (depth > 0) topic->push_back('.');
+        topic->append(level);
+    }
+
+    // Drops every cached topic of the branch, topic is the path to node.
+    void drop_(CacheNode* node, std::string* topic, size_t depth) const {
+        if (node->cached) cache_.erase(*topic);
+
+        size_t size = topic->size();
+        for (auto& el : node->children) {
+            descend_(topic, depth, el.first);
+            drop_(el.second.get(), topic, depth + 1);
+            topic->resize(size);
+        }
+    }
+
+    // Drops the cached topics of the branch that pattern matches from
+    // level i on, topic is the path to node. Returns true when node
+    // became empty. Called with cache_lock_ held.
+    bool invalidate_(CacheNode* node, const Levels& pattern, size_t i,
+                     std::string* topic) const {
+        if (i < pattern.size() && pattern[i] == "#") {
+            drop_(node, topic, i);
+            node->children.clear();
+            node->cached = false;
+            return true;
+        }
+
+        if (i == pattern.size()) {
+            if (node->cached) cache_.erase(*topic);
+            node->cached = false;
+            return node->children.empty();
+        }
+
+        size_t size = topic->size();
+        auto visit  = [&](auto position) {
+            descend_(topic, i, position->first);
+            bool empty =
+                invalidate_(position->second.get(), pattern, i + 1, topic);
+            topic->resize(size);
+            return empty;
+        };
+
+        auto& children = node->children;
+        if (pattern[i] == "*") {
+            for (auto el = children.begin(); el != children.end();)
+                el = visit(el) ? children.erase(el) : std::next(el);
+        } else {
+            auto position = children.find(std::string(pattern[i]));
+            if (position != children.end() && visit(position))
+                children.erase(position);
+        }
+        return !node->cached && children.empty();
+    }
+
+    void invalidate_(const Levels& pattern) {
+        ++generation_;
+
+        std::string topic;
+        std::unique_lock lock(cache_lock_);
+        invalidate_(&cache_root_, pattern, 0, &topic);
+    }
+
+    // Drops one cached topic, walking the buckets round robin. Called with
+    // cache_lock_ held on a cache that is not empty.
+    void evict_() const {
+        size_t buckets = cache_.bucket_count();
+        while (cache_.begin(evict_bucket_ % buckets) ==
+               cache_.end(evict_bucket_ % buckets))
+            ++evict_bucket_;
+
+        // A concrete topic as pattern matches itself only
+        std::string evicted = cache_.begin(evict_bucket_++ % buckets)->first;
+        std::string topic;
+        invalidate_(&cache_root_, split_(evicted), 0, &topic);
+    }
+
+    void insert_(const std::string& topic, const Levels& levels,
+                const Resolved& resolved) const {
+        if (cache_.size() >= cache_limit_) evict_();
+        if (!cache_.emplace(topic, resolved).second) return;
+
+        CacheNode* node = &cache_root_;
+        for (auto level : levels) {
+            auto& child = node->children[std::string(level)];
+            if (!child) child = std::make_unique<CacheNode>();
+            node = child.get();
+        }
+        node->cached = true;
+    }
+
+ public:
+    /// Caches up to cache_limit topics, 0 disables the cache.
+    TopicRouter(size_t cache_limit = 1 << 16)
+        : next_position_(0),
+          evict_bucket_(0),
+          generation_(0),
+          cache_limit_(cache_limit) {}
+
+    TopicRouter(const Self&) = delete;
+    Self& operator=(const Self&) = delete;
+
+    Position subscribe(const std::string& pattern, ObjContainer* handler) {
+        Levels levels = split_(pattern);
+        validate_(levels);
+
+        Position position;
+        {
+            std::unique_lock lock(lock_);
+            position = next_position_++;
+
+            Node* node = &root_;
+            for (auto level : levels) node = find_(node, level, true);
+            node->subscribers.emplace_back(position, handler);
+
+            auto& subscription = subscriptions_[position];
+            subscription.pattern = pattern;
+            subscription.handler = handler;
+        }
+
+        invalidate_(levels);
+        return position;
+    }
+
+    ObjContainer* unsubscribe(Position position) {
+        ObjContainer* handler;
+        std::string pattern;
+        {
+            std::unique_lock lock(lock_);
+            auto subscription = subscriptions_.find(position);
+            if (subscription == subscriptions_.end())
+                throw std::out_of_range("ec::TopicRouter::unsubscribe");
+
+            handler = subscription->second.handler;
+            pattern = std::move(subscription->second.pattern);
+            subscriptions_.erase(subscription);
+
+            remove_(&root_, split_(pattern), 0, position);
+        }
+
+        invalidate_(split_(pattern));
+        return handler;
+    }
+
+    /// Distinct handler lists subscribed to topic.
+    Resolved match(const std::string& topic) const {
+        {
+            std::shared_lock lock(cache_lock_);
+            auto position = cache_.find(topic);
+            if (position != cache_.end()) return position->second;
+        }
+
+        uint64_t generation = generation_.load();
+        Levels levels       = split_(topic);
+        auto result         = std::make_shared<Subscribers>();
+        {
+            std::shared_lock lock(lock_);
+            collect_(&root_, levels, 0, result.get());
+        }
+        std::sort(result->begin(), result->end());
+        result->erase(std::unique(result->begin(), result->end()),
+                      result->end());
+
+        if (cache_limit_ == 0) return result;
+
+        std::unique_lock lock(cache_lock_);
+        if (generation == generation_.load()) insert_(topic, levels, result);
+        return result;
+    }
+
+    void call(const std::string& topic, const Data& data) const {
+        Resolved subscribers = match(topic);
+        for (auto el : *subscribers) el->call(data);
+    }
+
+    size_t size() const {
+        std::shared_lock lock(lock_);
+        return subscriptions_.size();
+    }
+};
+
+}  // namespace ec
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef _TMBEL_TRACING_HPP_
+#define _TMBEL_TRACING_HPP_
+
+#include <TMBEL/metrics.hpp>
+#include <TMBEL/singleton.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+/// \brief Points of the event flow recorded by ec::Tracer.
+////////////////////////////////////////////////////////////
+enum class TraceKind : uint8_t {
+    Enqueue,       ///< Event pushed to an EventQueue.
+    Dequeue,       ///< Event taken out of an EventQueue.
+    HandlerBegin,  ///< HandlerList entered a handler.
+    HandlerEnd,    ///< Handler returned.
+    AsyncBegin,    ///< Event handed off to another thread.
+    AsyncEnd       ///< The other thread picked the event up.
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Records the flow of events through queues and
+/// handlers and dumps it as Chrome trace JSON, which can be
+/// opened in Perfetto or chrome://tracing.
+///
+/// Every thread writes into its own ring buffer without
+/// locks, the oldest records are overwritten when it is full.
+/// Events get a correlation id when pushed to an EventQueue
+/// and the thread that takes one out carries its id to the
+/// handlers it calls. While tracing is off, instrumented
+/// paths only load one relaxed flag.
+////////////////////////////////////////////////////////////
+class Tracer : public Singleton<Tracer> {
+ public:
+    static constexpr size_t default_capacity = 1 << 14;
+
+ protected:
+    using Self = Tracer;
+
+    friend Singleton<Tracer>;
+
+    struct Slot {
+        std::atomic<uint64_t> ticks{0};
+        std::atomic<uint64_t> event{0};
+        std::atomic<uint64_t> object{0};
+        std::atomic<uint64_t> info{0};  // thread << 8 | kind
+    };
+
+    // Written by one thread at a time. begin is advanced before a slot is
+    // written and end after it, so a reader can tell overwritten slots.
+    struct Ring {
+        std::unique_ptr<Slot[]> slots;
+        size_t mask;
+        std::atomic<uint64_t> begin{0};
+        std::atomic<uint64_t> end{0};
+
+        Ring(size_t capacity);
+    };
+
+    static inline std::atomic<bool> enabled_{false};
+    static inline std::atomic<uint64_t> next_event_{0};
+    static inline thread_local uint64_t current_ = 0;
+
+    std::mutex lock_;
+    std::vector<std::unique_ptr<Ring>> rings_;
+    std::vector<Ring*> free_rings_;
+    size_t capacity_ = default_capacity;
+    std::atomic<uint64_t> since_{0};
+    std::unordered_map<const void*, std::string> names_;
+
+    Tracer();
+
+ public:
+    virtual ~Tracer() override;
+
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    /// New correlation id, never zero.
+    static uint64_t newEvent() {
+        return next_event_.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    /// Id of the event the calling thread is handling.
+    static uint64_t current() { return current_; }
+    static void setCurrent(uint64_t event) { current_ = event; }
+
+    static void record(TraceKind kind, uint64_t event, const void* object);
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Turns tracing on. capacity is the number of
+    /// records kept per thread, it applies to the buffers of
+    /// threads that did not record yet.
+    ////////////////////////////////////////////////////////////
+    void start(size_t capacity = default_capacity);
+    void stop();
+
+    /// Drops everything recorded so far.
+    void clear();
+
+    /// Name shown for a handler or queue in the dump.
+    void setName(const void* object, const std::string& name);
+    void removeName(const void* object);
+
+    /// Name set for object, empty when there is none.
+    std::string getName(const void* object);
+
+    void writeChromeTrace(std::ostream& stream);
+    bool writeChromeTrace(const std::string& path);
+
+ protected:
+    Ring* acquireRing_();
+    void releaseRing_(Ring* ring);
+
+    friend struct TraceThread;
+};
+
+}  // namespace ec
+
+#endif
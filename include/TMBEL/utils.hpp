@@ -39,7 +39,7 @@ class UniqueContainer : protected MtListBase<HandlerBase*> {
 
 template <typename Data>
 typename HandlerList<Data>::Position asyncHandler(
-    HandlerList<Data>* container, std::function<void(const Data&)>&& function) {
+    HandlerList<Data>* container, InplaceFunction<void(const Data&)>&& function) {
     Handler<Data>* handler = new AsyncFuncHandler<Data>(std::move(function));
     return container->attach(handler);
 }
@@ -47,14 +47,14 @@ typename HandlerList<Data>::Position asyncHandler(
 template <typename Data>
 typename HandlerList<Data>::Position asyncHandler(
     HandlerList<Data>* container, std::list<HandlerBase*>::iterator position,
-    std::function<void(const Data&)>&& function) {
+    InplaceFunction<void(const Data&)>&& function) {
     Handler<Data>* handler = new AsyncFuncHandler<Data>(std::move(function));
     return container->attach(handler);
 }
 
 template <typename Data>
 typename HandlerList<Data>::Position syncHandler(
-    HandlerList<Data>* container, std::function<void(const Data&)>&& function) {
+    HandlerList<Data>* container, InplaceFunction<void(const Data&)>&& function) {
     Handler<Data>* handler = new SyncFuncHandler<Data>(std::move(function));
     return container->attach(handler);
 }
@@ -62,7 +62,7 @@ typename HandlerList<Data>::Position syncHandler(
 template <typename Data>
 typename HandlerList<Data>::Position syncHandler(
     HandlerList<Data>* container, std::list<HandlerBase*>::iterator position,
-    std::function<void(const Data&)>&& function) {
+    InplaceFunction<void(const Data&)>&& function) {
     Handler<Data>* handler = new SyncFuncHandler<Data>(std::move(function));
     return container->attach(handler);
 }
@@ -0,0 +1,247 @@
+#ifndef _TMBEL_WINDOW_HPP_
+#define _TMBEL_WINDOW_HPP_
+
+#include <TMBEL/adaptive_mutex.hpp>
+#include <TMBEL/controller.hpp>
+#include <TMBEL/handler.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+/// \brief Processor that folds events into windows and
+/// sends one aggregate per window and key.
+///
+/// Windows are size events long (count windows) or size
+/// time long (time windows) and start every slide. With
+/// slide equal to size they are tumbling, otherwise sliding
+/// windows made of size / slide panes: events are folded
+/// into the current pane with reduce and the panes of a
+/// window are folded together with combine when it closes.
+///
+/// A count window closes on the event that completes a pane
+/// of its key. Time windows close on tick(), attachTimer()
+/// makes a controller call it every slide on its own
+/// threads. Windows without events send nothing.
+///
+/// Keys are dense indexes below key_count. The panes, fill
+/// counts and locks of all keys live in flat arrays and
+/// every key has its own lock, so events of different keys
+/// do not contend.
+////////////////////////////////////////////////////////////
+template <typename Data, typename Result>
+class WindowProcessor : public Processor<Data, Result> {
+ public:
+    using Reduce = InplaceFunction<void(Result& aggregate, const Data& data)>;
+    using Combine =
+        InplaceFunction<void(Result& aggregate, const Result& pane)>;
+    using KeyFunc  = InplaceFunction<size_t(const Data&)>;
+    using Duration = std::chrono::steady_clock::duration;
+
+ protected:
+    using Self = WindowProcessor<Data, Result>;
+    using Base = Processor<Data, Result>;
+
+    Reduce reduce_;
+    Combine combine_;
+    KeyFunc key_;
+    Result initial_;
+
+    bool timed_;
+    size_t count_slide_ = 0;  // events per pane of count windows
+    Duration time_slide_{0};
+    size_t pane_count_;
+    size_t key_count_ = 0;
+
+    // Key major, the pane_count_ panes of a key are adjacent.
+    std::vector<Result> panes_;
+    std::vector<uint32_t> filled_;   // events folded into every pane
+    std::vector<uint32_t> current_;  // pane every key folds into
+    std::unique_ptr<AdaptiveMutex[]> locks_;
+
+    InplaceFunction<void()> remove_timer_;
+
+    static size_t paneCount_(uint64_t size, uint64_t slide) {
+        if (size == 0 || slide == 0 || size % slide != 0)
+            throw std::invalid_argument(
+                "ec::WindowProcessor size must be a multiple of slide");
+        return size / slide;
+    }
+
+    // Sliding windows cannot fold their panes without combine.
+    void checkCombine_() const {
+        if (pane_count_ > 1 && !combine_)
+            throw std::invalid_argument(
+                "ec::WindowProcessor sliding window without combine");
+    }
+
+    // Folds the panes of the window of key into result, oldest
+    // first. Key lock must be held. Returns false if the window
+    // saw no event.
+    bool fold_(size_t key, Result* result) {
+        size_t first  = key * pane_count_;
+        size_t oldest = (current_[key] + 1) % pane_count_;
+
+        bool found = false;
+        *result    = initial_;
+        for (size_t i = 0; i < pane_count_; ++i) {
+            size_t pane = first + (oldest + i) % pane_count_;
+            if (filled_[pane] == 0) continue;
+
+            if (pane_count_ == 1)
+                *result = panes_[pane];
+            else
+                combine_(*result, panes_[pane]);
+            found = true;
+        }
+        return found;
+    }
+
+    // Folds the window of key and moves on to the next pane, which
+    // drops the oldest one.
+    bool close_(size_t key, Result* result) {
+        bool found = fold_(key, result);
+
+        size_t next   = (current_[key] + 1) % pane_count_;
+        size_t pane   = key * pane_count_ + next;
+        current_[key] = next;
+        panes_[pane]  = initial_;
+        filled_[pane] = 0;
+        return found;
+    }
+
+ public:
+    /// Count windows of size events starting every slide events.
+    WindowProcessor(size_t size, size_t slide, Reduce&& reduce,
+                    const Result& initial = Result())
+        : reduce_(std::move(reduce)),
+          initial_(initial),
+          timed_(false),
+          count_slide_(slide),
+          pane_count_(paneCount_(size, slide)) {
+        setKeyCount(1);
+    }
+
+    /// Time windows of size starting every slide.
+    WindowProcessor(Duration size, Duration slide, Reduce&& reduce,
+                    const Result& initial = Result())
+        : reduce_(std::move(reduce)),
+          initial_(initial),
+          timed_(true),
+          time_slide_(slide),
+          pane_count_(paneCount_(size.count(), slide.count())) {
+        setKeyCount(1);
+    }
+
+    virtual ~WindowProcessor() override { detachTimer(); }
+
+    /// Folds the panes of sliding windows, required when slide
+    /// is smaller than size. Without it call(), tick(), flush()
+    /// and attachTimer() of sliding windows throw
+    /// std::invalid_argument.
+    void setCombine(Combine&& combine) { combine_ = std::move(combine); }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Aggregates every key separately, key returns the
+    /// index of the key of an event (taken modulo key_count).
+    /// Must be called before events arrive.
+    ////////////////////////////////////////////////////////////
+    void setKey(KeyFunc&& key, size_t key_count) {
+        key_ = std::move(key);
+        setKeyCount(key_count);
+    }
+
+    void setKeyCount(size_t key_count) {
+        key_count_ = std::max<size_t>(key_count, 1);
+        panes_.assign(key_count_ * pane_count_, initial_);
+        filled_.assign(key_count_ * pane_count_, 0);
+        current_.assign(key_count_, 0);
+        locks_ = std::make_unique<AdaptiveMutex[]>(key_count_);
+    }
+
+    size_t getKeyCount() const { return key_count_; }
+
+    void call(const Data& data) override {
+        checkCombine_();
+        size_t key = key_ ? key_(data) % key_count_ : 0;
+
+        Result result;
+        bool closed = false;
+        {
+            std::lock_guard lock(locks_[key]);
+            size_t pane = key * pane_count_ + current_[key];
+            reduce_(panes_[pane], data);
+            if (++filled_[pane] == count_slide_ && !timed_)
+                closed = close_(key, &result);
+        }
+        if (closed) Base::emit_(result);
+    }
+
+    /// Closes the current time window of every key.
+    void tick() {
+        checkCombine_();
+        Result result;
+        for (size_t key = 0; key < key_count_; ++key) {
+            bool closed;
+            {
+                std::lock_guard lock(locks_[key]);
+                closed = close_(key, &result);
+            }
+            if (closed) Base::emit_(result);
+        }
+    }
+
+    /// Sends the windows that are not complete yet, e.g. at the
+    /// end of a stream, and starts over.
+    void flush() {
+        checkCombine_();
+        Result result;
+        for (size_t key = 0; key < key_count_; ++key) {
+            bool found;
+            {
+                std::lock_guard lock(locks_[key]);
+                found = fold_(key, &result);
+
+                size_t first = key * pane_count_;
+                std::fill_n(panes_.begin() + first, pane_count_, initial_);
+                std::fill_n(filled_.begin() + first, pane_count_, 0);
+                current_[key] = 0;
+            }
+            if (found) Base::emit_(result);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Lets controller close the time windows every
+    /// slide, see ControllerBase::addTimer(). The timer is
+    /// removed by detachTimer() or the destructor, so the
+    /// controller must outlive the processor or the timer.
+    ////////////////////////////////////////////////////////////
+    template <typename Event>
+    void attachTimer(ControllerBase<Event>* controller) {
+        if (!timed_)
+            throw std::logic_error(
+                "ec::WindowProcessor count windows have no timer");
+        checkCombine_();
+
+        detachTimer();
+        size_t id = controller->addTimer(time_slide_, [this]() { tick(); });
+        remove_timer_ = [controller, id]() { controller->removeTimer(id); };
+    }
+
+    void detachTimer() {
+        if (!remove_timer_) return;
+        remove_timer_();
+        remove_timer_ = nullptr;
+    }
+};
+
+}  // namespace ec
+
+#endif
@@ -0,0 +1,76 @@
+#include <TMBEL/adaptive_mutex.hpp>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ec {
+
+namespace {
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////
+// AdaptiveMutex implementation
+////////////////////////////////////////////////////////////
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "Futex word must be 32 bit wide.");
+
+AdaptiveMutex::AdaptiveMutex(uint32_t spin_count)
+    : state_(0), spin_count_(spin_count) {}
+
+AdaptiveMutex::~AdaptiveMutex() = default;
+
+void AdaptiveMutex::park_() {
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state_),
+            FUTEX_WAIT_PRIVATE, 2, nullptr, nullptr, 0);
+#else
+    std::this_thread::yield();
+#endif
+}
+
+void AdaptiveMutex::wake_() {
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state_),
+            FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+}
+
+bool AdaptiveMutex::try_lock() {
+    uint32_t expected = 0;
+    return state_.compare_exchange_strong(expected, 1,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed);
+}
+
+void AdaptiveMutex::lock() {
+    if (try_lock()) return;
+
+    for (uint32_t i = 0; i < spin_count_; ++i) {
+        if (state_.load(std::memory_order_relaxed) == 0 && try_lock()) return;
+        cpuRelax();
+    }
+
+    // Mark the lock as contended so that the owner knows it has to wake
+    // somebody on unlock.
+    while (state_.exchange(2, std::memory_order_acquire) != 0) park_();
+}
+
+void AdaptiveMutex::unlock() {
+    if (state_.exchange(0, std::memory_order_release) == 2) wake_();
+}
+
+}  // namespace ec
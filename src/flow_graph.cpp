@@ -0,0 +1,227 @@
+#include <TMBEL/flow_graph.hpp>
+#include <algorithm>
+
+namespace ec {
+
+namespace {
+
+const char* kindName(FlowGraph::Kind kind) {
+    switch (kind) {
+        case FlowGraph::Kind::Source: return "source";
+        case FlowGraph::Kind::Filter: return "filter";
+        case FlowGraph::Kind::Map: return "map";
+        case FlowGraph::Kind::Process: return "process";
+        case FlowGraph::Kind::Parse: return "parse";
+        case FlowGraph::Kind::Group: return "group";
+        case FlowGraph::Kind::Merge: return "merge";
+        case FlowGraph::Kind::Sink: return "sink";
+    }
+    return "";
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////
+// FlowGraph::Worker implementation
+////////////////////////////////////////////////////////////
+
+FlowGraph::Worker::Worker(size_t capacity)
+    : capacity_(capacity), thread_([this]() { run_(); }) {}
+
+FlowGraph::Worker::~Worker() {
+    {
+        std::lock_guard lock(lock_);
+        closed_ = true;
+    }
+    ready_.notify_one();
+    thread_.join();
+}
+
+void FlowGraph::Worker::run_() {
+    std::unique_lock lock(lock_);
+    while (true) {
+        ready_.wait(lock, [this]() { return !tasks_.empty() || closed_; });
+        if (tasks_.empty()) return;
+
+        Task task = std::move(tasks_.front());
+        tasks_.pop_front();
+        busy_ = true;
+        lock.unlock();
+        done_.notify_all();
+
+        task();
+
+        lock.lock();
+        busy_ = false;
+        if (tasks_.empty()) done_.notify_all();
+    }
+}
+
+void FlowGraph::Worker::post(Task&& task) {
+    {
+        std::unique_lock lock(lock_);
+        done_.wait(lock, [this]() { return tasks_.size() < capacity_; });
+        tasks_.push_back(std::move(task));
+    }
+    ready_.notify_one();
+}
+
+void FlowGraph::Worker::drain() {
+    std::unique_lock lock(lock_);
+    done_.wait(lock, [this]() { return tasks_.empty() && !busy_; });
+}
+
+////////////////////////////////////////////////////////////
+// FlowGraph implementation
+////////////////////////////////////////////////////////////
+
+FlowGraph::~FlowGraph() { wait(); }
+
+void FlowGraph::link_(size_t from, Step* to, EdgeMode mode) {
+    if (built_) throw std::logic_error("ec::FlowGraph is already built");
+    if (to->kind == Kind::Source)
+        throw std::invalid_argument("ec::FlowGraph source " + to->name +
+                                    " cannot have inputs");
+
+    to->inputs.push_back(from);
+    to->input_modes.push_back(mode);
+}
+
+void FlowGraph::validate_() {
+    std::vector<std::vector<size_t>> outputs(steps_.size());
+    for (size_t i = 0; i < steps_.size(); ++i) {
+        const Step& step = *steps_[i];
+        if (step.kind != Kind::Source && step.inputs.empty())
+            throw std::logic_error("ec::FlowGraph node " + step.name +
+                                   " has no input");
+        for (auto el : step.inputs) outputs[el].push_back(i);
+    }
+
+    for (size_t i = 0; i < steps_.size(); ++i)
+        if (steps_[i]->kind == Kind::Sink && !outputs[i].empty())
+            throw std::logic_error("ec::FlowGraph sink " + steps_[i]->name +
+                                   " has outputs");
+
+    // Depth first search without recursion, a node found again while
+    // it is on the path closes a cycle. Nodes are appended to order_
+    // when they are left, which is a reverse topological order.
+    enum State : uint8_t { New, OnPath, Done };
+    std::vector<State> state(steps_.size(), New);
+    std::vector<std::pair<size_t, size_t>> path;  // node, next output
+
+    order_.clear();
+    for (size_t root = 0; root < steps_.size(); ++root) {
+        if (state[root] != New) continue;
+
+        path.emplace_back(root, 0);
+        state[root] = OnPath;
+        while (!path.empty()) {
+            auto& [node, next] = path.back();
+            if (next == outputs[node].size()) {
+                state[node] = Done;
+                order_.push_back(node);
+                path.pop_back();
+                continue;
+            }
+
+            size_t target = outputs[node][next++];
+            if (state[target] == OnPath) {
+                std::string cycle;
+                size_t i = 0;
+                while (path[i].first != target) ++i;
+                for (; i < path.size(); ++i)
+                    cycle += steps_[path[i].first]->name + " -> ";
+                throw std::logic_error("ec::FlowGraph cycle " + cycle +
+                                       steps_[target]->name);
+            }
+            if (state[target] == New) {
+                state[target] = OnPath;
+                path.emplace_back(target, 0);
+            }
+        }
+    }
+    std::reverse(order_.begin(), order_.end());
+}
+
+void FlowGraph::compile_() {
+    for (auto& el : steps_) {
+        for (size_t i = 0; i < el->inputs.size(); ++i) {
+            EdgeMode mode = el->input_modes[i];
+            if (mode == EdgeMode::Auto)
+                mode = el->blocking ? EdgeMode::Async : EdgeMode::Sync;
+
+            el->input_modes[i] = mode;
+            steps_[el->inputs[i]]->outputs.push_back({el.get(), mode});
+            if (mode == EdgeMode::Async && !el->worker)
+                el->worker = std::make_unique<Worker>(queue_capacity_);
+        }
+    }
+
+    // Chain the sync edges that are the only way out of a node and
+    // the only way into the next one.
+    for (auto& el : steps_) {
+        if (el->outputs.size() != 1) continue;
+
+        const Edge& edge = el->outputs.front();
+        if (edge.mode == EdgeMode::Sync && edge.step->inputs.size() == 1)
+            el->next = edge.step;
+    }
+}
+
+void FlowGraph::build() {
+    if (built_) throw std::logic_error("ec::FlowGraph is already built");
+
+    validate_();
+    compile_();
+    built_ = true;
+}
+
+void FlowGraph::wait() {
+    // In topological order: a node only gets events from the nodes
+    // before it, which are drained by then.
+    for (auto el : order_)
+        if (steps_[el]->worker) steps_[el]->worker->drain();
+}
+
+std::string FlowGraph::dump() const {
+    if (!built_) throw std::logic_error("ec::FlowGraph is not built");
+
+    std::vector<bool> chained(steps_.size(), false);
+    size_t edges = 0;
+    for (auto& el : steps_) {
+        edges += el->outputs.size();
+        if (el->next == nullptr) continue;
+
+        for (size_t i = 0; i < steps_.size(); ++i)
+            if (steps_[i].get() == el->next) chained[i] = true;
+    }
+
+    std::string chains;
+    size_t chain_count = 0;
+    for (auto index : order_) {
+        if (chained[index]) continue;
+
+        // A chain starts on every node that is not called directly by
+        // its input and follows the directly called successors.
+        const Step* step = steps_[index].get();
+        chains += "  ";
+        while (true) {
+            chains += step->name + " (" + kindName(step->kind) + ")";
+            if (step->next == nullptr) break;
+            chains += " -> ";
+            step = step->next;
+        }
+        chains += "\n";
+        ++chain_count;
+
+        for (auto& el : step->outputs)
+            chains += "    => " + el.step->name +
+                      (el.mode == EdgeMode::Async ? " async\n" : " sync\n");
+    }
+
+    return "FlowGraph " + std::to_string(steps_.size()) + " nodes, " +
+           std::to_string(edges) + " edges, " + std::to_string(chain_count) +
+           " chains\n" + chains;
+}
+
+}  // namespace ec
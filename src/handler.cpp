@@ -1,4 +1,6 @@
 #include <TMBEL/handler.hpp>
+#include <algorithm>
+#include <thread>
 
 namespace ec {
 
@@ -6,8 +8,69 @@ namespace ec {
 // HandlerBase implementation
 ////////////////////////////////////////////////////////////
 
- HandlerBase::~HandlerBase() = default;
+HandlerBase::~HandlerBase() {
+    if (named_) Tracer::getInstance()->removeName(this);
+}
 
 void HandlerBase::onRemove() {}
 
+void HandlerBase::setMetrics(const std::string& name) {
+    metrics_ = MetricsRegistry::getInstance()->getHandlerMetrics(name);
+}
+
+void HandlerBase::clearMetrics() { metrics_ = nullptr; }
+
+void HandlerBase::setName(const std::string& name) {
+    Tracer::getInstance()->setName(this, name);
+    named_ = true;
+}
+
+std::string HandlerBase::getName() const {
+    if (!named_) return std::string();
+    return Tracer::getInstance()->getName(this);
+}
+
+////////////////////////////////////////////////////////////
+// DispatchGate implementation
+////////////////////////////////////////////////////////////
+
+DispatchGate::DispatchGate() : current_(std::make_shared<Readers>()) {}
+
+size_t DispatchGate::held_(const Readers* readers) {
+    size_t result = 0;
+    for (auto el = guards_; el != nullptr; el = el->outer_)
+        if (el->readers_ == readers) ++result;
+    return result;
+}
+
+void DispatchGate::synchronize() {
+    std::vector<std::shared_ptr<Readers>> waiting;
+    {
+        std::lock_guard lock(lock_);
+        retired_.erase(
+            std::remove_if(retired_.begin(), retired_.end(),
+                           [](const std::shared_ptr<Readers>& el) {
+                               return el->count.load(
+                                          std::memory_order_acquire) == 0;
+                           }),
+            retired_.end());
+
+        if (retired_.empty() &&
+            current_->count.load(std::memory_order_acquire) ==
+                held_(current_.get()))
+            return;
+
+        // Guards taken from now on see the erased element gone, only
+        // the current generation and older ones have to drain.
+        retired_.push_back(std::exchange(current_, std::make_shared<Readers>()));
+        waiting = retired_;
+    }
+
+    for (auto& el : waiting) {
+        size_t held = held_(el.get());
+        while (el->count.load(std::memory_order_acquire) > held)
+            std::this_thread::yield();
+    }
+}
+
 }  // namespace ec
\ No newline at end of file
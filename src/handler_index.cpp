@@ -0,0 +1,99 @@
+#include <TMBEL/handler_index.hpp>
+#include <algorithm>
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+// SubscriptionFilter implementation
+////////////////////////////////////////////////////////////
+
+SubscriptionFilter& SubscriptionFilter::equal(size_t field, int64_t value) {
+    predicates_.push_back({uint32_t(field), value, value});
+    return *this;
+}
+
+SubscriptionFilter& SubscriptionFilter::range(size_t field, int64_t low,
+                                              int64_t high) {
+    if (low > high)
+        throw std::invalid_argument("ec::SubscriptionFilter empty range");
+
+    predicates_.push_back({uint32_t(field), low, high});
+    return *this;
+}
+
+const SubscriptionFilter::Predicate* SubscriptionFilter::anchor() const {
+    for (auto& el : predicates_)
+        if (el.isEqual()) return &el;
+    return predicates_.empty() ? nullptr : &predicates_.front();
+}
+
+bool SubscriptionFilter::matches(const int64_t* values) const {
+    for (auto& el : predicates_)
+        if (values[el.field] < el.low || values[el.field] > el.high)
+            return false;
+    return true;
+}
+
+////////////////////////////////////////////////////////////
+// IntervalIndex implementation
+////////////////////////////////////////////////////////////
+
+IntervalIndex::IntervalIndex(std::vector<Interval> intervals) {
+    nodes_.reserve(intervals.size());
+    by_low_.reserve(intervals.size());
+    by_high_.reserve(intervals.size());
+    build_(intervals);
+}
+
+int32_t IntervalIndex::build_(std::vector<Interval>& intervals) {
+    if (intervals.empty()) return -1;
+
+    // The median endpoint belongs to an interval, so every node keeps
+    // at least one and both sides hold at most half of the endpoints.
+    std::vector<int64_t> points;
+    points.reserve(intervals.size() * 2);
+    for (auto& el : intervals) {
+        points.push_back(el.low);
+        points.push_back(el.high);
+    }
+    auto middle = points.begin() + points.size() / 2;
+    std::nth_element(points.begin(), middle, points.end());
+    int64_t center = *middle;
+
+    std::vector<Interval> left, right, here;
+    for (auto& el : intervals) {
+        if (el.high < center)
+            left.push_back(el);
+        else if (el.low > center)
+            right.push_back(el);
+        else
+            here.push_back(el);
+    }
+
+    Node node;
+    node.center = center;
+    node.begin  = uint32_t(by_low_.size());
+    node.end    = uint32_t(by_low_.size() + here.size());
+
+    std::sort(here.begin(), here.end(),
+              [](const Interval& lhs, const Interval& rhs) {
+                  return lhs.low < rhs.low;
+              });
+    by_low_.insert(by_low_.end(), here.begin(), here.end());
+    std::sort(here.begin(), here.end(),
+              [](const Interval& lhs, const Interval& rhs) {
+                  return lhs.high > rhs.high;
+              });
+    by_high_.insert(by_high_.end(), here.begin(), here.end());
+
+    auto index = int32_t(nodes_.size());
+    nodes_.push_back(node);
+
+    int32_t left_index  = build_(left);
+    int32_t right_index = build_(right);
+    nodes_[index].left  = left_index;
+    nodes_[index].right = right_index;
+    return index;
+}
+
+}  // namespace ec
@@ -0,0 +1,73 @@
+#include <TMBEL/histogram.hpp>
+#include <algorithm>
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+// Histogram implementation
+////////////////////////////////////////////////////////////
+
+size_t Histogram::bucketOf(uint64_t value) {
+    if (value < sub_bucket_count) return value;
+
+    size_t exponent = 63 - __builtin_clzll(value);
+    size_t mantissa =
+        (value >> (exponent - sub_bucket_bits)) & (sub_bucket_count - 1);
+    return sub_bucket_count + (exponent - sub_bucket_bits) * sub_bucket_count +
+           mantissa;
+}
+
+uint64_t Histogram::bucketValue(size_t bucket) {
+    if (bucket < sub_bucket_count) return bucket;
+
+    size_t exponent = (bucket - sub_bucket_count) / sub_bucket_count +
+                      sub_bucket_bits;
+    uint64_t mantissa = (bucket - sub_bucket_count) % sub_bucket_count;
+    uint64_t step     = uint64_t(1) << (exponent - sub_bucket_bits);
+    return ((sub_bucket_count + mantissa) << (exponent - sub_bucket_bits)) +
+           (step - 1);
+}
+
+Histogram::Histogram() { clear(); }
+
+void Histogram::merge(const Histogram& other) {
+    for (size_t i = 0; i < bucket_count; ++i) buckets_[i] += other.buckets_[i];
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+}
+
+void Histogram::clear() {
+    buckets_.fill(0);
+    count_ = 0;
+    sum_   = 0;
+    max_   = 0;
+}
+
+uint64_t Histogram::count() const { return count_; }
+
+uint64_t Histogram::sum() const { return sum_; }
+
+uint64_t Histogram::max() const { return max_; }
+
+double Histogram::mean() const {
+    return count_ == 0 ? 0.0 : static_cast<double>(sum_) / count_;
+}
+
+uint64_t Histogram::percentile(double q) const {
+    if (count_ == 0) return 0;
+
+    uint64_t rank = static_cast<uint64_t>(q * count_);
+    if (rank >= count_) rank = count_ - 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucket_count; ++i) {
+        seen += buckets_[i];
+        if (seen > rank) return std::min(bucketValue(i), max_);
+    }
+    return max_;
+}
+
+uint64_t Histogram::bucket(size_t index) const { return buckets_[index]; }
+
+}  // namespace ec
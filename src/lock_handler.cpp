@@ -1,4 +1,5 @@
 #include <TMBEL/lock_handler.hpp>
+#include <TMBEL/tracing.hpp>
 
 namespace ec {
 
@@ -6,17 +7,138 @@ namespace ec {
 // MutexObjectBase implementation
 ////////////////////////////////////////////////////////////
 
-MutexObjectBase::MutexObjectBase() : ref_counter_(0) {}
+MutexObjectBase::MutexObjectBase(MutexType type)
+    : ref_counter_(0), type_(type) {}
 
 MutexObjectBase::~MutexObjectBase() {}
 
-std::recursive_mutex& MutexObjectBase::get() { return lock_; }
+MutexType MutexObjectBase::getType() const { return type_; }
+
+void MutexObjectBase::rawLock_() {
+    switch (type_) {
+        case MutexType::Adaptive: adaptive_lock_.lock(); break;
+        case MutexType::Shared: shared_lock_.lock(); break;
+        default: lock_.lock();
+    }
+}
+
+bool MutexObjectBase::rawTryLock_() {
+    switch (type_) {
+        case MutexType::Adaptive: return adaptive_lock_.try_lock();
+        case MutexType::Shared: return shared_lock_.try_lock();
+        default: return lock_.try_lock();
+    }
+}
+
+void MutexObjectBase::rawUnlock_() {
+    switch (type_) {
+        case MutexType::Adaptive: adaptive_lock_.unlock(); break;
+        case MutexType::Shared: shared_lock_.unlock(); break;
+        default: lock_.unlock();
+    }
+}
+
+void MutexObjectBase::rawLockShared_() {
+    if (type_ == MutexType::Shared)
+        shared_lock_.lock_shared();
+    else
+        rawLock_();
+}
+
+bool MutexObjectBase::rawTryLockShared_() {
+    if (type_ == MutexType::Shared) return shared_lock_.try_lock_shared();
+    return rawTryLock_();
+}
+
+void MutexObjectBase::rawUnlockShared_() {
+    if (type_ == MutexType::Shared)
+        shared_lock_.unlock_shared();
+    else
+        rawUnlock_();
+}
+
+#ifdef TMBEL_LOCK_PROFILING
+
+void MutexObjectBase::setName(const std::string& name) {
+    std::lock_guard lock(name_lock_);
+    name_ = name;
+}
+
+std::string MutexObjectBase::getName() const {
+    std::lock_guard lock(name_lock_);
+    return name_;
+}
+
+void MutexObjectBase::lock(const HandlerBase* owner) {
+    if (rawTryLock_()) return profile_.onAcquire(owner, false, 0);
+
+    uint64_t start = LockProfile::now();
+    rawLock_();
+    profile_.onAcquire(owner, true, LockProfile::now() - start);
+}
+
+void MutexObjectBase::unlock() {
+    profile_.onRelease();
+    rawUnlock_();
+}
+
+void MutexObjectBase::lock_shared(const HandlerBase* owner) {
+    if (rawTryLockShared_()) return profile_.onAcquire(owner, false, 0);
+
+    uint64_t start = LockProfile::now();
+    rawLockShared_();
+    profile_.onAcquire(owner, true, LockProfile::now() - start);
+}
+
+void MutexObjectBase::unlock_shared() {
+    profile_.onRelease();
+    rawUnlockShared_();
+}
+
+LockProfileSnapshot MutexObjectBase::getProfile(size_t top_count) const {
+    LockProfileSnapshot result;
+    result.group = this;
+    result.name  = getName();
+    profile_.snapshot(&result, top_count);
+
+    // Through the names the tracer keeps, an owner may be destroyed by
+    // now and drops its name with it.
+    auto tracer = Tracer::getInstance();
+    for (auto& el : result.top_waiters)
+        if (el.owner != nullptr) el.name = tracer->getName(el.owner);
+    return result;
+}
+
+void MutexObjectBase::resetProfile() { profile_.reset(); }
+
+#else
+
+void MutexObjectBase::setName(const std::string&) {}
+
+std::string MutexObjectBase::getName() const { return std::string(); }
+
+void MutexObjectBase::lock(const HandlerBase*) { rawLock_(); }
+
+void MutexObjectBase::unlock() { rawUnlock_(); }
+
+void MutexObjectBase::lock_shared(const HandlerBase*) { rawLockShared_(); }
+
+void MutexObjectBase::unlock_shared() { rawUnlockShared_(); }
+
+LockProfileSnapshot MutexObjectBase::getProfile(size_t) const {
+    LockProfileSnapshot result;
+    result.group = this;
+    return result;
+}
+
+void MutexObjectBase::resetProfile() {}
+
+#endif
 
 void MutexObjectBase::increase() { ++ref_counter_; }
 
 void MutexObjectBase::decrease() {
-    --ref_counter_;
-    if (ref_counter_ == 0) this->~MutexObjectBase();
+    if (--ref_counter_ == 0) delete this;
 }
 
 ////////////////////////////////////////////////////////////
@@ -24,31 +146,68 @@ void MutexObjectBase::decrease() {
 ////////////////////////////////////////////////////////////
 
 void Mutex::decrease_() {
-    if (reference_ != nullptr)
-        ;
-    reference_->decrease();
+    if (reference_ != nullptr) reference_->decrease();
 }
 
 void Mutex::increase_() {
     if (reference_ != nullptr) reference_->increase();
 }
 
-Mutex::Mutex() : reference_(nullptr) {}
+#ifdef TMBEL_LOCK_PROFILING
 
-Mutex::Mutex(MutexObjectBase* pointer) : reference_(pointer) { increase_(); }
+Mutex::Mutex()
+    : reference_(nullptr), access_(MutexAccess::Write), owner_(nullptr) {}
 
-Mutex::Mutex(const Mutex& other) : reference_(other.reference_) { increase_(); }
+Mutex::Mutex(MutexObjectBase* pointer, MutexAccess access)
+    : reference_(pointer), access_(access), owner_(nullptr) {
+    increase_();
+}
+
+Mutex::Mutex(const Mutex& other)
+    : reference_(other.reference_),
+      access_(other.access_),
+      owner_(other.owner_) {
+    increase_();
+}
+
+Mutex::Mutex(Mutex&& other)
+    : reference_(other.reference_),
+      access_(other.access_),
+      owner_(other.owner_) {
+    other.reference_ = nullptr;
+}
+
+#else
+
+Mutex::Mutex() : reference_(nullptr), access_(MutexAccess::Write) {}
+
+Mutex::Mutex(MutexObjectBase* pointer, MutexAccess access)
+    : reference_(pointer), access_(access) {
+    increase_();
+}
+
+Mutex::Mutex(const Mutex& other)
+    : reference_(other.reference_), access_(other.access_) {
+    increase_();
+}
 
-Mutex::Mutex(Mutex&& other) : reference_(other.reference_) {
+Mutex::Mutex(Mutex&& other)
+    : reference_(other.reference_), access_(other.access_) {
     other.reference_ = nullptr;
 }
 
+#endif
+
 Mutex::~Mutex() { decrease_(); }
 
 Mutex& Mutex::operator=(const Mutex& other) {
     if (this != &other) {
         decrease_();
         reference_ = other.reference_;
+        access_    = other.access_;
+#ifdef TMBEL_LOCK_PROFILING
+        owner_ = other.owner_;
+#endif
         increase_();
     }
     return *this;
@@ -58,39 +217,120 @@ Mutex& Mutex::operator=(Mutex&& other) {
     if (this != &other) {
         decrease_();
         reference_ = other.reference_;
+        access_    = other.access_;
+#ifdef TMBEL_LOCK_PROFILING
+        owner_ = other.owner_;
+#endif
         other.reference_ = nullptr;
     }
     return *this;
 }
 
+#ifdef TMBEL_LOCK_PROFILING
+
 void Mutex::lock() {
-    if (reference_ != nullptr) reference_->get().lock();
+    if (access_ == MutexAccess::Read)
+        lock_shared();
+    else if (reference_ != nullptr)
+        reference_->lock(owner_);
+}
+
+void Mutex::lock_shared() {
+    if (reference_ != nullptr) reference_->lock_shared(owner_);
+}
+
+void Mutex::setOwner(const HandlerBase* owner) { owner_ = owner; }
+
+#else
+
+void Mutex::lock() {
+    if (access_ == MutexAccess::Read)
+        lock_shared();
+    else if (reference_ != nullptr)
+        reference_->lock();
+}
+
+void Mutex::lock_shared() {
+    if (reference_ != nullptr) reference_->lock_shared();
 }
 
+void Mutex::setOwner(const HandlerBase*) {}
+
+#endif
+
 void Mutex::unlock() {
-    if (reference_ != nullptr) reference_->get().unlock();
+    if (access_ == MutexAccess::Read)
+        unlock_shared();
+    else if (reference_ != nullptr)
+        reference_->unlock();
+}
+
+void Mutex::unlock_shared() {
+    if (reference_ != nullptr) reference_->unlock_shared();
+}
+
+bool Mutex::isEmpty() const { return reference_ == nullptr; }
+
+MutexType Mutex::getType() const {
+    return reference_ != nullptr ? reference_->getType() : MutexType::Recursive;
+}
+
+MutexAccess Mutex::getAccess() const { return access_; }
+
+void Mutex::setName(const std::string& name) {
+    if (reference_ != nullptr) reference_->setName(name);
+}
+
+Mutex Mutex::withAccess(MutexAccess access) const {
+    Mutex result(*this);
+    result.access_ = access;
+    return result;
 }
 
+Mutex Mutex::reader() const { return withAccess(MutexAccess::Read); }
+
+Mutex Mutex::writer() const { return withAccess(MutexAccess::Write); }
+
 ////////////////////////////////////////////////////////////
 // MutexObject implementation
 ////////////////////////////////////////////////////////////
 
-MutexObject::MutexObject() = default;
+MutexObject::MutexObject(MutexType type) : Base(type) {}
 
 MutexObject::~MutexObject() = default;
 
 Mutex MutexObject::createRef() { return Mutex(this); }
 
+LockProfileSnapshot MutexObject::getProfile(size_t top_count) const {
+    return Base::getProfile(top_count);
+}
+
+void MutexObject::resetProfile() { Base::resetProfile(); }
+
 ////////////////////////////////////////////////////////////
 // MutexList implementation
 ////////////////////////////////////////////////////////////
 
 MutexList::MutexList() = default;
 
-Mutex MutexList::getMutex() {
-    auto new_mutex = new MutexObject();
-    sub_list_.push_back(new_mutex);
+Mutex MutexList::getMutex(MutexType type) {
+    auto new_mutex = new MutexObject(type);
+    attach(new_mutex);
     return new_mutex->createRef();
 }
 
+std::vector<LockProfileSnapshot> MutexList::getProfile(size_t top_count) {
+    std::vector<LockProfileSnapshot> result;
+    if (!lock_profiling_enabled) return result;
+
+    map([&result, top_count](MutexObject* el) {
+        result.push_back(el->getProfile(top_count));
+    });
+    return result;
+}
+
+void MutexList::resetProfile() {
+    map([](MutexObject* el) { el->resetProfile(); });
+}
+
 }  // namespace ec
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include <TMBEL/lock_profile.hpp>
+
+#ifdef TMBEL_LOCK_PROFILING
+
+#include <algorithm>
+#include <chrono>
+
+namespace ec {
+
+namespace {
+
+size_t bucketOf(uint64_t ns) {
+    size_t bucket = 0;
+    while (ns > 1 && bucket + 1 < lock_histogram_size) {
+        ns >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+// Acquisition times of the locks held by the current thread. Locks are
+// released in LIFO order almost always, so the search from the top is short.
+struct HoldEntry {
+    const LockProfile* profile;
+    uint64_t start;
+};
+
+constexpr size_t hold_stack_size = 32;
+
+thread_local HoldEntry hold_stack[hold_stack_size];
+thread_local size_t hold_depth = 0;
+
+}  // namespace
+
+////////////////////////////////////////////////////////////
+// LockProfile implementation
+////////////////////////////////////////////////////////////
+
+uint64_t LockProfile::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+LockProfile::LockProfile() { reset(); }
+
+void LockProfile::onAcquire(const HandlerBase* owner, bool contended,
+                            uint64_t wait_ns) {
+    acquisitions_.fetch_add(1, std::memory_order_relaxed);
+
+    if (contended) {
+        contended_.fetch_add(1, std::memory_order_relaxed);
+        wait_ns_total_.fetch_add(wait_ns, std::memory_order_relaxed);
+        wait_histogram_[bucketOf(wait_ns)].fetch_add(
+            1, std::memory_order_relaxed);
+
+        std::lock_guard lock(waiters_lock_);
+        auto& stats = waiters_[owner];
+        stats.owner = owner;
+        ++stats.contended;
+        stats.wait_ns_total += wait_ns;
+    } else {
+        wait_histogram_[0].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (hold_depth < hold_stack_size)
+        hold_stack[hold_depth] = {this, now()};
+    ++hold_depth;
+}
+
+void LockProfile::onRelease() {
+    if (hold_depth == 0) return;
+
+    size_t depth = std::min(hold_depth, hold_stack_size);
+    for (size_t i = depth; i-- > 0;) {
+        if (hold_stack[i].profile != this) continue;
+
+        uint64_t hold_ns = now() - hold_stack[i].start;
+        hold_ns_total_.fetch_add(hold_ns, std::memory_order_relaxed);
+        hold_histogram_[bucketOf(hold_ns)].fetch_add(
+            1, std::memory_order_relaxed);
+
+        std::copy(hold_stack + i + 1, hold_stack + depth, hold_stack + i);
+        break;
+    }
+    --hold_depth;
+}
+
+void LockProfile::snapshot(LockProfileSnapshot* result,
+                           size_t top_count) const {
+    result->acquisitions  = acquisitions_.load(std::memory_order_relaxed);
+    result->contended     = contended_.load(std::memory_order_relaxed);
+    result->wait_ns_total = wait_ns_total_.load(std::memory_order_relaxed);
+    result->hold_ns_total = hold_ns_total_.load(std::memory_order_relaxed);
+
+    for (size_t i = 0; i < lock_histogram_size; ++i) {
+        result->wait_histogram[i] =
+            wait_histogram_[i].load(std::memory_order_relaxed);
+        result->hold_histogram[i] =
+            hold_histogram_[i].load(std::memory_order_relaxed);
+    }
+
+    std::lock_guard lock(waiters_lock_);
+    result->top_waiters.clear();
+    for (auto& el : waiters_) result->top_waiters.push_back(el.second);
+
+    std::sort(result->top_waiters.begin(), result->top_waiters.end(),
+              [](const LockWaiterStats& lhs, const LockWaiterStats& rhs) {
+                  return lhs.wait_ns_total > rhs.wait_ns_total;
+              });
+    if (result->top_waiters.size() > top_count)
+        result->top_waiters.resize(top_count);
+}
+
+void LockProfile::reset() {
+    acquisitions_  = 0;
+    contended_     = 0;
+    wait_ns_total_ = 0;
+    hold_ns_total_ = 0;
+    for (auto& el : wait_histogram_) el = 0;
+    for (auto& el : hold_histogram_) el = 0;
+
+    std::lock_guard lock(waiters_lock_);
+    waiters_.clear();
+}
+
+}  // namespace ec
+
+#endif
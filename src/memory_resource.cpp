@@ -0,0 +1,157 @@
+#include <TMBEL/memory_resource.hpp>
+
+namespace ec {
+
+namespace {
+
+// Free lists of the calling thread, flushed to the depots on exit. Blocks
+// freed after that go to the depots one by one.
+struct NodeCache {
+    NodePoolResource::Block* heads[NodePoolResource::class_count] = {};
+    size_t counts[NodePoolResource::class_count]                 = {};
+    bool flushed                                                  = false;
+
+    ~NodeCache() {
+        auto pool = NodePoolResource::getInstance();
+        for (size_t i = 0; i < NodePoolResource::class_count; ++i) {
+            if (counts[i] != 0) pool->pushBatch(i, {heads[i], counts[i]});
+            heads[i]  = nullptr;
+            counts[i] = 0;
+        }
+        flushed = true;
+    }
+};
+
+thread_local NodeCache node_cache;
+
+size_t sizeClass(size_t bytes) {
+    return bytes == 0 ? 0 : (bytes - 1) / NodePoolResource::granularity;
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////
+// ArenaResource implementation
+////////////////////////////////////////////////////////////
+
+ArenaResource::ArenaResource(size_t initial_size,
+                             std::pmr::memory_resource* upstream)
+    : buffer_(new std::byte[initial_size]),
+      arena_(buffer_.get(), initial_size, upstream) {}
+
+void* ArenaResource::do_allocate(size_t bytes, size_t alignment) {
+    return arena_.allocate(bytes, alignment);
+}
+
+void ArenaResource::do_deallocate(void*, size_t, size_t) {}
+
+bool ArenaResource::do_is_equal(const memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+void ArenaResource::release() { arena_.release(); }
+
+////////////////////////////////////////////////////////////
+// NodePoolResource implementation
+////////////////////////////////////////////////////////////
+
+NodePoolResource::NodePoolResource()
+    : upstream_(std::pmr::new_delete_resource()),
+      large_(std::pmr::pool_options{0, max_large_size}, upstream_) {}
+
+NodePoolResource* NodePoolResource::getInstance() {
+    // Never destroyed, nodes may outlive static destruction.
+    static NodePoolResource* instance = new NodePoolResource();
+    return instance;
+}
+
+void* NodePoolResource::do_allocate(size_t bytes, size_t alignment) {
+    if (bytes > max_block_size || alignment > granularity)
+        return large_.allocate(bytes, alignment);
+
+    size_t size_class = sizeClass(bytes);
+    size_t block_size = (size_class + 1) * granularity;
+    NodeCache& cache  = node_cache;
+
+    if (cache.flushed) return upstream_->allocate(block_size, granularity);
+
+    if (cache.counts[size_class] == 0) {
+        Batch batch = popBatch(size_class);
+        if (batch.count == 0) {
+            // Carves a fresh batch out of one upstream chunk.
+            auto chunk = static_cast<std::byte*>(
+                upstream_->allocate(block_size * batch_size, granularity));
+
+            batch.head = nullptr;
+            for (size_t i = batch_size; i-- > 0;) {
+                auto block  = reinterpret_cast<Block*>(chunk + i * block_size);
+                block->next = batch.head;
+                batch.head  = block;
+            }
+            batch.count = batch_size;
+        }
+        cache.heads[size_class]  = batch.head;
+        cache.counts[size_class] = batch.count;
+    }
+
+    Block* block            = cache.heads[size_class];
+    cache.heads[size_class] = block->next;
+    --cache.counts[size_class];
+    return block;
+}
+
+void NodePoolResource::do_deallocate(void* pointer, size_t bytes,
+                                     size_t alignment) {
+    if (bytes > max_block_size || alignment > granularity) {
+        large_.deallocate(pointer, bytes, alignment);
+        return;
+    }
+
+    size_t size_class = sizeClass(bytes);
+    NodeCache& cache  = node_cache;
+    auto block        = static_cast<Block*>(pointer);
+
+    if (cache.flushed) {
+        block->next = nullptr;
+        pushBatch(size_class, {block, 1});
+        return;
+    }
+
+    block->next             = cache.heads[size_class];
+    cache.heads[size_class] = block;
+
+    // Consumers that free more than they allocate hand the surplus on.
+    if (++cache.counts[size_class] == 2 * batch_size) {
+        Batch batch{cache.heads[size_class], batch_size};
+        Block* last = batch.head;
+        for (size_t i = 1; i < batch_size; ++i) last = last->next;
+
+        cache.heads[size_class]  = last->next;
+        cache.counts[size_class] = batch_size;
+        last->next               = nullptr;
+        pushBatch(size_class, batch);
+    }
+}
+
+bool NodePoolResource::do_is_equal(const memory_resource& other) const
+    noexcept {
+    return this == &other;
+}
+
+void NodePoolResource::pushBatch(size_t size_class, Batch batch) {
+    Depot& depot = depots_[size_class];
+    std::lock_guard lock(depot.lock);
+    depot.batches.push_back(batch);
+}
+
+NodePoolResource::Batch NodePoolResource::popBatch(size_t size_class) {
+    Depot& depot = depots_[size_class];
+    std::lock_guard lock(depot.lock);
+
+    if (depot.batches.empty()) return {nullptr, 0};
+    Batch batch = depot.batches.back();
+    depot.batches.pop_back();
+    return batch;
+}
+
+}  // namespace ec
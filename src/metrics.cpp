@@ -0,0 +1,327 @@
+#include <TMBEL/metrics.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+namespace ec {
+
+namespace {
+
+using SteadyClock = std::chrono::steady_clock;
+
+struct Calibration {
+    uint64_t ticks;
+    SteadyClock::time_point time;
+};
+
+// Taken when the library is loaded, so later calls see a long interval.
+const Calibration calibration_start = {MetricsClock::now(), SteadyClock::now()};
+
+// Thread slots are reused after a thread exits. A slot has one owner at a
+// time, which is what allows the plain stores of HandlerMetrics::record().
+struct SlotPool {
+    std::mutex lock;
+    std::vector<size_t> free;
+    size_t next = 0;
+};
+
+SlotPool& slotPool() {
+    static SlotPool* pool = new SlotPool();
+    return *pool;
+}
+
+struct ThreadSlot {
+    size_t index;
+    size_t* cached = nullptr;  // HandlerMetrics::thread_slot_ of the thread
+
+    ThreadSlot() {
+        SlotPool& pool = slotPool();
+        std::lock_guard lock(pool.lock);
+
+        if (!pool.free.empty()) {
+            index = pool.free.back();
+            pool.free.pop_back();
+        } else if (pool.next < HandlerMetrics::max_threads) {
+            index = pool.next++;
+        } else {
+            index = HandlerMetrics::max_threads;
+        }
+    }
+
+    // Metrics recorded after this, by destructors of later thread
+    // locals, go to the shared slot.
+    ~ThreadSlot() {
+        if (cached != nullptr) *cached = HandlerMetrics::max_threads;
+        if (index == HandlerMetrics::max_threads) return;
+
+        SlotPool& pool = slotPool();
+        std::lock_guard lock(pool.lock);
+        pool.free.push_back(index);
+    }
+};
+
+thread_local ThreadSlot thread_slot;
+
+void writeLabel(std::ostream& stream, const std::string& value) {
+    for (char el : value) {
+        if (el == '\\')
+            stream << "\\\\";
+        else if (el == '"')
+            stream << "\\\"";
+        else if (el == '\n')
+            stream << "\\n";
+        else
+            stream << el;
+    }
+}
+
+double seconds(uint64_t ns) { return static_cast<double>(ns) * 1e-9; }
+
+}  // namespace
+
+////////////////////////////////////////////////////////////
+// MetricsClock implementation
+////////////////////////////////////////////////////////////
+
+double MetricsClock::nsPerTick() {
+#if defined(__x86_64__) || defined(__i386__)
+    constexpr auto minimal_interval = std::chrono::milliseconds(10);
+
+    auto until = calibration_start.time + minimal_interval;
+    if (SteadyClock::now() < until) std::this_thread::sleep_until(until);
+
+    uint64_t ticks = MetricsClock::now();
+    auto time      = SteadyClock::now();
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  time - calibration_start.time)
+                  .count();
+    return static_cast<double>(ns) / (ticks - calibration_start.ticks);
+#else
+    return 1.0;
+#endif
+}
+
+////////////////////////////////////////////////////////////
+// HandlerMetrics implementation
+////////////////////////////////////////////////////////////
+
+HandlerMetrics::Shard::Shard() {
+    for (auto& el : buckets) el.store(0, std::memory_order_relaxed);
+}
+
+size_t HandlerMetrics::assignSlot_() {
+    thread_slot.cached = &thread_slot_;
+    thread_slot_       = thread_slot.index;
+    return thread_slot_;
+}
+
+HandlerMetrics::Shard* HandlerMetrics::allocate_(size_t slot) {
+    Shard* result   = new Shard();
+    Shard* expected = nullptr;
+    if (!shards_[slot].compare_exchange_strong(expected, result,
+                                               std::memory_order_acq_rel)) {
+        delete result;
+        return expected;
+    }
+    return result;
+}
+
+HandlerMetrics::HandlerMetrics(const std::string& name) : name_(name) {
+    for (auto& el : shards_) el.store(nullptr, std::memory_order_relaxed);
+}
+
+HandlerMetrics::~HandlerMetrics() {
+    for (auto& el : shards_) delete el.load(std::memory_order_relaxed);
+}
+
+const std::string& HandlerMetrics::getName() const { return name_; }
+
+void HandlerMetrics::setSamplePeriod(uint32_t period) {
+    sample_period_ = std::max<uint32_t>(period, 1);
+}
+
+uint32_t HandlerMetrics::getSamplePeriod() const { return sample_period_; }
+
+void HandlerMetrics::snapshot(HandlerMetricsSnapshot* result) const {
+    Histogram histogram;
+    uint64_t calls       = 0;
+    uint64_t ticks_total = 0;
+    uint64_t max         = 0;
+
+    for (auto& el : shards_) {
+        Shard* shard = el.load(std::memory_order_acquire);
+        if (shard == nullptr) continue;
+
+        for (size_t i = 0; i < Histogram::bucket_count; ++i)
+            histogram.record(Histogram::bucketValue(i),
+                             shard->buckets[i].load(std::memory_order_relaxed));
+        calls += shard->calls.load(std::memory_order_relaxed);
+        ticks_total += shard->ticks_total.load(std::memory_order_relaxed);
+        max = std::max(max, shard->max.load(std::memory_order_relaxed));
+    }
+
+    double ns_per_tick = MetricsClock::nsPerTick();
+    auto toNs = [ns_per_tick, max](uint64_t ticks) {
+        return static_cast<uint64_t>(std::min(ticks, max) * ns_per_tick);
+    };
+
+    double scale = histogram.count() == 0
+                       ? 0.0
+                       : static_cast<double>(calls) / histogram.count();
+
+    result->name     = name_;
+    result->calls    = calls;
+    result->timed    = histogram.count();
+    result->total_ns = static_cast<uint64_t>(ticks_total * ns_per_tick * scale);
+    result->p50      = toNs(histogram.percentile(0.5));
+    result->p90      = toNs(histogram.percentile(0.9));
+    result->p99      = toNs(histogram.percentile(0.99));
+    result->p999     = toNs(histogram.percentile(0.999));
+    result->max      = toNs(max);
+}
+
+////////////////////////////////////////////////////////////
+// MetricsRegistry implementation
+////////////////////////////////////////////////////////////
+
+MetricsRegistry::MetricsRegistry() = default;
+
+MetricsRegistry::~MetricsRegistry() = default;
+
+HandlerMetrics* MetricsRegistry::getHandlerMetrics(const std::string& name) {
+    std::lock_guard lock(lock_);
+
+    auto& result = handlers_[name];
+    if (!result) result = std::make_unique<HandlerMetrics>(name);
+    return result.get();
+}
+
+MetricsRegistry::Position MetricsRegistry::watchQueue(const std::string& name,
+                                                      Source source) {
+    std::lock_guard lock(lock_);
+
+    Position position = next_position_++;
+    Queue& queue      = queues_[position];
+    queue.name        = name;
+    queue.source      = std::move(source);
+    queue.last        = queue.source();
+    queue.last_time   = SteadyClock::now();
+    return position;
+}
+
+void MetricsRegistry::unwatchQueue(Position position) {
+    std::lock_guard lock(lock_);
+    queues_.erase(position);
+}
+
+MetricsSnapshot MetricsRegistry::snapshot() {
+    std::lock_guard lock(lock_);
+    MetricsSnapshot result;
+
+    for (auto& el : handlers_) {
+        result.handlers.emplace_back();
+        el.second->snapshot(&result.handlers.back());
+    }
+
+    for (auto& el : queues_) {
+        Queue& queue           = el.second;
+        QueueCounters counters = queue.source();
+        auto time              = SteadyClock::now();
+        double interval =
+            std::chrono::duration<double>(time - queue.last_time).count();
+
+        QueueMetricsSnapshot snapshot;
+        snapshot.name     = queue.name;
+        snapshot.depth    = counters.depth;
+        snapshot.enqueued = counters.enqueued;
+        snapshot.dequeued = counters.dequeued;
+        if (interval > 0) {
+            snapshot.enqueue_rate =
+                (counters.enqueued - queue.last.enqueued) / interval;
+            snapshot.dequeue_rate =
+                (counters.dequeued - queue.last.dequeued) / interval;
+        }
+        result.queues.push_back(std::move(snapshot));
+
+        queue.last      = counters;
+        queue.last_time = time;
+    }
+    return result;
+}
+
+void MetricsRegistry::writeText(std::ostream& stream) {
+    MetricsSnapshot metrics = snapshot();
+
+    auto series = [&stream](const char* metric, const char* label,
+                            const std::string& name) -> std::ostream& {
+        stream << metric << '{' << label << "=\"";
+        writeLabel(stream, name);
+        return stream << '"';
+    };
+
+    stream << "# TYPE tmbel_handler_calls_total counter\n";
+    for (auto& el : metrics.handlers)
+        series("tmbel_handler_calls_total", "handler", el.name)
+            << "} " << el.calls << '\n';
+
+    stream << "# TYPE tmbel_handler_latency_seconds summary\n";
+    for (auto& el : metrics.handlers) {
+        std::pair<const char*, uint64_t> quantiles[] = {
+            {"0.5", el.p50}, {"0.9", el.p90}, {"0.99", el.p99},
+            {"0.999", el.p999}};
+        for (auto& quantile : quantiles)
+            series("tmbel_handler_latency_seconds", "handler", el.name)
+                << ",quantile=\"" << quantile.first << "\"} "
+                << seconds(quantile.second) << '\n';
+
+        series("tmbel_handler_latency_seconds_sum", "handler", el.name)
+            << "} " << seconds(el.total_ns) << '\n';
+        series("tmbel_handler_latency_seconds_count", "handler", el.name)
+            << "} " << el.calls << '\n';
+    }
+
+    stream << "# TYPE tmbel_handler_latency_max_seconds gauge\n";
+    for (auto& el : metrics.handlers)
+        series("tmbel_handler_latency_max_seconds", "handler", el.name)
+            << "} " << seconds(el.max) << '\n';
+
+    stream << "# TYPE tmbel_queue_depth gauge\n";
+    for (auto& el : metrics.queues)
+        series("tmbel_queue_depth", "queue", el.name)
+            << "} " << el.depth << '\n';
+
+    stream << "# TYPE tmbel_queue_enqueued_total counter\n";
+    for (auto& el : metrics.queues)
+        series("tmbel_queue_enqueued_total", "queue", el.name)
+            << "} " << el.enqueued << '\n';
+
+    stream << "# TYPE tmbel_queue_dequeued_total counter\n";
+    for (auto& el : metrics.queues)
+        series("tmbel_queue_dequeued_total", "queue", el.name)
+            << "} " << el.dequeued << '\n';
+
+    stream << "# TYPE tmbel_queue_enqueue_rate gauge\n";
+    for (auto& el : metrics.queues)
+        series("tmbel_queue_enqueue_rate", "queue", el.name)
+            << "} " << el.enqueue_rate << '\n';
+
+    stream << "# TYPE tmbel_queue_dequeue_rate gauge\n";
+    for (auto& el : metrics.queues)
+        series("tmbel_queue_dequeue_rate", "queue", el.name)
+            << "} " << el.dequeue_rate << '\n';
+}
+
+bool MetricsRegistry::writeText(const std::string& path) {
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream stream(temporary, std::ios::trunc);
+        if (!stream) return false;
+        writeText(stream);
+        if (!stream.flush()) return false;
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+}  // namespace ec
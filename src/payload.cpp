@@ -0,0 +1,95 @@
+#include <TMBEL/payload.hpp>
+
+namespace ec {
+
+////////////////////////////////////////////////////////////
+// SharedBuffer implementation
+////////////////////////////////////////////////////////////
+
+SharedBuffer SharedBuffer::copy(const void* data, size_t size) {
+    void* memory = NodePoolResource::getInstance()->allocate(
+        sizeof(Header) + size, alignof(Header));
+
+    auto header  = new (memory) Header();
+    header->size = size;
+    if (size != 0)
+        std::memcpy(reinterpret_cast<std::byte*>(header + 1), data, size);
+    return Self(header);
+}
+
+SharedBuffer SharedBuffer::copy(std::string_view data) {
+    return copy(data.data(), data.size());
+}
+
+SharedBuffer::SharedBuffer(const Self& other) : header_(other.header_) {
+    acquire_();
+}
+
+SharedBuffer::SharedBuffer(Self&& other) noexcept : header_(other.header_) {
+    other.header_ = nullptr;
+}
+
+SharedBuffer::~SharedBuffer() { release_(); }
+
+SharedBuffer& SharedBuffer::operator=(const Self& other) {
+    other.acquire_();
+    release_();
+    header_ = other.header_;
+    return *this;
+}
+
+SharedBuffer& SharedBuffer::operator=(Self&& other) noexcept {
+    if (this != &other) {
+        release_();
+        header_       = other.header_;
+        other.header_ = nullptr;
+    }
+    return *this;
+}
+
+void SharedBuffer::acquire_() const {
+    if (header_ != nullptr)
+        header_->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SharedBuffer::release_() {
+    if (header_ == nullptr ||
+        header_->references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    size_t size = header_->size;
+    header_->~Header();
+    NodePoolResource::getInstance()->deallocate(header_, sizeof(Header) + size,
+                                                alignof(Header));
+}
+
+void SharedBuffer::reset() {
+    release_();
+    header_ = nullptr;
+}
+
+const std::byte* SharedBuffer::data() const {
+    return header_ ? reinterpret_cast<const std::byte*>(header_ + 1) : nullptr;
+}
+
+size_t SharedBuffer::size() const { return header_ ? header_->size : 0; }
+
+bool SharedBuffer::empty() const { return size() == 0; }
+
+std::string_view SharedBuffer::view() const {
+    return std::string_view(reinterpret_cast<const char*>(data()), size());
+}
+
+size_t SharedBuffer::useCount() const {
+    return header_ ? header_->references.load(std::memory_order_relaxed) : 0;
+}
+
+bool SharedBuffer::operator==(const Self& other) const {
+    return header_ == other.header_;
+}
+
+bool SharedBuffer::operator!=(const Self& other) const {
+    return header_ != other.header_;
+}
+
+}  // namespace ec
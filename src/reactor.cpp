@@ -0,0 +1,114 @@
+#include <TMBEL/reactor.hpp>
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <system_error>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace ec {
+
+namespace {
+
+[[noreturn]] void throwErrno(const char* what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////
+// Reactor implementation
+////////////////////////////////////////////////////////////
+
+Reactor::Reactor() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) throwErrno("ec::Reactor epoll_create1");
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        close(epoll_fd_);
+        throwErrno("ec::Reactor eventfd");
+    }
+
+    epoll_event event{};
+    event.events  = EPOLLIN;
+    event.data.fd = wake_fd_;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event) < 0) {
+        close(wake_fd_);
+        close(epoll_fd_);
+        throwErrno("ec::Reactor epoll_ctl");
+    }
+}
+
+Reactor::~Reactor() {
+    close(wake_fd_);
+    close(epoll_fd_);
+}
+
+void Reactor::watch(int fd, uint32_t events, Callback callback) {
+    std::lock_guard lock(lock_);
+
+    epoll_event event{};
+    event.events  = events | EPOLLET;
+    event.data.fd = fd;
+
+    bool watched = callbacks_.count(fd) != 0;
+    if (epoll_ctl(epoll_fd_, watched ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd,
+                  &event) < 0)
+        throwErrno("ec::Reactor::watch");
+
+    callbacks_[fd] = std::make_shared<Callback>(std::move(callback));
+}
+
+void Reactor::unwatch(int fd) {
+    std::lock_guard lock(lock_);
+    if (callbacks_.erase(fd) == 0) return;
+
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+size_t Reactor::poll(int timeout_ms) {
+    epoll_event events[batch_size];
+
+    int count = epoll_wait(epoll_fd_, events, batch_size, timeout_ms);
+    if (count < 0) {
+        if (errno == EINTR) return 0;
+        throwErrno("ec::Reactor::poll");
+    }
+
+    size_t result = 0;
+    for (int i = 0; i < count; ++i) {
+        int fd = events[i].data.fd;
+        if (fd == wake_fd_) {
+            uint64_t value;
+            while (read(wake_fd_, &value, sizeof(value)) > 0)
+                ;
+            continue;
+        }
+
+        // Callback is copied so it may unwatch its own descriptor.
+        std::shared_ptr<Callback> callback;
+        {
+            std::lock_guard lock(lock_);
+            auto position = callbacks_.find(fd);
+            if (position == callbacks_.end()) continue;
+            callback = position->second;
+        }
+
+        (*callback)(fd, events[i].events);
+        ++result;
+    }
+    return result;
+}
+
+void Reactor::wake() {
+    uint64_t value = 1;
+    while (write(wake_fd_, &value, sizeof(value)) < 0 && errno == EINTR)
+        ;
+}
+
+}  // namespace ec
+
+#endif
@@ -0,0 +1,256 @@
+#include <TMBEL/recorder.hpp>
+#include <cerrno>
+#include <exception>
+#include <system_error>
+
+namespace ec {
+
+namespace {
+
+[[noreturn]] void throwErrno(const char* what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+void putVarint(std::string* out, uint64_t value) {
+    while (value >= 0x80) {
+        out->push_back(char(value | 0x80));
+        value >>= 7;
+    }
+    out->push_back(char(value));
+}
+
+bool getVarint(const std::string& in, size_t* position, uint64_t* value) {
+    *value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (*position == in.size()) return false;
+
+        auto byte = uint8_t(in[(*position)++]);
+        *value |= uint64_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+void putUint32(std::string* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) out->push_back(char(value >> (8 * i)));
+}
+
+uint32_t getUint32(const std::string& in, size_t position) {
+    uint32_t result = 0;
+    for (int i = 0; i < 4; ++i)
+        result |= uint32_t(uint8_t(in[position + i])) << (8 * i);
+    return result;
+}
+
+// Buffers the writer thread may hold before record() waits for it.
+constexpr size_t max_pending = 4;
+
+}  // namespace
+
+////////////////////////////////////////////////////////////
+// EventRecorder implementation
+////////////////////////////////////////////////////////////
+
+EventRecorder::EventRecorder(const std::string& path, bool async,
+                             size_t buffer_size)
+    : buffer_size_(buffer_size), origin_(Clock::now()), async_(async) {
+    file_ = std::fopen(path.c_str(), "wb");
+    if (file_ == nullptr) throwErrno("ec::EventRecorder fopen");
+    // Records are already batched in buffer_.
+    std::setvbuf(file_, nullptr, _IONBF, 0);
+
+    std::string header(magic, sizeof(magic));
+    putUint32(&header, version);
+    putUint32(&header, 0);
+    if (!writeFile_(header)) {
+        int error = errno;
+        std::fclose(file_);
+        errno = error;
+        throwErrno("ec::EventRecorder write");
+    }
+
+    buffer_.reserve(buffer_size_);
+    if (async_) writer_ = std::thread(&Self::work_, this);
+}
+
+EventRecorder::~EventRecorder() {
+    try {
+        close();
+    } catch (const std::system_error&) {
+    }
+}
+
+bool EventRecorder::writeFile_(const std::string& buffer) {
+    return std::fwrite(buffer.data(), 1, buffer.size(), file_) == buffer.size();
+}
+
+void EventRecorder::submit_(std::unique_lock<std::mutex>& lock) {
+    if (buffer_.empty()) return;
+
+    if (!async_) {
+        bool written = writeFile_(buffer_);
+        buffer_.clear();
+        if (!written) throwErrno("ec::EventRecorder write");
+        return;
+    }
+
+    wait_.wait(lock, [this] { return pending_.size() < max_pending; });
+    pending_.push_back(std::move(buffer_));
+    if (spare_.empty()) {
+        buffer_ = std::string();
+        buffer_.reserve(buffer_size_);
+    } else {
+        buffer_ = std::move(spare_.back());
+        spare_.pop_back();
+    }
+    wait_.notify_all();
+}
+
+void EventRecorder::throwError_() {
+    if (error_ == 0) return;
+
+    errno  = error_;
+    error_ = 0;
+    throwErrno("ec::EventRecorder write");
+}
+
+void EventRecorder::work_() {
+    std::unique_lock lock(lock_);
+
+    while (true) {
+        wait_.wait(lock, [this] { return !pending_.empty() || stopping_; });
+        if (pending_.empty()) return;
+
+        std::string buffer = std::move(pending_.front());
+        pending_.erase(pending_.begin());
+        writing_ = true;
+
+        lock.unlock();
+        bool written = writeFile_(buffer);
+        int error    = errno;
+        lock.lock();
+
+        if (!written && error_ == 0) error_ = error;
+        writing_ = false;
+        buffer.clear();
+        spare_.push_back(std::move(buffer));
+        wait_.notify_all();
+    }
+}
+
+void EventRecorder::record(std::string_view bytes) {
+    std::unique_lock lock(lock_);
+    uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        Clock::now() - origin_)
+                        .count();
+    record_(lock, time, bytes);
+}
+
+void EventRecorder::record(uint64_t time, std::string_view bytes) {
+    std::unique_lock lock(lock_);
+    record_(lock, time, bytes);
+}
+
+void EventRecorder::record_(std::unique_lock<std::mutex>& lock, uint64_t time,
+                            std::string_view bytes) {
+    if (file_ == nullptr) return;
+
+    putVarint(&buffer_, time > last_ ? time - last_ : 0);
+    putVarint(&buffer_, bytes.size());
+    buffer_.append(bytes);
+    last_ = std::max(last_, time);
+    ++count_;
+
+    if (buffer_.size() >= buffer_size_) submit_(lock);
+}
+
+void EventRecorder::flush() {
+    std::unique_lock lock(lock_);
+    if (file_ == nullptr) return;
+
+    submit_(lock);
+    wait_.wait(lock, [this] { return pending_.empty() && !writing_; });
+    throwError_();
+}
+
+void EventRecorder::close() {
+    std::unique_lock lock(lock_);
+    if (file_ == nullptr) return;
+
+    // The writer is stopped and the file closed also when writing
+    // failed, the error is thrown afterwards.
+    std::exception_ptr error;
+    try {
+        submit_(lock);
+        wait_.wait(lock, [this] { return pending_.empty() && !writing_; });
+        throwError_();
+    } catch (const std::system_error&) {
+        error = std::current_exception();
+    }
+
+    if (writer_.joinable()) {
+        stopping_ = true;
+        wait_.notify_all();
+        lock.unlock();
+        writer_.join();
+        lock.lock();
+    }
+
+    int result = std::fclose(file_);
+    file_      = nullptr;
+    if (error) std::rethrow_exception(error);
+    if (result != 0) throwErrno("ec::EventRecorder fclose");
+}
+
+uint64_t EventRecorder::count() {
+    std::lock_guard lock(lock_);
+    return count_;
+}
+
+////////////////////////////////////////////////////////////
+// RecordReader implementation
+////////////////////////////////////////////////////////////
+
+RecordReader::RecordReader(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) throwErrno("ec::RecordReader fopen");
+
+    char chunk[1 << 16];
+    while (size_t size = std::fread(chunk, 1, sizeof(chunk), file))
+        data_.append(chunk, size);
+    bool failed = std::ferror(file) != 0;
+    std::fclose(file);
+    if (failed) throw std::runtime_error("ec::RecordReader cannot read " + path);
+
+    if (data_.size() < EventRecorder::header_size ||
+        data_.compare(0, sizeof(EventRecorder::magic), EventRecorder::magic,
+                      sizeof(EventRecorder::magic)) != 0)
+        throw std::runtime_error("ec::RecordReader " + path +
+                                 " is not a recording");
+    if (getUint32(data_, sizeof(EventRecorder::magic)) != EventRecorder::version)
+        throw std::runtime_error("ec::RecordReader " + path +
+                                 " has an unknown version");
+}
+
+bool RecordReader::next(uint64_t* time, std::string_view* bytes) {
+    if (position_ == data_.size()) return false;
+
+    uint64_t delta, size;
+    if (!getVarint(data_, &position_, &delta) ||
+        !getVarint(data_, &position_, &size) ||
+        size > data_.size() - position_)
+        throw std::runtime_error("ec::RecordReader truncated record");
+
+    time_ += delta;
+    *time  = time_;
+    *bytes = std::string_view(data_.data() + position_, size);
+    position_ += size;
+    return true;
+}
+
+void RecordReader::rewind() {
+    position_ = EventRecorder::header_size;
+    time_     = 0;
+}
+
+}  // namespace ec
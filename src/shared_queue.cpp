@@ -0,0 +1,203 @@
+#include <TMBEL/shared_queue.hpp>
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace ec {
+
+namespace {
+
+[[noreturn]] void throwErrno(const char* what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+// Process-shared futex, the words live in memory mapped by every side.
+void futexWait(std::atomic<uint32_t>* word, uint32_t expected) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected,
+            nullptr, nullptr, 0);
+}
+
+void futexWake(std::atomic<uint32_t>* word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX,
+            nullptr, nullptr, 0);
+}
+
+size_t roundCapacity(size_t capacity) {
+    size_t result = 2;
+    while (result < capacity) result <<= 1;
+    return result;
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////
+// SharedQueueBase implementation
+////////////////////////////////////////////////////////////
+
+SharedQueueBase::SharedQueueBase(Self&& other) noexcept {
+    *this = std::move(other);
+}
+
+SharedQueueBase::~SharedQueueBase() {
+    if (header_ != nullptr) munmap(header_, size_);
+    if (fd_ >= 0) ::close(fd_);
+}
+
+SharedQueueBase& SharedQueueBase::operator=(Self&& other) noexcept {
+    if (this == &other) return *this;
+
+    if (header_ != nullptr) munmap(header_, size_);
+    if (fd_ >= 0) ::close(fd_);
+
+    fd_     = other.fd_;
+    size_   = other.size_;
+    header_ = other.header_;
+    slots_  = other.slots_;
+
+    other.fd_     = -1;
+    other.size_   = 0;
+    other.header_ = nullptr;
+    other.slots_  = nullptr;
+    return *this;
+}
+
+int SharedQueueBase::createFd_(const std::string& name) {
+    int fd =
+        shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) throwErrno("ec::SharedQueue shm_open");
+    return fd;
+}
+
+int SharedQueueBase::openFd_(const std::string& name) {
+    int fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) throwErrno("ec::SharedQueue shm_open");
+    return fd;
+}
+
+int SharedQueueBase::anonymousFd_() {
+    int fd = memfd_create("tmbel_shared_queue", MFD_CLOEXEC);
+    if (fd < 0) throwErrno("ec::SharedQueue memfd_create");
+    return fd;
+}
+
+int SharedQueueBase::duplicateFd_(int fd) {
+    int result = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (result < 0) throwErrno("ec::SharedQueue dup");
+    return result;
+}
+
+void SharedQueueBase::unlink(const std::string& name) {
+    if (shm_unlink(name.c_str()) < 0) throwErrno("ec::SharedQueue shm_unlink");
+}
+
+uint64_t SharedQueueBase::typeHash_(const std::type_info& type) {
+    // FNV-1a, the mangled name is the same in every process of the ABI.
+    uint64_t result = 0xcbf29ce484222325ULL;
+    for (const char* el = type.name(); *el != 0; ++el)
+        result = (result ^ uint8_t(*el)) * 0x100000001b3ULL;
+    return result;
+}
+
+void SharedQueueBase::create_(int fd, size_t capacity, size_t slot_size,
+                              const std::type_info& type,
+                              SharedQueueMode mode) {
+    fd_      = fd;
+    capacity = roundCapacity(capacity);
+    size_    = sizeof(Header) + capacity * slot_size;
+
+    if (ftruncate(fd_, size_) < 0) throwErrno("ec::SharedQueue ftruncate");
+
+    void* memory =
+        mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (memory == MAP_FAILED) throwErrno("ec::SharedQueue mmap");
+
+    header_ = new (memory) Header();
+    slots_  = reinterpret_cast<std::byte*>(header_ + 1);
+
+    header_->mode      = mode;
+    header_->slot_size = slot_size;
+    header_->type      = typeHash_(type);
+    header_->capacity  = capacity;
+
+    // Slot sequences start at their index, the first element of every
+    // slot is its sequence.
+    for (size_t i = 0; i < capacity; ++i)
+        new (slots_ + i * slot_size) std::atomic<uint64_t>(i);
+
+    header_->version = version;
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = magic;
+}
+
+void SharedQueueBase::map_(int fd, size_t slot_size,
+                           const std::type_info& type) {
+    fd_ = fd;
+
+    struct stat status;
+    if (fstat(fd_, &status) < 0) throwErrno("ec::SharedQueue fstat");
+    size_ = status.st_size;
+    if (size_ < sizeof(Header))
+        throw std::runtime_error("ec::SharedQueue region is not a queue");
+
+    void* memory =
+        mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (memory == MAP_FAILED) throwErrno("ec::SharedQueue mmap");
+
+    header_ = static_cast<Header*>(memory);
+    slots_  = reinterpret_cast<std::byte*>(header_ + 1);
+
+    if (header_->magic != magic || header_->version != version)
+        throw std::runtime_error("ec::SharedQueue region is not a queue");
+    if (header_->slot_size != slot_size || header_->type != typeHash_(type) ||
+        size_ < sizeof(Header) + header_->capacity * slot_size)
+        throw std::runtime_error("ec::SharedQueue was made for another type");
+}
+
+size_t SharedQueueBase::size() const {
+    uint64_t head = header_->head.load(std::memory_order_acquire);
+    uint64_t tail = header_->tail.load(std::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+}
+
+void SharedQueueBase::close() {
+    header_->closed.store(1, std::memory_order_seq_cst);
+    wakeReadable_();
+    wakeWritable_();
+}
+
+bool SharedQueueBase::isClosed() const {
+    return header_->closed.load(std::memory_order_acquire) != 0;
+}
+
+void SharedQueueBase::wakeReadable_() {
+    header_->readable.fetch_add(1, std::memory_order_release);
+    futexWake(&header_->readable);
+}
+
+void SharedQueueBase::wakeWritable_() {
+    header_->writable.fetch_add(1, std::memory_order_release);
+    futexWake(&header_->writable);
+}
+
+void SharedQueueBase::waitReadable_(uint32_t seen) {
+    futexWait(&header_->readable, seen);
+}
+
+void SharedQueueBase::waitWritable_(uint32_t seen) {
+    futexWait(&header_->writable, seen);
+}
+
+}  // namespace ec
+
+#endif
@@ -0,0 +1,269 @@
+#include <TMBEL/tracing.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+namespace ec {
+
+// Ring of the calling thread, handed back to the tracer when the thread
+// exits so threads that come and go reuse the same buffers.
+struct TraceThread {
+    Tracer::Ring* ring = nullptr;
+    uint32_t id;
+
+    TraceThread() {
+        static std::atomic<uint32_t> next_id{0};
+        id = next_id.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    ~TraceThread() {
+        if (ring != nullptr) Tracer::getInstance()->releaseRing_(ring);
+    }
+};
+
+namespace {
+
+thread_local TraceThread trace_thread;
+
+struct Record {
+    uint64_t ticks;
+    uint64_t event;
+    const void* object;
+    uint32_t thread;
+    TraceKind kind;
+};
+
+void writeString(std::ostream& stream, const std::string& value) {
+    stream << '"';
+    for (char el : value) {
+        if (el == '"' || el == '\\')
+            stream << '\\' << el;
+        else if (static_cast<unsigned char>(el) < 0x20)
+            stream << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                   << static_cast<int>(el) << std::dec << std::setfill(' ');
+        else
+            stream << el;
+    }
+    stream << '"';
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////
+// Tracer implementation
+////////////////////////////////////////////////////////////
+
+Tracer::Ring::Ring(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+
+    slots.reset(new Slot[size]);
+    mask = size - 1;
+}
+
+Tracer::Tracer() = default;
+
+Tracer::~Tracer() = default;
+
+void Tracer::record(TraceKind kind, uint64_t event, const void* object) {
+    Ring* ring = trace_thread.ring;
+    if (ring == nullptr) ring = trace_thread.ring = getInstance()->acquireRing_();
+
+    uint64_t position = ring->end.load(std::memory_order_relaxed);
+    ring->begin.store(position + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Slot& slot = ring->slots[position & ring->mask];
+    slot.ticks.store(MetricsClock::now(), std::memory_order_relaxed);
+    slot.event.store(event, std::memory_order_relaxed);
+    slot.object.store(reinterpret_cast<uintptr_t>(object),
+                      std::memory_order_relaxed);
+    slot.info.store(uint64_t(trace_thread.id) << 8 | uint64_t(kind),
+                    std::memory_order_relaxed);
+
+    ring->end.store(position + 1, std::memory_order_release);
+}
+
+Tracer::Ring* Tracer::acquireRing_() {
+    std::lock_guard lock(lock_);
+
+    if (!free_rings_.empty()) {
+        Ring* result = free_rings_.back();
+        free_rings_.pop_back();
+        return result;
+    }
+    rings_.push_back(std::make_unique<Ring>(capacity_));
+    return rings_.back().get();
+}
+
+void Tracer::releaseRing_(Ring* ring) {
+    std::lock_guard lock(lock_);
+    free_rings_.push_back(ring);
+}
+
+void Tracer::start(size_t capacity) {
+    {
+        std::lock_guard lock(lock_);
+        capacity_ = std::max<size_t>(capacity, 1);
+    }
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::stop() { enabled_.store(false, std::memory_order_relaxed); }
+
+void Tracer::clear() { since_.store(MetricsClock::now()); }
+
+void Tracer::setName(const void* object, const std::string& name) {
+    std::lock_guard lock(lock_);
+    names_[object] = name;
+}
+
+void Tracer::removeName(const void* object) {
+    std::lock_guard lock(lock_);
+    names_.erase(object);
+}
+
+std::string Tracer::getName(const void* object) {
+    std::lock_guard lock(lock_);
+    auto position = names_.find(object);
+    return position != names_.end() ? position->second : std::string();
+}
+
+void Tracer::writeChromeTrace(std::ostream& stream) {
+    std::vector<Record> records;
+    std::unordered_map<const void*, std::string> names;
+    uint64_t since = since_.load();
+    {
+        std::lock_guard lock(lock_);
+        names = names_;
+
+        for (auto& ring : rings_) {
+            uint64_t end      = ring->end.load(std::memory_order_acquire);
+            size_t capacity   = ring->mask + 1;
+            uint64_t first    = end > capacity ? end - capacity : 0;
+            size_t read_begin = records.size();
+
+            for (uint64_t i = first; i < end; ++i) {
+                Slot& slot    = ring->slots[i & ring->mask];
+                uint64_t info = slot.info.load(std::memory_order_relaxed);
+
+                Record record;
+                record.ticks  = slot.ticks.load(std::memory_order_relaxed);
+                record.event  = slot.event.load(std::memory_order_relaxed);
+                record.object = reinterpret_cast<const void*>(
+                    slot.object.load(std::memory_order_relaxed));
+                record.thread = static_cast<uint32_t>(info >> 8);
+                record.kind   = static_cast<TraceKind>(info & 0xff);
+                records.push_back(record);
+            }
+
+            // Drops the slots the writer started to overwrite meanwhile.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t begin = ring->begin.load(std::memory_order_relaxed);
+            if (begin > capacity && begin - capacity > first) {
+                size_t overwritten =
+                    std::min<uint64_t>(begin - capacity - first, end - first);
+                records.erase(records.begin() + read_begin,
+                              records.begin() + read_begin + overwritten);
+            }
+        }
+    }
+
+    records.erase(std::remove_if(records.begin(), records.end(),
+                                 [since](const Record& el) {
+                                     return el.ticks < since;
+                                 }),
+                  records.end());
+    std::stable_sort(records.begin(), records.end(),
+                     [](const Record& lhs, const Record& rhs) {
+                         return lhs.ticks < rhs.ticks;
+                     });
+
+    double ns_per_tick = MetricsClock::nsPerTick();
+    uint64_t origin    = records.empty() ? 0 : records.front().ticks;
+
+    auto nameOf = [&names](const void* object, const char* kind) {
+        auto position = names.find(object);
+        if (position != names.end()) return position->second;
+
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), "%s@%p", kind, object);
+        return std::string(buffer);
+    };
+
+    bool first = true;
+    auto begin = [&](const Record& record, const char* phase) -> std::ostream& {
+        stream << (first ? "\n" : ",\n");
+        first = false;
+
+        double ts = (record.ticks - origin) * ns_per_tick / 1000.0;
+        return stream << "{\"ph\":\"" << phase << "\",\"pid\":1,\"tid\":"
+                      << record.thread << ",\"ts\":" << std::fixed
+                      << std::setprecision(3) << ts;
+    };
+
+    auto flow = [&](const Record& record, const char* category,
+                    const char* phase) {
+        begin(record, phase) << ",\"cat\":\"" << category
+                             << "\",\"name\":\"event\",\"id\":" << record.event;
+        if (phase[0] == 'f') stream << ",\"bp\":\"e\"";
+        stream << '}';
+    };
+
+    auto mark = [&](const Record& record, const char* category,
+                    const char* name, const char* kind) {
+        begin(record, "X") << ",\"dur\":0,\"cat\":\"" << category
+                           << "\",\"name\":\"" << name
+                           << "\",\"args\":{\"event\":" << record.event
+                           << ",\"object\":";
+        writeString(stream, nameOf(record.object, kind));
+        stream << "}}";
+    };
+
+    std::ios::fmtflags flags = stream.flags();
+    std::streamsize precision = stream.precision();
+
+    stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    for (auto& el : records) {
+        switch (el.kind) {
+            case TraceKind::Enqueue:
+                mark(el, "queue", "enqueue", "queue");
+                flow(el, "queue", "s");
+                break;
+            case TraceKind::Dequeue:
+                mark(el, "queue", "dequeue", "queue");
+                flow(el, "queue", "f");
+                break;
+            case TraceKind::HandlerBegin:
+                begin(el, "B") << ",\"cat\":\"handler\",\"name\":";
+                writeString(stream, nameOf(el.object, "handler"));
+                stream << ",\"args\":{\"event\":" << el.event << "}}";
+                break;
+            case TraceKind::HandlerEnd:
+                begin(el, "E") << '}';
+                break;
+            case TraceKind::AsyncBegin:
+                mark(el, "async", "hand-off", "handler");
+                flow(el, "async", "s");
+                break;
+            case TraceKind::AsyncEnd:
+                mark(el, "async", "pick-up", "handler");
+                flow(el, "async", "f");
+                break;
+        }
+    }
+    stream << "\n]}\n";
+
+    stream.flags(flags);
+    stream.precision(precision);
+}
+
+bool Tracer::writeChromeTrace(const std::string& path) {
+    std::ofstream stream(path, std::ios::trunc);
+    if (!stream) return false;
+    writeChromeTrace(stream);
+    return static_cast<bool>(stream.flush());
+}
+
+}  // namespace ec
@@ -0,0 +1,284 @@
+#include "stress.hpp"
+
+#include <TMBEL.hpp>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace stress {
+
+void containerCases(Runner& runner) {
+    runner.run("mt_list/mutate", [](uint64_t seed) {
+        constexpr size_t threads = 4;
+
+        ec::MtListBase<uint64_t> list;
+        std::vector<size_t> live(threads, 0);
+
+        parallel(threads, [&](size_t index) {
+            Random random(seed + index);
+            std::vector<ec::MtListBase<uint64_t>::Position> own;
+
+            for (size_t i = 0; i < 500; ++i) {
+                switch (random() % 4) {
+                    case 0:
+                    case 1:
+                        own.push_back(list.push_back(index));
+                        break;
+                    case 2:
+                        if (!own.empty()) {
+                            size_t position = random() % own.size();
+                            list.erase(own[position]);
+                            own[position] = own.back();
+                            own.pop_back();
+                        }
+                        break;
+                    default: {
+                        size_t count = 0;
+                        list.map([&count, index](uint64_t& el) {
+                            if (el == index) ++count;
+                        });
+                        check(count == own.size(), "map() saw foreign changes");
+                    }
+                }
+            }
+            live[index] = own.size();
+        });
+
+        size_t expected = 0;
+        for (auto el : live) expected += el;
+        check(list.size() == expected, "list size out of sync");
+    });
+
+    runner.run("global_mas/handles", [](uint64_t seed) {
+        constexpr size_t threads = 4;
+
+        ec::GlobalMasBase<uint64_t> mas;
+        std::vector<ec::HandlerList<uint64_t>> lists(threads);
+
+        parallel(threads, [&](size_t index) {
+            Random random(seed + index);
+            std::vector<ec::SlotHandle> own;
+            std::vector<ec::SlotHandle> stale;
+
+            for (size_t i = 0; i < 1000; ++i) {
+                switch (random() % 4) {
+                    case 0:
+                        own.push_back(mas.push(&lists[index]));
+                        break;
+                    case 1:
+                        if (!own.empty()) {
+                            size_t position = random() % own.size();
+                            check(mas.pop(own[position]) == &lists[index],
+                                  "pop() returned a foreign list");
+                            stale.push_back(own[position]);
+                            own[position] = own.back();
+                            own.pop_back();
+                        }
+                        break;
+                    case 2:
+                        if (!own.empty())
+                            check(mas.get(own[random() % own.size()]) ==
+                                      &lists[index],
+                                  "get() returned a foreign list");
+                        break;
+                    default:
+                        if (!stale.empty()) {
+                            bool thrown = false;
+                            try {
+                                mas.get(stale[random() % stale.size()]);
+                            } catch (const std::out_of_range&) {
+                                thrown = true;
+                            }
+                            check(thrown, "stale handle resolved");
+                        }
+                }
+            }
+        });
+    });
+
+    // Threads copy and drop handles of the same payloads, the last one
+    // to drop a payload frees it.
+    runner.run("shared/handles", [](uint64_t seed) {
+        constexpr size_t threads = 4;
+        constexpr size_t count   = 16;
+
+        std::vector<ec::Shared<std::string>> values;
+        std::vector<ec::SharedBuffer> buffers;
+        for (size_t i = 0; i < count; ++i) {
+            values.push_back(ec::Shared<std::string>::make(100, char('a' + i)));
+            buffers.push_back(
+                ec::SharedBuffer::copy(std::string(3000, 'a' + i)));
+        }
+
+        parallel(threads, [&](size_t index) {
+            Random random(seed + index);
+            std::vector<ec::Shared<std::string>> own_values(count);
+            std::vector<ec::SharedBuffer> own_buffers(count);
+
+            for (size_t i = 0; i < 2000; ++i) {
+                size_t slot = random() % count;
+                switch (random() % 3) {
+                    case 0:
+                        own_values[slot]  = values[slot];
+                        own_buffers[slot] = buffers[slot];
+                        break;
+                    case 1:
+                        own_values[slot].reset();
+                        own_buffers[slot] = ec::SharedBuffer();
+                        break;
+                    default:
+                        if (own_values[slot])
+                            check((*own_values[slot])[99] == char('a' + slot),
+                                  "shared value changed");
+                        if (!own_buffers[slot].empty())
+                            check(own_buffers[slot].view()[2999] ==
+                                      char('a' + slot),
+                                  "shared buffer changed");
+                }
+            }
+        });
+
+        for (size_t i = 0; i < count; ++i) {
+            check(values[i].useCount() == 1, "value handles leaked");
+            check(buffers[i].useCount() == 1, "buffer handles leaked");
+        }
+    });
+
+    runner.run("concurrent_map/ops", [](uint64_t seed) {
+        constexpr size_t writers  = 3;
+        constexpr uint64_t range  = 512;
+
+        ec::ConcurrentMap<uint64_t, uint64_t> map(4);
+        std::atomic<size_t> finished{0};
+
+        parallel(writers + 1, [&](size_t index) {
+            Random random(seed + index);
+
+            if (index == writers) {
+                uint64_t value;
+                while (finished.load() < writers) {
+                    uint64_t key = random() % (range * writers);
+                    if (map.find(key, &value))
+                        check(value == key * 3, "find() returned a torn value");
+                }
+                return;
+            }
+
+            std::vector<bool> present(range, false);
+            for (size_t i = 0; i < 3000; ++i) {
+                uint64_t slot = random() % range;
+                uint64_t key  = index * range + slot;
+
+                if (random() % 2 == 0) {
+                    check(map.insert(key, key * 3) != present[slot],
+                          "insert() disagrees with the owner");
+                    present[slot] = true;
+                } else {
+                    check(map.erase(key) == present[slot],
+                          "erase() disagrees with the owner");
+                    present[slot] = false;
+                }
+            }
+            ++finished;
+        });
+    });
+
+    // Readers fill a small cache while a writer subscribes wildcard
+    // patterns, every match of the writer must agree with the patterns.
+    runner.run("topic_router/invalidate", [](uint64_t seed) {
+        constexpr size_t readers = 2;
+        constexpr size_t lists   = 8;
+
+        using Router = ec::TopicRouter<uint64_t>;
+        Router router(16);
+        std::vector<ec::HandlerList<uint64_t>> handlers(lists);
+        std::atomic<bool> finished{false};
+
+        auto make = [](Random& random, bool pattern) {
+            static const char* levels[] = {"a", "b", "c", "*", "#"};
+            std::string result;
+            size_t depth = 1 + random() % 3;
+            for (size_t i = 0; i < depth; ++i) {
+                if (i > 0) result += '.';
+                size_t level = random() % (pattern ? 5 : 3);
+                if (level == 4 && i + 1 < depth) level = 3;
+                result += levels[level];
+            }
+            return result;
+        };
+
+        // Level by level, '#' last
+        auto matches = [](const std::string& pattern,
+                          const std::string& topic) {
+            size_t i = 0, j = 0;
+            while (true) {
+                size_t end = pattern.find('.', i);
+                std::string level = pattern.substr(i, end - i);
+                if (level == "#") return true;
+                if (j == std::string::npos) return false;
+
+                size_t topic_end = topic.find('.', j);
+                if (level != "*" && level != topic.substr(j, topic_end - j))
+                    return false;
+                if (end == std::string::npos)
+                    return topic_end == std::string::npos;
+                i = end + 1;
+                j = topic_end == std::string::npos ? topic_end : topic_end + 1;
+            }
+        };
+
+        parallel(readers + 1, [&](size_t index) {
+            Random random(seed + index);
+
+            if (index < readers) {
+                while (!finished.load()) router.match(make(random, false));
+                return;
+            }
+
+            // Also releases the readers when a check throws
+            struct Finish {
+                std::atomic<bool>& flag;
+                ~Finish() { flag = true; }
+            } finish{finished};
+
+            struct Live {
+                Router::Position position;
+                std::string pattern;
+                ec::HandlerList<uint64_t>* handler;
+            };
+            std::vector<Live> live;
+
+            for (size_t i = 0; i < 2000; ++i) {
+                if (live.empty() || random() % 2 == 0) {
+                    auto handler = &handlers[random() % lists];
+                    std::string pattern = make(random, true);
+                    live.push_back(
+                        {router.subscribe(pattern, handler), pattern, handler});
+                } else {
+                    size_t position = random() % live.size();
+                    check(router.unsubscribe(live[position].position) ==
+                              live[position].handler,
+                          "unsubscribe() returned a foreign list");
+                    live[position] = live.back();
+                    live.pop_back();
+                }
+
+                std::string topic = make(random, false);
+                Router::Subscribers expected;
+                for (auto& el : live)
+                    if (matches(el.pattern, topic))
+                        expected.push_back(el.handler);
+                std::sort(expected.begin(), expected.end());
+                expected.erase(std::unique(expected.begin(), expected.end()),
+                               expected.end());
+
+                check(*router.match(topic) == expected,
+                      "match() returned a stale subscriber set");
+            }
+        });
+    });
+}
+
+}  // namespace stress
@@ -0,0 +1,1612 @@
+#include "stress.hpp"
+
+#include <TMBEL.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <csignal>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace stress {
+
+namespace {
+
+constexpr uint64_t alive_tag = 0x5eed5eed5eed5eedULL;
+
+class CountHandler : public ec::Handler<uint64_t> {
+ public:
+    uint64_t tag = alive_tag;
+    std::atomic<uint64_t> calls{0};
+
+    ~CountHandler() override {
+        detach();
+        tag = 0;
+    }
+
+    void call(const uint64_t&) override {
+        check(tag == alive_tag, "destroyed handler called");
+        calls.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+// Changes the list it is called from: detaches itself or a peer, or
+// attaches them back at the end. Only touched under the list lock.
+class ChurnHandler : public ec::Handler<uint64_t> {
+ public:
+    ec::HandlerList<uint64_t>* list;
+    std::vector<ChurnHandler*>* peers;
+    Random random;
+
+    ChurnHandler(ec::HandlerList<uint64_t>* list,
+                 std::vector<ChurnHandler*>* peers, uint64_t seed)
+        : list(list), peers(peers), random(seed) {}
+
+    void call(const uint64_t&) override {
+        ChurnHandler* peer = (*peers)[random() % peers->size()];
+
+        switch (random() % 5) {
+            case 0:
+                detach();
+                break;
+            case 1:
+                list->attach(this);
+                break;
+            case 2:
+                peer->detach();
+                break;
+            case 3:
+                if (!peer->isAttached()) list->attach(peer);
+                break;
+            default:
+                break;
+        }
+    }
+};
+
+// Counts calls and every 16th event replaces itself with a copy through
+// setFunction() of the handler running it.
+struct SelfReplacing {
+    ec::FuncHandlerBase<uint64_t>* handler;
+    std::atomic<uint64_t>* calls;
+    std::atomic<uint64_t>* replaced;
+
+    void operator()(const uint64_t& data) const {
+        calls->fetch_add(1, std::memory_order_relaxed);
+        if (data % 16 != 0) return;
+
+        replaced->fetch_add(1, std::memory_order_relaxed);
+        handler->setFunction(SelfReplacing(*this));
+    }
+};
+
+// Counts calls and calls the handler running it again with data - 1.
+struct Reentering {
+    ec::Handler<uint64_t>* handler;
+    std::atomic<uint64_t>* calls;
+
+    void operator()(const uint64_t& data) const {
+        calls->fetch_add(1, std::memory_order_relaxed);
+        if (data > 0) handler->call(data - 1);
+    }
+};
+
+// Sends even events to group 0 and odd ones to group 1.
+class ParityParser : public ec::ParserBase<uint64_t> {
+ public:
+    ParityParser() : ParserBase(2) {}
+
+    void call(const uint64_t& data) override {
+        resource_[data % 2].call(data);
+    }
+};
+
+// Payload that checks its contents and counts live instances.
+class Tracked {
+ public:
+    static inline std::atomic<int64_t> live{0};
+
+    std::vector<uint64_t> values;
+
+    Tracked(uint64_t value, size_t size) : values(size, value) { ++live; }
+    Tracked(const Tracked& other) : values(other.values) { ++live; }
+    ~Tracked() { --live; }
+
+    bool intact() const {
+        for (auto el : values)
+            if (el != values.front()) return false;
+        return true;
+    }
+};
+
+class Controller : public ec::ControllerBase<uint64_t> {
+ public:
+    void process() override {}
+
+    void attach(ec::Handler<uint64_t>* handler) {
+        handler_list_.attach(handler);
+    }
+};
+
+// Runs dispatchers against a mutator that attaches, detaches and replaces
+// handlers, destroying the replaced ones right away. With callConcurrent()
+// the destructor's detach has to wait for dispatches still calling them.
+void dispatchRound(uint64_t seed, bool concurrent) {
+    constexpr size_t dispatchers   = 2;
+    constexpr uint64_t dispatches  = 2000;
+    constexpr size_t handler_count = 8;
+
+    ec::HandlerList<uint64_t> list;
+    CountHandler pinned;
+    list.attach(&pinned);
+
+    std::vector<std::unique_ptr<CountHandler>> handlers;
+    for (size_t i = 0; i < handler_count; ++i)
+        handlers.push_back(std::make_unique<CountHandler>());
+
+    std::vector<ChurnHandler*> peers;
+    std::vector<std::unique_ptr<ChurnHandler>> churn;
+    if (!concurrent)
+        for (size_t i = 0; i < 4; ++i) {
+            churn.push_back(
+                std::make_unique<ChurnHandler>(&list, &peers, seed + i));
+            peers.push_back(churn.back().get());
+            list.attach(peers.back());
+        }
+
+    std::atomic<size_t> finished{0};
+    parallel(dispatchers + 1, [&](size_t index) {
+        if (index < dispatchers) {
+            for (uint64_t i = 0; i < dispatches; ++i) {
+                if (concurrent)
+                    list.callConcurrent(i);
+                else
+                    list.call(i);
+            }
+            ++finished;
+            return;
+        }
+
+        Random random(seed);
+        while (finished.load() < dispatchers) {
+            auto& handler = handlers[random() % handler_count];
+            switch (random() % 4) {
+                case 0:
+                    if (!handler->isAttached()) list.attach(handler.get());
+                    break;
+                case 1:
+                    handler->detach();
+                    break;
+                case 2:
+                    handler = std::make_unique<CountHandler>();
+                    if (random() % 2 == 0) list.attach(handler.get());
+                    break;
+                default:
+                    std::this_thread::yield();
+                    break;
+            }
+        }
+    });
+
+    check(pinned.calls.load() == dispatchers * dispatches,
+          "attached handler missed events");
+}
+
+#ifdef __linux__
+// Waits up to five seconds for handler to reach calls.
+bool waitCalls(const CountHandler& handler, uint64_t calls) {
+    auto until = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (handler.calls.load() < calls &&
+           std::chrono::steady_clock::now() < until)
+        std::this_thread::yield();
+    return handler.calls.load() == calls;
+}
+
+// Reader of descriptors carrying whole uint64_t values.
+void readValues(int fd, uint32_t, std::vector<uint64_t>* batch) {
+    uint64_t value;
+    while (read(fd, &value, sizeof(value)) == sizeof(value))
+        batch->push_back(value);
+}
+
+void writeValue(int fd, uint64_t value) {
+    while (write(fd, &value, sizeof(value)) != sizeof(value))
+        std::this_thread::yield();
+}
+#endif
+
+}  // namespace
+
+void handlerCases(Runner& runner) {
+    runner.run("handler_list/detach_during_call",
+               [](uint64_t seed) { dispatchRound(seed, false); });
+
+    runner.run("handler_list/detach_during_call_concurrent",
+               [](uint64_t seed) { dispatchRound(seed, true); });
+
+    // Async tasks keep the shared payload after the dispatch returned and
+    // the dispatcher dropped its handle.
+    runner.run("handler_list/async_shared", [](uint64_t seed) {
+        constexpr size_t handler_count = 4;
+        constexpr uint64_t events      = 40;
+        using Payload = ec::Shared<Tracked>;
+
+        std::atomic<uint64_t> calls{0};
+        std::atomic<bool> intact{true};
+        {
+            ec::HandlerList<Payload> list;
+            std::vector<std::unique_ptr<ec::AsyncFuncHandler<Payload>>> handlers;
+            for (size_t i = 0; i < handler_count; ++i) {
+                handlers.push_back(
+                    std::make_unique<ec::AsyncFuncHandler<Payload>>(
+                        [&](const Payload& data) {
+                            std::this_thread::yield();
+                            if (!data->intact()) intact = false;
+                            ++calls;
+                        },
+                        ec::MutexList::getInstance()->getMutex(
+                            ec::MutexType::Shared)));
+                list.attach(handlers.back().get());
+            }
+
+            Random random(seed);
+            for (uint64_t i = 0; i < events; ++i)
+                list.call(Payload::make(random(), 64));
+        }
+
+        check(intact.load(), "async task saw a released payload");
+        check(calls.load() == handler_count * events, "async calls lost");
+        check(Tracked::live.load() == 0, "payload leaked");
+    });
+
+    // Functions replace themselves while they run, on the dispatching
+    // threads and in async tasks. This must neither deadlock nor lose calls.
+    runner.run("handler_list/set_function_reentrant", [](uint64_t) {
+        constexpr size_t dispatchers  = 2;
+        constexpr uint64_t dispatches = 1600;
+
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> replaced{0};
+        {
+            ec::SyncFuncHandler<uint64_t> sync;
+            ec::AsyncFuncHandler<uint64_t> async(
+                ec::MutexList::getInstance()->getMutex(ec::MutexType::Shared));
+            sync.setMutex(ec::MutexList::getInstance()->getMutex(
+                ec::MutexType::Shared));
+            sync.setAccess(ec::MutexAccess::Read);
+            sync.setFunction(SelfReplacing{&sync, &calls, &replaced});
+            async.setFunction(SelfReplacing{&async, &calls, &replaced});
+
+            ec::HandlerList<uint64_t> list;
+            list.attach(&sync);
+            list.attach(&async);
+
+            parallel(dispatchers, [&](size_t) {
+                for (uint64_t i = 0; i < dispatches; ++i)
+                    list.callConcurrent(i);
+            });
+        }
+
+        check(calls.load() == 2 * dispatchers * dispatches,
+              "calls lost while replacing functions");
+        check(replaced.load() == 2 * dispatchers * dispatches / 16,
+              "replaced functions not called");
+    });
+
+    // Handlers contend for a named group, the profile reports the group
+    // and its waiters by name. Without profiling there is no profile.
+    runner.run("mutex/profile_names", [](uint64_t) {
+        constexpr size_t threads = 3;
+
+        ec::Mutex group =
+            ec::MutexList::getInstance()->getMutex(ec::MutexType::Adaptive);
+        group.setName("profile_names");
+
+        std::vector<std::unique_ptr<ec::SyncFuncHandler<uint64_t>>> handlers;
+        for (size_t i = 0; i < threads; ++i) {
+            handlers.push_back(std::make_unique<ec::SyncFuncHandler<uint64_t>>(
+                [](const uint64_t&) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }));
+            handlers.back()->setMutex(group);
+            handlers.back()->setName("waiter_" + std::to_string(i));
+        }
+        check(handlers.front()->getName() == "waiter_0",
+              "getName() lost the handler name");
+
+        parallel(threads, [&](size_t index) {
+            for (uint64_t i = 0; i < 50; ++i) handlers[index]->call(i);
+        });
+
+        auto profile = ec::MutexList::getInstance()->getProfile(threads);
+        if (!ec::lock_profiling_enabled) {
+            check(profile.empty(), "profile without lock profiling");
+            return;
+        }
+
+        auto position =
+            std::find_if(profile.begin(), profile.end(), [](const auto& el) {
+                return el.name == "profile_names";
+            });
+        check(position != profile.end(), "named group missing in profile");
+        check(!position->top_waiters.empty(), "no contended waits recorded");
+        for (auto& el : position->top_waiters)
+            check(el.name.rfind("waiter_", 0) == 0,
+                  "waiter reported without its handler name");
+
+        // Renaming races with threads reading the profile.
+        parallel(2, [&](size_t index) {
+            for (uint64_t i = 0; i < 200; ++i) {
+                if (index == 0) {
+                    group.setName("profile_names_" + std::to_string(i));
+                    continue;
+                }
+                for (auto& el :
+                     ec::MutexList::getInstance()->getProfile(threads))
+                    if (el.group == position->group)
+                        check(el.name.rfind("profile_names", 0) == 0,
+                              "torn group name");
+            }
+        });
+    });
+
+    // Functions call their own handler again while another thread keeps
+    // replacing them, re-entry must not lock the handler twice.
+    runner.run("handler_list/reenter_during_set_function", [](uint64_t) {
+        constexpr uint64_t calls_per_round = 300;
+        constexpr uint64_t depth           = 3;
+
+        std::atomic<uint64_t> calls{0};
+        {
+            ec::SyncFuncHandler<uint64_t> sync;
+            ec::AsyncFuncHandler<uint64_t> async(
+                ec::MutexList::getInstance()->getMutex());
+            sync.setFunction(Reentering{&sync, &calls});
+            async.setFunction(Reentering{&async, &calls});
+
+            std::atomic<bool> finished{false};
+            parallel(2, [&](size_t index) {
+                if (index == 1) {
+                    while (!finished.load()) {
+                        sync.setFunction(Reentering{&sync, &calls});
+                        async.setFunction(Reentering{&async, &calls});
+                    }
+                    return;
+                }
+
+                for (uint64_t i = 0; i < calls_per_round; ++i) {
+                    sync.call(depth);
+                    async.call(depth);
+                }
+                finished = true;
+            });
+
+            // Async tasks start further tasks, let them finish before
+            // the handler waits for its threads.
+            while (calls.load() < 2 * calls_per_round * (depth + 1))
+                std::this_thread::yield();
+        }
+
+        check(calls.load() == 2 * calls_per_round * (depth + 1),
+              "re-entrant calls lost");
+    });
+
+    // Handlers behind processors are traced like the ones of a list, the
+    // Chrome trace holds one begin and end per call.
+    runner.run("tracing/processor_chain", [](uint64_t) {
+        constexpr uint64_t events = 50;
+
+        auto count = [](const std::string& text, const std::string& what) {
+            size_t result = 0;
+            for (size_t i = text.find(what); i != std::string::npos;
+                 i = text.find(what, i + 1))
+                ++result;
+            return result;
+        };
+
+        ec::Processor<uint64_t, uint64_t> doubler(
+            [](const uint64_t& data) { return data * 2; });
+        ec::Processor<uint64_t, uint64_t> increment(
+            [](const uint64_t& data) { return data + 1; });
+        CountHandler sink;
+        doubler.setName("trace_double");
+        increment.setName("trace_increment");
+        sink.setName("trace_sink");
+
+        ec::HandlerList<uint64_t> list;
+        list.attach(&doubler);
+        doubler.attach(&increment);
+        increment.attach(&sink);
+
+        auto tracer = ec::Tracer::getInstance();
+        tracer->clear();
+        tracer->start();
+        for (uint64_t i = 0; i < events; ++i) {
+            ec::Tracer::setCurrent(ec::Tracer::newEvent());
+            list.call(i);
+        }
+        ec::Tracer::setCurrent(0);
+        tracer->stop();
+
+        std::ostringstream stream;
+        tracer->writeChromeTrace(stream);
+        std::string trace = stream.str();
+
+        check(sink.calls.load() == events, "chain events lost");
+        check(trace.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0) ==
+                      0 &&
+                  trace.size() >= 4 &&
+                  trace.compare(trace.size() - 4, 4, "\n]}\n") == 0,
+              "trace is not a Chrome trace document");
+        for (auto name : {"trace_double", "trace_increment", "trace_sink"})
+            check(count(trace, std::string("\"name\":\"") + name + "\"") ==
+                      events,
+                  std::string("calls of ") + name + " not traced");
+        check(count(trace, "\"ph\":\"B\"") == 3 * events &&
+                  count(trace, "\"ph\":\"E\"") == 3 * events,
+              "unbalanced handler records");
+    });
+
+    // Handlers record into the registry from several threads with every
+    // call timed, counts and quantiles add up and are exported as
+    // Prometheus text. Metrics outlive their handlers, so every round
+    // uses fresh names.
+    runner.run("metrics/handlers", [](uint64_t) {
+        constexpr size_t threads    = 3;
+        constexpr uint64_t per_call = 400;
+        static std::atomic<uint64_t> round{0};
+
+        std::string suffix = std::to_string(round++);
+        std::string first  = "metrics_first_" + suffix;
+        std::string second = "metrics_second_" + suffix;
+        std::string queue  = "metrics_queue_" + suffix;
+
+        CountHandler one;
+        CountHandler two;
+        one.setMetrics(first);
+        two.setMetrics(second);
+        check(one.getMetrics() != nullptr && two.getMetrics() != nullptr,
+              "handlers without metrics");
+        one.getMetrics()->setSamplePeriod(1);
+        two.getMetrics()->setSamplePeriod(1);
+
+        ec::HandlerList<uint64_t> list;
+        list.attach(&one);
+        list.attach(&two);
+        parallel(threads, [&](size_t) {
+            for (uint64_t i = 0; i < per_call; ++i) list.call(i);
+        });
+        // Direct calls bypass the list and are not counted.
+        one.call(0);
+
+        auto registry = ec::MetricsRegistry::getInstance();
+        auto position = registry->watchQueue(queue, [] {
+            ec::QueueCounters counters;
+            counters.depth    = 3;
+            counters.enqueued = 10;
+            counters.dequeued = 7;
+            return counters;
+        });
+        ec::MetricsSnapshot snapshot = registry->snapshot();
+        std::ostringstream stream;
+        registry->writeText(stream);
+        registry->unwatchQueue(position);
+        std::string text = stream.str();
+
+        constexpr uint64_t events = threads * per_call;
+        for (auto& name : {first, second}) {
+            auto metrics = std::find_if(
+                snapshot.handlers.begin(), snapshot.handlers.end(),
+                [&](const auto& el) { return el.name == name; });
+            check(metrics != snapshot.handlers.end(), name + " not in snapshot");
+            check(metrics->calls == events, name + " lost calls");
+            check(metrics->timed == events, name + " did not time every call");
+            check(metrics->p50 <= metrics->p90 && metrics->p90 <= metrics->p99 &&
+                      metrics->p99 <= metrics->p999 &&
+                      metrics->p999 <= metrics->max,
+                  name + " quantiles out of order");
+
+            std::string label = "{handler=\"" + name + "\"";
+            check(text.find("tmbel_handler_calls_total" + label + "} " +
+                            std::to_string(events) + "\n") !=
+                      std::string::npos,
+                  name + " call counter not exported");
+            check(text.find("tmbel_handler_latency_seconds_count" + label +
+                            "} " + std::to_string(events) + "\n") !=
+                      std::string::npos,
+                  name + " summary count not exported");
+            for (auto quantile : {"0.5", "0.9", "0.99", "0.999"})
+                check(text.find("tmbel_handler_latency_seconds" + label +
+                                ",quantile=\"" + quantile + "\"} ") !=
+                          std::string::npos,
+                      name + " quantile " + quantile + " not exported");
+            check(text.find("tmbel_handler_latency_max_seconds" + label +
+                            "} ") != std::string::npos,
+                  name + " max latency not exported");
+        }
+
+        for (auto type : {"# TYPE tmbel_handler_calls_total counter\n",
+                          "# TYPE tmbel_handler_latency_seconds summary\n",
+                          "# TYPE tmbel_handler_latency_max_seconds gauge\n",
+                          "# TYPE tmbel_queue_depth gauge\n"})
+            check(text.find(type) != std::string::npos,
+                  std::string("missing ") + type);
+        check(text.find("tmbel_queue_depth{queue=\"" + queue + "\"} 3\n") !=
+                      std::string::npos &&
+                  text.find("tmbel_queue_enqueued_total{queue=\"" + queue +
+                            "\"} 10\n") != std::string::npos,
+              "queue counters not exported");
+        check(text.back() == '\n', "exposition not terminated by a newline");
+
+        one.clearMetrics();
+        two.clearMetrics();
+    });
+
+    // Events larger than the inline task buffer are copied into a Shared
+    // block, every task has to see its event intact.
+    runner.run("handler_list/async_large", [](uint64_t seed) {
+        constexpr uint64_t events = 200;
+
+        struct Large {
+            uint64_t values[16];
+        };
+
+        std::atomic<uint64_t> calls{0};
+        std::atomic<bool> intact{true};
+        {
+            ec::AsyncFuncHandler<Large> handler(
+                [&](const Large& data) {
+                    for (auto el : data.values)
+                        if (el != data.values[0]) intact = false;
+                    ++calls;
+                },
+                ec::MutexList::getInstance()->getMutex(
+                    ec::MutexType::Shared));
+            ec::HandlerList<Large> list;
+            list.attach(&handler);
+
+            Random random(seed);
+            for (uint64_t i = 0; i < events; ++i) {
+                Large data;
+                std::fill(std::begin(data.values), std::end(data.values),
+                          random());
+                list.call(data);
+            }
+        }
+
+        check(intact.load(), "large event copied wrong");
+        check(calls.load() == events, "async calls lost");
+    });
+
+    runner.run("controller/parallel", [](uint64_t seed) {
+        constexpr size_t producers     = 2;
+        constexpr uint64_t per_producer = 3000;
+
+        std::vector<std::atomic<uint8_t>> seen(producers * per_producer);
+        for (auto& el : seen) el = 0;
+
+        ec::SyncFuncHandler<uint64_t> handler(
+            [&seen](const uint64_t& data) { ++seen[data]; });
+        handler.setMutex(ec::MutexList::getInstance()->getMutex(
+            ec::MutexType::Shared));
+        handler.setAccess(ec::MutexAccess::Read);
+
+        Controller controller;
+        controller.attach(&handler);
+        controller.setPolicy(ec::DispatchPolicy::Parallel);
+        controller.start(3);
+
+        parallel(producers, [&](size_t index) {
+            Random random(seed + index);
+            for (uint64_t i = 0; i < per_producer; ++i) {
+                controller.push(index * per_producer + i);
+                if (random() % 128 == 0) std::this_thread::yield();
+            }
+        });
+        controller.stop();
+
+        for (auto& el : seen) check(el == 1, "event lost or dispatched twice");
+    });
+
+    // Every producer owns its keys, so the events of a key must arrive in
+    // push order while partitions are rebalanced between lanes.
+    runner.run("controller/partitioned", [](uint64_t seed) {
+        constexpr size_t producers     = 3;
+        constexpr uint64_t keys        = 8;
+        constexpr uint64_t per_producer = 3000;
+
+        std::vector<std::atomic<uint64_t>> last(producers * keys);
+        for (auto& el : last) el = 0;
+        std::atomic<uint64_t> received{0};
+        std::atomic<bool> ordered{true};
+
+        ec::SyncFuncHandler<uint64_t> handler([&](const uint64_t& data) {
+            uint64_t key      = data & 0xff;
+            uint64_t sequence = data >> 8;
+            if (last[key].exchange(sequence, std::memory_order_relaxed) >=
+                sequence)
+                ordered = false;
+            ++received;
+        });
+        handler.setMutex(ec::MutexList::getInstance()->getMutex(
+            ec::MutexType::Shared));
+        handler.setAccess(ec::MutexAccess::Read);
+
+        Controller controller;
+        controller.attach(&handler);
+        controller.setPartitioner(
+            [](const uint64_t& data) { return data & 0xff; }, 16);
+        controller.setPolicy(ec::DispatchPolicy::Partitioned);
+        controller.start(3);
+
+        std::atomic<size_t> finished{0};
+        parallel(producers + 1, [&](size_t index) {
+            if (index == producers) {
+                while (finished.load() < producers) {
+                    controller.rebalance();
+                    std::this_thread::yield();
+                }
+                return;
+            }
+
+            Random random(seed + index);
+            for (uint64_t i = 1; i <= per_producer; ++i) {
+                uint64_t key = index * keys + random() % keys;
+                controller.push(i << 8 | key);
+            }
+            ++finished;
+        });
+        controller.stop();
+
+        check(received.load() == producers * per_producer,
+              "partitioned events lost");
+        check(ordered.load(), "events of a key reordered");
+    });
+
+    // Handlers push follow-up events while stop() drains or abandons the
+    // lanes. Those land in the controller queue, nothing may be lost.
+    runner.run("controller/partitioned_stop", [](uint64_t seed) {
+        constexpr uint64_t events = 2000;
+        constexpr uint64_t hops   = 3;
+
+        Controller controller;
+        std::atomic<uint64_t> received{0};
+        std::atomic<uint64_t> pushed{events};
+
+        ec::SyncFuncHandler<uint64_t> handler([&](const uint64_t& data) {
+            ++received;
+            if ((data & 0xf) == 0) return;
+
+            ++pushed;
+            controller.push(data - 1);
+        });
+        handler.setMutex(ec::MutexList::getInstance()->getMutex(
+            ec::MutexType::Shared));
+        handler.setAccess(ec::MutexAccess::Read);
+
+        bool rejected = false;
+        try {
+            controller.setPolicy(ec::DispatchPolicy::Partitioned);
+        } catch (const std::logic_error&) {
+            rejected = true;
+        }
+        check(rejected, "partitioned policy without a partitioner");
+
+        controller.attach(&handler);
+        controller.setPartitioner(
+            [](const uint64_t& data) { return data >> 4; }, 16);
+        controller.setPolicy(ec::DispatchPolicy::Partitioned);
+        controller.start(2);
+
+        size_t refused = 0;
+        try {
+            controller.setPolicy(ec::DispatchPolicy::Parallel);
+        } catch (const std::logic_error&) {
+            ++refused;
+        }
+        try {
+            controller.setPartitioner([](const uint64_t& data) { return data; });
+        } catch (const std::logic_error&) {
+            ++refused;
+        }
+        check(refused == 2, "dispatch changed while running");
+        check(controller.getPolicy() == ec::DispatchPolicy::Partitioned,
+              "policy lost while running");
+
+        Random random(seed);
+        for (uint64_t i = 0; i < events; ++i) controller.push(i << 4 | hops);
+        controller.stop(random() % 2 == 0);
+
+        check(received.load() + controller.getEventQueue()->size() ==
+                  pushed.load(),
+              "events lost while stopping");
+    });
+
+    // Lanes take the expired policy and delay statistics of the controller
+    // queue, also for events queued before start().
+    runner.run("controller/partitioned_expired", [](uint64_t seed) {
+        constexpr uint64_t events = 2000;
+        using Clock = std::chrono::steady_clock;
+
+        std::atomic<uint64_t> live{0};
+        std::atomic<uint64_t> dead{0};
+        std::atomic<bool> expired_called{false};
+
+        ec::SyncFuncHandler<uint64_t> handler([&](const uint64_t& data) {
+            if (data & 1) expired_called = true;
+            ++live;
+        });
+        handler.setMutex(ec::MutexList::getInstance()->getMutex(
+            ec::MutexType::Shared));
+        handler.setAccess(ec::MutexAccess::Read);
+        ec::SyncFuncHandler<uint64_t> dead_letter(
+            [&](const uint64_t&) { ++dead; });
+        ec::HandlerList<uint64_t> dead_list;
+        dead_list.attach(&dead_letter);
+
+        Controller controller;
+        controller.attach(&handler);
+        controller.setDeadLetter(&dead_list);
+        controller.getEventQueue()->setDelayStats(true);
+        controller.setPartitioner(
+            [](const uint64_t& data) { return data >> 1; }, 16);
+        controller.setPolicy(ec::DispatchPolicy::Partitioned);
+
+        Random random(seed);
+        uint64_t expired = 0;
+        auto push = [&](uint64_t i) {
+            if (random() % 2 == 0)
+                return controller.push(i << 1, Clock::time_point::max());
+            ++expired;
+            controller.push(i << 1 | 1, Clock::now() - std::chrono::seconds(1));
+        };
+
+        for (uint64_t i = 0; i < events / 2; ++i) push(i);
+        controller.start(2);
+        for (uint64_t i = events / 2; i < events; ++i) push(i);
+        controller.stop();
+
+        ec::QueueDelayStats stats = controller.getDelayStats();
+        check(!expired_called.load(), "expired event dispatched");
+        check(dead.load() == expired, "expired event not diverted");
+        check(live.load() == events - expired, "live event lost");
+        check(stats.diverted == expired, "diverted events not counted");
+        check(stats.count == events - expired, "lane delays not merged");
+    });
+
+    // Dispatchers record through the async writer with a small buffer,
+    // so buffers change hands often. Every event has to be in the file
+    // once and two replays have to dispatch the same sequence.
+    runner.run("recorder/replay", [](uint64_t seed) {
+        constexpr size_t dispatchers  = 3;
+        constexpr uint64_t per_thread = 2000;
+
+        std::string path = (std::filesystem::temp_directory_path() /
+                            ("tmbel_stress_" + std::to_string(seed) + ".rec"))
+                               .string();
+        {
+            ec::HandlerList<uint64_t> list;
+            ec::RecordHandler<uint64_t> recorder(path, true, 256);
+            list.attach(&recorder);
+
+            parallel(dispatchers, [&](size_t index) {
+                Random random(seed + index);
+                for (uint64_t i = 0; i < per_thread; ++i) {
+                    list.call(index * per_thread + i);
+                    if (random() % 256 == 0) std::this_thread::yield();
+                }
+            });
+            check(recorder.getRecorder()->count() == dispatchers * per_thread,
+                  "records lost");
+        }
+
+        ec::Replayer<uint64_t> replayer(path);
+        std::remove(path.c_str());
+
+        std::vector<uint8_t> seen(dispatchers * per_thread, 0);
+        for (uint64_t el : replayer.getEvents())
+            if (el < seen.size()) ++seen[el];
+        check(replayer.size() == seen.size(), "recorded events lost");
+        for (uint8_t el : seen) check(el == 1, "event recorded wrong");
+
+        std::vector<uint64_t> runs[2];
+        for (auto& run : runs) {
+            ec::SyncFuncHandler<uint64_t> handler(
+                [&run](const uint64_t& data) { run.push_back(data); });
+            handler.setMutex(ec::MutexList::getInstance()->getMutex());
+
+            Controller controller;
+            controller.attach(&handler);
+            replayer.replay(&controller, ec::ReplayMode::Throughput);
+        }
+        check(runs[0] == replayer.getEvents() && runs[1] == runs[0],
+              "replays differ");
+    });
+
+#ifdef __linux__
+    // Writes beyond the file size limit fail. close(), or the destructor
+    // alone, has to stop the writer and report the error, the child is
+    // killed if it hangs.
+    runner.run("recorder/write_error", [](uint64_t seed) {
+        std::string path = (std::filesystem::temp_directory_path() /
+                            ("tmbel_stress_" + std::to_string(seed) + ".rec"))
+                               .string();
+        bool async = seed % 2 == 0;
+        bool close = seed % 4 < 2;
+
+        pid_t child = fork();
+        check(child >= 0, "fork() failed");
+        if (child == 0) {
+            alarm(10);
+            signal(SIGXFSZ, SIG_IGN);
+            rlimit limit{4096, 4096};
+            setrlimit(RLIMIT_FSIZE, &limit);
+
+            bool failed = false;
+            {
+                ec::EventRecorder recorder(path, async, 256);
+                std::string record(100, 'r');
+                try {
+                    for (int i = 0; i < 200; ++i) recorder.record(record);
+                    if (close) recorder.close();
+                } catch (const std::system_error&) {
+                    failed = true;
+                }
+            }
+            _exit(failed || !close ? 0 : 1);
+        }
+
+        int status = 0;
+        waitpid(child, &status, 0);
+        std::remove(path.c_str());
+        check(WIFEXITED(status) && WEXITSTATUS(status) == 0,
+              "write error lost or close() hung");
+    });
+
+    // Events come from a pipe, a datagram socket and push() from another
+    // thread, all dispatched by the reactor loop. An unwatched descriptor
+    // stays quiet.
+    runner.run("reactor/dispatch", [](uint64_t seed) {
+        constexpr uint64_t events = 300;
+
+        int pipe_fds[2];
+        int sockets[2];
+        check(pipe2(pipe_fds, O_NONBLOCK | O_CLOEXEC) == 0, "pipe2() failed");
+        check(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                         0, sockets) == 0,
+              "socketpair() failed");
+
+        {
+            Controller controller;
+            CountHandler handler;
+            controller.attach(&handler);
+            controller.watch(pipe_fds[0], EPOLLIN, readValues);
+            controller.watch(sockets[0], EPOLLIN, readValues);
+
+            std::thread loop([&controller]() { controller.runReactor(); });
+
+            Random random(seed);
+            for (uint64_t i = 0; i < events; ++i) {
+                switch (random() % 3) {
+                    case 0: writeValue(pipe_fds[1], i); break;
+                    case 1: writeValue(sockets[1], i); break;
+                    default: controller.push(i);
+                }
+                if (random() % 16 == 0) std::this_thread::yield();
+            }
+            bool dispatched = waitCalls(handler, events);
+
+            controller.unwatch(pipe_fds[0]);
+            writeValue(pipe_fds[1], events);
+            writeValue(sockets[1], events);
+            bool after_unwatch = waitCalls(handler, events + 1);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+            controller.stopReactor();
+            loop.join();
+
+            check(dispatched, "reactor events lost");
+            check(after_unwatch && handler.calls.load() == events + 1,
+                  "unwatched descriptor dispatched");
+        }
+
+        for (int el : {pipe_fds[0], pipe_fds[1], sockets[0], sockets[1]})
+            close(el);
+    });
+
+    // stopReactor() may come before the loop thread got to run, it must
+    // not be lost.
+    runner.run("reactor/stop", [](uint64_t) {
+        Controller controller;
+        for (int i = 0; i < 20; ++i) {
+            std::thread loop([&controller]() { controller.runReactor(); });
+            if (i % 2 == 0) std::this_thread::yield();
+            controller.stopReactor();
+            loop.join();
+        }
+    });
+#endif
+
+    // Events carry a key in the high half and a count of 1 in the low
+    // half, merging adds the counts. Once flushed, every event has to be
+    // counted downstream exactly once in both modes.
+    runner.run("flow/throttle_merge", [](uint64_t seed) {
+        constexpr size_t producers      = 3;
+        constexpr uint64_t keys         = 16;
+        constexpr uint64_t per_producer = 3000;
+
+        for (auto mode :
+             {ec::ThrottleMode::Leading, ec::ThrottleMode::Debounce}) {
+            std::atomic<uint64_t> counted{0};
+            ec::SyncFuncHandler<uint64_t> handler([&](const uint64_t& data) {
+                counted.fetch_add(data & 0xffffffff, std::memory_order_relaxed);
+            });
+
+            ec::Throttle<uint64_t> throttle(
+                [](const uint64_t& data) { return data >> 32; },
+                std::chrono::microseconds(20), mode, 64);
+            throttle.setMerge(
+                [](const uint64_t& pending, const uint64_t& data) {
+                    return pending + (data & 0xffffffff);
+                });
+            throttle.attach(&handler);
+
+            parallel(producers, [&](size_t index) {
+                Random random(seed + index);
+                for (uint64_t i = 0; i < per_producer; ++i) {
+                    throttle.call((random() % keys) << 32 | 1);
+                    if (random() % 64 == 0) std::this_thread::yield();
+                }
+            });
+            throttle.flush();
+
+            check(counted.load() == producers * per_producer,
+                  "throttled events lost");
+            check(throttle.getDropped() == 0, "merged events dropped");
+        }
+    });
+
+    runner.run("flow/rate_limiter", [](uint64_t seed) {
+        constexpr size_t producers      = 3;
+        constexpr uint64_t per_producer = 20000;
+        constexpr double rate           = 100000;
+        constexpr size_t burst          = 16;
+
+        ec::RateLimiter<uint64_t> limiter(rate, burst);
+        ec::HandlerList<uint64_t> overflow;
+        CountHandler passed, dropped;
+        limiter.attach(&passed);
+        overflow.attach(&dropped);
+        limiter.setOverflow(&overflow);
+
+        auto begin = std::chrono::steady_clock::now();
+        parallel(producers, [&](size_t index) {
+            Random random(seed + index);
+            for (uint64_t i = 0; i < per_producer; ++i) {
+                limiter.call(i);
+                if (random() % 256 == 0) std::this_thread::yield();
+            }
+        });
+        double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - begin)
+                             .count();
+
+        check(passed.calls + dropped.calls == producers * per_producer,
+              "limited events lost");
+        check(passed.calls == limiter.getPassed() &&
+                  dropped.calls == limiter.getDropped(),
+              "limiter counters wrong");
+        check(passed.calls <= burst + rate * seconds + 1, "rate exceeded");
+
+        for (double invalid : {0.0, -1.0, std::nan(""), HUGE_VAL}) {
+            bool rejected = false;
+            try {
+                limiter.setRate(invalid);
+            } catch (const std::invalid_argument&) {
+                rejected = true;
+            }
+            check(rejected, "invalid rate accepted");
+        }
+
+        // Intervals are clamped instead of overflowing
+        limiter.setRate(1e12, 1 << 20);
+        limiter.call(0);
+
+        ec::RateLimiter<uint64_t> slow(1e-30);
+        for (uint64_t i = 0; i < 3; ++i) slow.call(i);
+        check(slow.getPassed() == 1, "slow rate not limited");
+
+        slow.setRate(1e-30, 1 << 20);
+        for (uint64_t i = 0; i < 3; ++i) slow.call(i);
+        check(slow.getPassed() <= 3, "slow burst not limited");
+    });
+
+    // Every event is either in the flushed sample or rejected, and the
+    // sample holds distinct events.
+    runner.run("flow/reservoir", [](uint64_t seed) {
+        constexpr size_t producers      = 3;
+        constexpr uint64_t per_producer = 3000;
+        constexpr size_t size           = 32;
+
+        std::vector<uint64_t> sample;
+        ec::SyncFuncHandler<uint64_t> handler(
+            [&sample](const uint64_t& data) { sample.push_back(data); });
+        handler.setMutex(ec::MutexList::getInstance()->getMutex());
+
+        ec::ReservoirSampler<uint64_t> sampler(size);
+        sampler.attach(&handler);
+
+        parallel(producers, [&](size_t index) {
+            Random random(seed + index);
+            for (uint64_t i = 0; i < per_producer; ++i) {
+                sampler.call(index * per_producer + i);
+                if (random() % 256 == 0) std::this_thread::yield();
+            }
+        });
+        size_t flushed = sampler.flush();
+
+        std::sort(sample.begin(), sample.end());
+        check(flushed == size && sample.size() == size, "sample incomplete");
+        check(std::unique(sample.begin(), sample.end()) == sample.end(),
+              "event sampled twice");
+        check(sampler.getPassed() + sampler.getDropped() ==
+                  producers * per_producer,
+              "sampled events lost");
+    });
+
+    // Producers keep sampling while another thread flushes, every event
+    // is sent in exactly one sample or rejected.
+    runner.run("flow/reservoir_flush", [](uint64_t seed) {
+        constexpr size_t producers      = 3;
+        constexpr uint64_t per_producer = 3000;
+        constexpr size_t size           = 8;
+
+        std::vector<uint64_t> sample;
+        ec::SyncFuncHandler<uint64_t> handler(
+            [&sample](const uint64_t& data) { sample.push_back(data); });
+        handler.setMutex(ec::MutexList::getInstance()->getMutex());
+
+        ec::ReservoirSampler<uint64_t> sampler(size);
+        sampler.attach(&handler);
+
+        std::atomic<size_t> finished{0};
+        size_t flushed = 0;
+        parallel(producers + 1, [&](size_t index) {
+            Random random(seed + index);
+            if (index == producers) {
+                while (finished.load() < producers) {
+                    size_t count = sampler.flush();
+                    check(count <= size, "sample larger than the reservoir");
+                    flushed += count;
+                    std::this_thread::yield();
+                }
+                return;
+            }
+
+            for (uint64_t i = 0; i < per_producer; ++i) {
+                sampler.call(index * per_producer + i);
+                if (random() % 64 == 0) std::this_thread::yield();
+            }
+            ++finished;
+        });
+        flushed += sampler.flush();
+
+        std::sort(sample.begin(), sample.end());
+        check(sample.size() == flushed, "flushed count wrong");
+        check(std::unique(sample.begin(), sample.end()) == sample.end(),
+              "event sampled twice");
+        check(sampler.getPassed() + sampler.getDropped() ==
+                  producers * per_producer,
+              "sampled events lost");
+    });
+
+    // Random equality and range filters on two fields against a brute
+    // force check of every filter.
+    runner.run("handler_index/matches", [](uint64_t seed) {
+        constexpr size_t handler_count = 200;
+        constexpr uint64_t events      = 500;
+
+        struct Event {
+            int64_t kind;
+            int64_t value;
+        };
+
+        ec::IndexedHandlerList<Event> list;
+        size_t kind  = list.addField([](const Event& el) { return el.kind; });
+        size_t value = list.addField([](const Event& el) { return el.value; });
+
+        Random random(seed);
+        std::vector<ec::SubscriptionFilter> filters(handler_count);
+        std::vector<std::unique_ptr<ec::SyncFuncHandler<Event>>> handlers;
+        std::vector<uint64_t> calls(handler_count, 0);
+
+        for (size_t i = 0; i < handler_count; ++i) {
+            int64_t low = int64_t(random() % 100);
+            switch (random() % 4) {
+                case 0:
+                    filters[i].equal(kind, int64_t(random() % 8));
+                    break;
+                case 1:
+                    filters[i].range(value, low, low + int64_t(random() % 40));
+                    break;
+                case 2:
+                    filters[i].range(value, low, low + 10)
+                        .equal(kind, int64_t(random() % 8));
+                    break;
+                default:
+                    break;
+            }
+
+            handlers.push_back(std::make_unique<ec::SyncFuncHandler<Event>>(
+                [&calls, i](const Event&) { ++calls[i]; }));
+            list.attach(handlers.back().get(), filters[i]);
+        }
+
+        std::vector<uint64_t> expected(handler_count, 0);
+        for (uint64_t i = 0; i < events; ++i) {
+            Event event{int64_t(random() % 8), int64_t(random() % 150)};
+            int64_t values[] = {event.kind, event.value};
+            for (size_t j = 0; j < handler_count; ++j)
+                if (filters[j].matches(values)) ++expected[j];
+            list.call(event);
+        }
+
+        check(calls == expected, "indexed dispatch differs from filters");
+    });
+
+    // Dispatchers call through the index, by a HandlerList pointer, while
+    // a mutator detaches, destroys and attaches filtered handlers, which
+    // recompiles it.
+    runner.run("handler_index/attach_during_call", [](uint64_t seed) {
+        constexpr size_t dispatchers  = 2;
+        constexpr uint64_t dispatches = 3200;
+
+        ec::IndexedHandlerList<uint64_t> list;
+        size_t field = list.addField(
+            [](const uint64_t& data) { return int64_t(data % 16); });
+
+        CountHandler pinned;
+        list.attach(&pinned, ec::SubscriptionFilter().equal(field, 3));
+
+        std::vector<std::unique_ptr<CountHandler>> churn;
+        for (size_t i = 0; i < 8; ++i)
+            churn.push_back(std::make_unique<CountHandler>());
+
+        std::atomic<size_t> finished{0};
+        parallel(dispatchers + 1, [&](size_t index) {
+            Random random(seed + index);
+            if (index == dispatchers) {
+                while (finished.load() < dispatchers) {
+                    auto& slot   = churn[random() % churn.size()];
+                    auto handler = slot.get();
+                    if (handler->isAttached()) {
+                        if (random() % 2 == 0)
+                            handler->detach();
+                        else
+                            slot = std::make_unique<CountHandler>();
+                    } else {
+                        int64_t low = int64_t(random() % 16);
+                        list.attach(handler, ec::SubscriptionFilter().range(
+                                                 field, low, low + 4));
+                    }
+                    std::this_thread::yield();
+                }
+                return;
+            }
+
+            ec::HandlerList<uint64_t>* base = &list;
+            for (uint64_t i = 0; i < dispatches; ++i) base->call(i);
+            ++finished;
+        });
+
+        check(pinned.calls.load() == dispatchers * dispatches / 16,
+              "filtered handler missed events");
+    });
+
+    // A handler subscribes fresh handlers and calls the list again, the
+    // inner call compiles a new index while the outer one still reads the
+    // old. Other threads dispatch meanwhile and free replaced indexes.
+    runner.run("handler_index/recompile_during_call", [](uint64_t seed) {
+        constexpr size_t dispatchers  = 2;
+        constexpr uint64_t dispatches = 200;
+
+        ec::IndexedHandlerList<uint64_t> list;
+        size_t field = list.addField(
+            [](const uint64_t& data) { return int64_t(data % 16); });
+
+        // Attached once each, re-attaching would detach and wait for
+        // the other dispatchers.
+        std::vector<CountHandler> fresh(dispatches);
+        uint64_t next = 0;
+        ec::SyncFuncHandler<uint64_t> subscribe([&](const uint64_t& data) {
+            if (data >= 16) return;
+            list.attach(&fresh[next++],
+                        ec::SubscriptionFilter().equal(field, int64_t(data)));
+            list.call(data + 16);
+        });
+
+        CountHandler pinned;
+        list.attach(&pinned);
+
+        std::atomic<bool> finished{false};
+        parallel(dispatchers + 1, [&](size_t index) {
+            Random random(seed + index);
+            if (index == dispatchers) {
+                list.attach(&subscribe);
+                for (uint64_t i = 0; i < dispatches; ++i)
+                    list.call(random() % 16);
+                subscribe.detach();
+                finished = true;
+                return;
+            }
+            while (!finished.load()) list.call(16 + random() % 16);
+        });
+
+        uint64_t reached = 0;
+        for (auto& el : fresh) reached += el.calls.load();
+        check(next == dispatches, "subscribing handler missed events");
+        check(reached >= dispatches, "inner calls missed fresh handlers");
+    });
+
+    // A controller dispatching through an index only reaches the handlers
+    // whose filter matches.
+    runner.run("handler_index/controller", [](uint64_t seed) {
+        constexpr uint64_t events = 4000;
+
+        ec::IndexedHandlerList<uint64_t> list;
+        size_t field = list.addField(
+            [](const uint64_t& data) { return int64_t(data % 8); });
+
+        CountHandler handlers[8];
+        for (size_t i = 0; i < 8; ++i)
+            list.attach(&handlers[i], ec::SubscriptionFilter().equal(
+                                          field, int64_t(i)));
+
+        Controller controller;
+        controller.setHandlerList(&list);
+        controller.setPolicy(seed % 2 == 0 ? ec::DispatchPolicy::Parallel
+                                           : ec::DispatchPolicy::Serialized);
+        controller.start(2);
+        for (uint64_t i = 0; i < events; ++i) controller.push(i);
+        controller.stop();
+
+        for (auto& el : handlers)
+            check(el.calls.load() == events / 8,
+                  "controller bypassed the index");
+    });
+
+    // Producers fold counts of 1 into tumbling count windows of their
+    // keys, every window has to close with exactly its size.
+    runner.run("window/count_keys", [](uint64_t seed) {
+        constexpr size_t producers      = 3;
+        constexpr uint64_t keys         = 8;
+        constexpr uint64_t per_producer = 3000;
+        constexpr size_t size           = 10;
+
+        std::atomic<uint64_t> total{0};
+        std::atomic<bool> exact{true};
+        ec::SyncFuncHandler<uint64_t> handler([&](const uint64_t& sum) {
+            if (sum != size) exact = false;
+            total += sum;
+        });
+
+        ec::WindowProcessor<uint64_t, uint64_t> window(
+            size, size, [](uint64_t& sum, const uint64_t&) { ++sum; });
+        window.setKey([](const uint64_t& data) { return data; }, keys);
+        window.attach(&handler);
+
+        parallel(producers, [&](size_t index) {
+            Random random(seed + index);
+            for (uint64_t i = 0; i < per_producer; ++i)
+                window.call(random() % keys);
+        });
+
+        check(exact.load(), "count window closed with a wrong size");
+        handler.setFunction(
+            [&total](const uint64_t& sum) { total += sum; });
+        window.flush();
+        check(total.load() == producers * per_producer, "windowed events lost");
+    });
+
+    // Sliding windows of 4 events every 2 events over 1, 2, 3...
+    runner.run("window/count_sliding", [](uint64_t seed) {
+        std::vector<uint64_t> sums;
+        ec::SyncFuncHandler<uint64_t> handler(
+            [&sums](const uint64_t& sum) { sums.push_back(sum); });
+
+        ec::WindowProcessor<uint64_t, uint64_t> window(
+            4, 2, [](uint64_t& sum, const uint64_t& data) { sum += data; });
+        window.setCombine(
+            [](uint64_t& sum, const uint64_t& pane) { sum += pane; });
+        window.attach(&handler);
+
+        uint64_t events = 2 * (seed % 16 + 2);
+        for (uint64_t i = 1; i <= events; ++i) window.call(i);
+
+        check(sums.size() == events / 2, "sliding windows missing");
+        check(sums[0] == 1 + 2, "first sliding window wrong");
+        for (size_t i = 1; i < sums.size(); ++i) {
+            uint64_t last = 2 * (i + 1);
+            check(sums[i] == last + (last - 1) + (last - 2) + (last - 3),
+                  "sliding window wrong");
+        }
+    });
+
+    // Sliding windows without combine are refused before they fold an
+    // event, also by attachTimer() instead of the timer thread.
+    runner.run("window/missing_combine", [](uint64_t) {
+        using namespace std::chrono;
+        auto sum = [](uint64_t& sum, const uint64_t& data) { sum += data; };
+
+        CountHandler sliding;
+        CountHandler tumbled;
+        ec::WindowProcessor<uint64_t, uint64_t> counted(4, 2, sum);
+        ec::WindowProcessor<uint64_t, uint64_t> timed(milliseconds(4),
+                                                      milliseconds(2), sum);
+        ec::WindowProcessor<uint64_t, uint64_t> tumbling(2, 2, sum);
+        counted.attach(&sliding);
+        tumbling.attach(&tumbled);
+        Controller controller;
+
+        size_t refused = 0;
+        auto refuse    = [&refused](auto&& body) {
+            try {
+                body();
+            } catch (const std::invalid_argument&) {
+                ++refused;
+            }
+        };
+        for (uint64_t i = 1; i <= 4; ++i)
+            refuse([&] { counted.call(i); });
+        refuse([&] { counted.flush(); });
+        refuse([&] { timed.tick(); });
+        refuse([&] { timed.attachTimer(&controller); });
+        check(refused == 7, "sliding window without combine accepted");
+        check(sliding.calls.load() == 0, "window sent without combine");
+
+        for (uint64_t i = 1; i <= 4; ++i) tumbling.call(i);
+        check(tumbled.calls.load() == 2, "tumbling window needs combine");
+
+        counted.setCombine(
+            [](uint64_t& sum, const uint64_t& pane) { sum += pane; });
+        for (uint64_t i = 1; i <= 4; ++i) counted.call(i);
+        check(sliding.calls.load() == 2, "combine set after refusal ignored");
+    });
+
+    // Time windows closed by the timer of a running controller while
+    // its workers dispatch the events into them.
+    runner.run("window/controller_timer", [](uint64_t seed) {
+        constexpr uint64_t events = 2000;
+
+        std::atomic<uint64_t> total{0};
+        std::atomic<uint64_t> windows{0};
+        ec::SyncFuncHandler<uint64_t> handler([&](const uint64_t& sum) {
+            total += sum;
+            ++windows;
+        });
+
+        ec::WindowProcessor<uint64_t, uint64_t> window(
+            std::chrono::milliseconds(1), std::chrono::milliseconds(1),
+            [](uint64_t& sum, const uint64_t& data) { sum += data; });
+        window.setKey([](const uint64_t& data) { return data; }, 4);
+        window.attach(&handler);
+
+        Controller controller;
+        controller.attach(&window);
+        controller.setPolicy(ec::DispatchPolicy::Parallel);
+        window.attachTimer(&controller);
+        controller.start(2);
+
+        Random random(seed);
+        uint64_t expected = 0;
+        for (uint64_t i = 0; i < events; ++i) {
+            uint64_t data = random() % 4;
+            expected += data;
+            controller.push(data);
+            if (i % 256 == 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(3));
+        controller.stop();
+        window.detachTimer();
+        window.flush();
+
+        check(total.load() == expected, "timed window events lost");
+        check(windows.load() > 4, "timer did not close windows");
+    });
+
+    // Handlers add timers that are due earlier than the others while
+    // stop() drains the queue, waking the workers must not wait for it.
+    runner.run("controller/timer_during_stop", [](uint64_t seed) {
+        constexpr uint64_t events = 500;
+
+        Controller controller;
+        std::atomic<uint64_t> received{0};
+        ec::SyncFuncHandler<uint64_t> handler([&](const uint64_t&) {
+            size_t id = controller.addTimer(std::chrono::microseconds(50),
+                                            []() {});
+            controller.removeTimer(id);
+            ++received;
+        });
+        handler.setMutex(ec::MutexList::getInstance()->getMutex(
+            ec::MutexType::Shared));
+        handler.setAccess(ec::MutexAccess::Read);
+
+        controller.attach(&handler);
+        controller.addTimer(std::chrono::hours(1), []() {});
+        if (seed % 2 == 0)
+            controller.setPolicy(ec::DispatchPolicy::Parallel);
+        else {
+            controller.setPartitioner([](const uint64_t& data) { return data; },
+                                      8);
+            controller.setPolicy(ec::DispatchPolicy::Partitioned);
+        }
+        controller.start(2);
+
+        for (uint64_t i = 0; i < events; ++i) controller.push(i);
+        controller.stop();
+
+        check(received.load() == events, "events lost while stopping");
+    });
+
+    // Chain, fan-out into two branches joined again by a merge
+    // and an async edge into a blocking sink, pushed from several
+    // threads.
+    runner.run("flow_graph/fan_out_in", [](uint64_t seed) {
+        constexpr uint64_t producers    = 4;
+        constexpr uint64_t per_producer = 64;
+
+        std::atomic<uint64_t> merged{0};
+        std::atomic<uint64_t> slow{0};
+        CountHandler handler;
+
+        ec::FlowGraph graph;
+        auto source = graph.source<uint64_t>("source");
+        auto even   = graph.filter(source, "even", [](const uint64_t& data) {
+            return data % 2 == 0;
+        });
+        auto triple = graph.map<uint64_t>(
+            even, "triple", [](const uint64_t& data) { return data * 3; });
+        auto next = graph.map<uint64_t>(
+            source, "next", [](const uint64_t& data) { return data + 1; });
+        auto merge = graph.merge<uint64_t>("merge", {triple, next});
+        graph.sink(merge, "sum",
+                   [&merged](const uint64_t& data) { merged += data; });
+        auto text = graph.map<std::string>(
+            source, "text",
+            [](const uint64_t& data) { return std::to_string(data); });
+        auto blocking = graph.sink(text, "slow", [&slow](const std::string&) {
+            std::this_thread::sleep_for(std::chrono::microseconds(10));
+            ++slow;
+        });
+        graph.setBlocking(blocking);
+        graph.sink(source, "handler", &handler);
+        graph.build();
+
+        std::string plan = graph.dump();
+        check(plan.find("even (filter) -> triple (map)") != std::string::npos,
+              "linear chain not called directly");
+        check(plan.find("=> slow async") != std::string::npos,
+              "edge into blocking sink not async");
+        check(plan.find("=> merge sync") != std::string::npos,
+              "fan-in edge missing");
+
+        std::vector<uint64_t> sums(producers, 0);
+        parallel(producers, [&](size_t index) {
+            Random random(seed + index);
+            for (uint64_t i = 0; i < per_producer; ++i) {
+                uint64_t data = random() % 1000;
+                sums[index] += (data % 2 == 0 ? data * 3 : 0) + data + 1;
+                graph.push(source, data);
+            }
+        });
+        graph.wait();
+
+        uint64_t expected = 0;
+        for (auto el : sums) expected += el;
+        check(merged.load() == expected, "merged events lost");
+        check(slow.load() == producers * per_producer, "async events lost");
+        check(handler.calls.load() == producers * per_producer,
+              "handler sink events lost");
+    });
+
+    runner.run("flow_graph/validate", [](uint64_t) {
+        auto throws = [](auto&& func) {
+            try {
+                func();
+            } catch (const std::logic_error&) {
+                return true;
+            }
+            return false;
+        };
+
+        ec::FlowGraph cyclic;
+        auto source = cyclic.source<uint64_t>("source");
+        auto merge  = cyclic.merge<uint64_t>("merge", {source});
+        auto filter = cyclic.filter(merge, "filter",
+                                    [](const uint64_t&) { return true; });
+        cyclic.connect(filter, merge);
+        check(throws([&] { cyclic.build(); }), "cycle not detected");
+
+        ec::FlowGraph dangling;
+        dangling.source<uint64_t>("source");
+        dangling.merge<uint64_t>("merge", {});
+        check(throws([&] { dangling.build(); }), "node without input built");
+
+        ec::FlowGraph graph;
+        auto input = graph.source<uint64_t>("source");
+        auto sink  = graph.sink(input, "sink", [](const uint64_t&) {});
+        check(throws([&] { graph.push(input, 1); }), "push before build");
+        graph.build();
+        check(throws([&] { graph.source<uint64_t>("late"); }),
+              "graph changed after build");
+        check(throws([&] { graph.setBlocking(sink); }),
+              "graph changed after build");
+        check(throws([&] { graph.push(sink, 1); }), "push into a sink");
+    });
+
+    // An async edge keeps the order of its producer through a small
+    // queue, events pass existing processors and parsers.
+    runner.run("flow_graph/async_order", [](uint64_t seed) {
+        constexpr uint64_t events = 2000;
+
+        ec::Processor<uint64_t, uint64_t> doubler(
+            [](const uint64_t& data) { return data * 2; });
+        ParityParser parity;
+
+        std::vector<uint64_t> received;
+        std::atomic<uint64_t> odd{0};
+
+        ec::FlowGraph graph;
+        graph.setQueueCapacity(4);
+        auto source  = graph.source<uint64_t>("source");
+        auto doubled = graph.process(source, "double", &doubler);
+        auto slow    = graph.sink(doubled, "ordered",
+                                  [&received](const uint64_t& data) {
+                                   received.push_back(data);
+                               });
+        graph.setBlocking(slow);
+
+        auto groups = graph.parse(source, "parity", &parity, 2);
+        graph.sink(groups[1], "odd",
+                   [&odd](const uint64_t& data) { odd += data % 2; });
+        graph.build();
+
+        std::string plan = graph.dump();
+        check(plan.find("=> ordered async") != std::string::npos,
+              "edge into blocking sink not async");
+        check(plan.find("=> parity.1 sync") != std::string::npos,
+              "parser group missing in the plan");
+
+        Random random(seed);
+        for (uint64_t i = 0; i < events; ++i) {
+            graph.push(source, i);
+            if (random() % 128 == 0) std::this_thread::yield();
+        }
+        graph.wait();
+
+        check(received.size() == events, "async events lost");
+        for (uint64_t i = 0; i < received.size(); ++i)
+            check(received[i] == i * 2, "async edge reordered events");
+        check(odd.load() == events / 2, "parser group events lost");
+    });
+}
+
+}  // namespace stress
@@ -0,0 +1,110 @@
+#include "linearizability.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace stress {
+
+namespace {
+
+std::string describe(const QueueOperation& operation) {
+    const char* kinds[] = {"push", "pop", "pop(empty)"};
+    return std::string(kinds[operation.kind]) + " " +
+           std::to_string(operation.value) + " [" +
+           std::to_string(operation.invoke) + ", " +
+           std::to_string(operation.response) + "]";
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////
+// QueueHistory implementation
+////////////////////////////////////////////////////////////
+
+QueueHistory::QueueHistory(size_t thread_count) : threads_(thread_count) {}
+
+uint64_t QueueHistory::begin() { return clock_.fetch_add(1); }
+
+void QueueHistory::push(size_t thread, uint64_t value, uint64_t invoke) {
+    threads_[thread].push_back(
+        {QueueOperation::Push, value, invoke, clock_.fetch_add(1)});
+}
+
+void QueueHistory::pop(size_t thread, bool found, uint64_t value,
+                       uint64_t invoke) {
+    threads_[thread].push_back(
+        {found ? QueueOperation::Pop : QueueOperation::PopEmpty,
+         found ? value : 0, invoke, clock_.fetch_add(1)});
+}
+
+std::string QueueHistory::check() const {
+    std::unordered_map<uint64_t, QueueOperation> pushes;
+    std::unordered_map<uint64_t, QueueOperation> pops;
+    std::vector<QueueOperation> empty_pops;
+
+    for (auto& thread : threads_)
+        for (auto& el : thread) {
+            if (el.kind == QueueOperation::Push) {
+                if (!pushes.emplace(el.value, el).second)
+                    return "value pushed twice: " + describe(el);
+            } else if (el.kind == QueueOperation::Pop) {
+                auto position = pops.find(el.value);
+                if (position != pops.end())
+                    return "value popped twice: " + describe(position->second) +
+                           " and " + describe(el);
+                pops.emplace(el.value, el);
+            } else {
+                empty_pops.push_back(el);
+            }
+        }
+
+    for (auto& el : pops)
+        if (pushes.count(el.first) == 0)
+            return "popped value never pushed: " + describe(el.second);
+
+    for (auto& el : pushes)
+        if (pops.count(el.first) == 0)
+            return "pushed value lost: " + describe(el.second);
+
+    // Values whose pushes do not overlap must be popped in push order,
+    // checked for pushes sorted by invoke so the inner loop can start at
+    // the first push that follows.
+    std::vector<const QueueOperation*> order;
+    for (auto& el : pushes) order.push_back(&el.second);
+    std::sort(order.begin(), order.end(),
+              [](const QueueOperation* lhs, const QueueOperation* rhs) {
+                  return lhs->invoke < rhs->invoke;
+              });
+
+    for (auto first : order) {
+        const QueueOperation& first_pop = pops.at(first->value);
+        auto following                  = std::upper_bound(
+            order.begin(), order.end(), first->response,
+            [](uint64_t tick, const QueueOperation* el) {
+                return tick < el->invoke;
+            });
+
+        for (auto position = following; position != order.end(); ++position) {
+            const QueueOperation* second = *position;
+            const QueueOperation& second_pop = pops.at(second->value);
+            if (second_pop.response < first_pop.invoke)
+                return "pops overtook pushes: " + describe(*first) + ", " +
+                       describe(*second) + " then " + describe(second_pop) +
+                       ", " + describe(first_pop);
+        }
+    }
+
+    for (auto& empty : empty_pops)
+        for (auto& el : pushes) {
+            const QueueOperation& pop = pops.at(el.first);
+            if (el.second.response < empty.invoke &&
+                pop.invoke > empty.response)
+                return "empty pop while queue held a value: " +
+                       describe(el.second) + ", " + describe(empty) + ", " +
+                       describe(pop);
+        }
+
+    return "";
+}
+
+}  // namespace stress
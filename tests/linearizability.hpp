@@ -0,0 +1,103 @@
+#ifndef _TMBEL_TESTS_LINEARIZABILITY_HPP_
+#define _TMBEL_TESTS_LINEARIZABILITY_HPP_
+
+#include "stress.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace stress {
+
+////////////////////////////////////////////////////////////
+/// \brief One completed queue operation. invoke and response
+/// are ticks of a shared logical clock, so operation a
+/// precedes b in real time when a.response < b.invoke.
+////////////////////////////////////////////////////////////
+struct QueueOperation {
+    enum Kind { Push, Pop, PopEmpty };
+
+    Kind kind;
+    uint64_t value;
+    uint64_t invoke;
+    uint64_t response;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief History of concurrent operations on a FIFO queue
+/// with unique values, checked for linearizability.
+///
+/// The check looks for the violations that characterize
+/// queues (Henzinger et al., "Aspect-oriented linearizability
+/// proofs"): a value popped that was never pushed or popped
+/// twice, a pushed value lost, two values popped against the
+/// order of their non-overlapping pushes, and an empty pop
+/// while a value was in the queue for its whole duration.
+/// The history must end with the queue drained.
+////////////////////////////////////////////////////////////
+class QueueHistory {
+ protected:
+    std::atomic<uint64_t> clock_{0};
+    std::vector<std::vector<QueueOperation>> threads_;
+
+ public:
+    QueueHistory(size_t thread_count);
+
+    /// Tick to pass as invoke, taken right before the call.
+    uint64_t begin();
+
+    /// Records the operation of thread, taking the response
+    /// tick. Every thread only records into its own slot.
+    void push(size_t thread, uint64_t value, uint64_t invoke);
+    void pop(size_t thread, bool found, uint64_t value, uint64_t invoke);
+
+    /// Empty when no violation was found, the first one
+    /// otherwise.
+    std::string check() const;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Runs thread_count threads doing ops random pushes
+/// and polls on queue, drains it and checks the history.
+/// Queue needs push(const uint64_t&) and
+/// bool pollEvent(uint64_t*), like ec::EventQueue. Every
+/// queue backend is expected to pass it.
+////////////////////////////////////////////////////////////
+template <typename Queue>
+void checkQueue(Queue& queue, uint64_t seed, size_t thread_count,
+                size_t ops) {
+    QueueHistory history(thread_count + 1);
+
+    parallel(thread_count, [&](size_t index) {
+        Random random(seed * 31 + index);
+        uint64_t next = uint64_t(index + 1) << 32;
+
+        for (size_t i = 0; i < ops; ++i) {
+            uint64_t invoke = history.begin();
+            if (random() % 5 < 3) {
+                queue.push(next);
+                history.push(index, next++, invoke);
+            } else {
+                uint64_t value = 0;
+                bool found     = queue.pollEvent(&value);
+                history.pop(index, found, value, invoke);
+            }
+        }
+    });
+
+    while (true) {
+        uint64_t invoke = history.begin();
+        uint64_t value  = 0;
+        bool found      = queue.pollEvent(&value);
+        history.pop(thread_count, found, value, invoke);
+        if (!found) break;
+    }
+
+    std::string error = history.check();
+    check(error.empty(), error);
+}
+
+}  // namespace stress
+
+#endif
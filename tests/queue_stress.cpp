@@ -0,0 +1,311 @@
+#include "linearizability.hpp"
+#include "stress.hpp"
+
+#include <TMBEL.hpp>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace stress {
+
+namespace {
+
+// Pops the newest value, the checker has to reject it.
+class BrokenQueue {
+ protected:
+    std::mutex lock_;
+    std::vector<uint64_t> resource_;
+
+ public:
+    void push(const uint64_t& data) {
+        std::lock_guard lock(lock_);
+        resource_.push_back(data);
+    }
+
+    bool pollEvent(uint64_t* data) {
+        std::lock_guard lock(lock_);
+        if (resource_.empty()) return false;
+        *data = resource_.back();
+        resource_.pop_back();
+        return true;
+    }
+};
+
+// Every consumer must see the values of one producer in push order and
+// every value exactly once.
+void checkDelivery(const std::vector<std::vector<uint64_t>>& received,
+                   size_t producers, uint64_t per_producer) {
+    std::vector<uint64_t> counts(producers * per_producer, 0);
+
+    for (auto& consumer : received) {
+        std::vector<int64_t> last(producers, -1);
+        for (auto el : consumer) {
+            size_t producer = el / per_producer;
+            int64_t index   = el % per_producer;
+            check(producer < producers, "unknown value received");
+            check(index > last[producer], "values of a producer reordered");
+            last[producer] = index;
+            ++counts[el];
+        }
+    }
+
+    for (auto el : counts) check(el == 1, "value lost or delivered twice");
+}
+
+// Producers push to staging queues that one thread splices into the queue
+// a consumer drains.
+void spliceRound(uint64_t seed, bool arenas) {
+    constexpr size_t producers     = 2;
+    constexpr uint64_t per_producer = 2000;
+
+    // Small enough for bursts to overflow to the upstream allocator.
+    ec::ArenaResource arena[producers] = {ec::ArenaResource(4096),
+                                          ec::ArenaResource(4096)};
+    std::vector<std::unique_ptr<ec::EventQueue<uint64_t>>> staging;
+    for (auto& el : arena)
+        staging.push_back(arenas ? std::make_unique<ec::EventQueue<uint64_t>>(&el)
+                                 : std::make_unique<ec::EventQueue<uint64_t>>());
+    ec::EventQueue<uint64_t> queue;
+    std::vector<std::vector<uint64_t>> received(1);
+    std::atomic<size_t> finished{0};
+
+    parallel(producers + 2, [&](size_t index) {
+        if (index == producers) {
+            // Moves staged events on until the producers are done.
+            while (finished.load() < producers)
+                for (auto& el : staging) queue.splice(*el);
+            for (auto& el : staging) queue.splice(*el);
+            queue.close();
+            return;
+        }
+        if (index == producers + 1) {
+            uint64_t data;
+            while (queue.waitEvent(&data)) received[0].push_back(data);
+            return;
+        }
+
+        Random random(seed + index);
+        for (uint64_t i = 0; i < per_producer; ++i) {
+            staging[index]->push(index * per_producer + i);
+            if (random() % 64 == 0) std::this_thread::yield();
+        }
+        ++finished;
+    });
+
+    checkDelivery(received, producers, per_producer);
+}
+
+}  // namespace
+
+void queueCases(Runner& runner) {
+    runner.run("checker/rejects_lifo", [](uint64_t seed) {
+        BrokenQueue queue;
+        QueueHistory history(1);
+        Random random(seed);
+
+        uint64_t count = 2 + random() % 16;
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t invoke = history.begin();
+            queue.push(i);
+            history.push(0, i, invoke);
+        }
+        for (uint64_t i = 0; i <= count; ++i) {
+            uint64_t invoke = history.begin();
+            uint64_t value  = 0;
+            bool found      = queue.pollEvent(&value);
+            history.pop(0, found, value, invoke);
+        }
+
+        check(!history.check().empty(), "history of a LIFO passed as FIFO");
+    });
+
+    runner.run("event_queue/linearizable", [](uint64_t seed) {
+        ec::EventQueue<uint64_t> queue;
+        checkQueue(queue, seed, 4, 300);
+    });
+
+    // Nodes are freed by other threads than the ones that allocated them.
+    runner.run("event_queue/linearizable_pool", [](uint64_t seed) {
+        ec::EventQueue<uint64_t> queue(ec::NodePoolResource::getInstance());
+        checkQueue(queue, seed, 4, 300);
+    });
+
+    // Equal deadlines must keep push order.
+    runner.run("event_queue/linearizable_deadline", [](uint64_t seed) {
+        ec::EventQueue<uint64_t> queue;
+        queue.setMode(ec::QueueMode::Deadline);
+        checkQueue(queue, seed, 4, 300);
+    });
+
+    runner.run("event_queue/blocking", [](uint64_t seed) {
+        constexpr size_t producers     = 3;
+        constexpr size_t consumers     = 2;
+        constexpr uint64_t per_producer = 2000;
+
+        ec::EventQueue<uint64_t> queue;
+        std::vector<std::vector<uint64_t>> received(consumers);
+        std::atomic<size_t> finished{0};
+
+        parallel(producers + consumers, [&](size_t index) {
+            if (index < consumers) {
+                uint64_t data;
+                while (queue.waitEvent(&data)) received[index].push_back(data);
+                return;
+            }
+
+            Random random(seed + index);
+            size_t producer = index - consumers;
+            for (uint64_t i = 0; i < per_producer; ++i) {
+                queue.push(producer * per_producer + i);
+                if (random() % 64 == 0) std::this_thread::yield();
+            }
+            if (++finished == producers) queue.close();
+        });
+
+        checkDelivery(received, producers, per_producer);
+    });
+
+    runner.run("event_queue/splice", [](uint64_t seed) {
+        spliceRound(seed, false);
+    });
+
+    // Staging queues on arenas, spliced entry by entry and released
+    // whenever they run empty.
+    runner.run("event_queue/splice_arena", [](uint64_t seed) {
+        spliceRound(seed, true);
+    });
+
+    // Spliced entries keep the time they were first queued, entries of an
+    // untimed queue count from the splice.
+    runner.run("event_queue/splice_delay", [](uint64_t seed) {
+        using namespace std::chrono;
+        constexpr uint64_t events = 64;
+
+        Random random(seed);
+        bool arena    = random() % 2 == 0;
+        bool timed    = random() % 2 == 0;
+        auto waited   = microseconds(500);
+        auto now_late = nanoseconds(seconds(1)).count();
+
+        ec::ArenaResource staging_arena(4096);
+        auto staging = arena ? std::make_unique<ec::EventQueue<uint64_t>>(
+                                   &staging_arena)
+                             : std::make_unique<ec::EventQueue<uint64_t>>();
+        staging->setDelayStats(timed);
+        for (uint64_t i = 0; i < events; ++i) staging->push(i);
+        std::this_thread::sleep_for(waited);
+
+        ec::EventQueue<uint64_t> queue;
+        queue.setDelayStats(true);
+        queue.splice(*staging);
+
+        uint64_t data;
+        while (queue.pollEvent(&data)) {}
+        ec::QueueDelayStats stats = queue.getDelayStats();
+
+        check(stats.count == events, "spliced events not timed");
+        check(stats.max < uint64_t(now_late), "delay of unstamped entries");
+        if (timed)
+            check(stats.p50 >= uint64_t(nanoseconds(waited).count()),
+                  "enqueue time lost on splice");
+    });
+
+    // Events queued before delay statistics were turned on have no enqueue
+    // time and are left out of the statistics.
+    runner.run("event_queue/delay_enabled_late", [](uint64_t seed) {
+        using namespace std::chrono;
+        constexpr uint64_t events = 64;
+
+        Random random(seed);
+        uint64_t untimed = random() % events;
+        auto now_late    = nanoseconds(seconds(1)).count();
+
+        ec::EventQueue<uint64_t> queue;
+        for (uint64_t i = 0; i < untimed; ++i) queue.push(i);
+        queue.setDelayStats(true);
+        for (uint64_t i = untimed; i < events; ++i) queue.push(i);
+
+        uint64_t data;
+        uint64_t taken = 0;
+        while (queue.pollEvent(&data)) ++taken;
+        ec::QueueDelayStats stats = queue.getDelayStats();
+
+        check(taken == events, "events lost");
+        check(stats.count == events - untimed,
+              "unstamped events in delay statistics");
+        check(stats.max < uint64_t(now_late), "delay of unstamped events");
+    });
+
+#ifdef __linux__
+    runner.run("shared_queue/linearizable", [](uint64_t seed) {
+        auto queue = ec::SharedQueue<uint64_t>::create(1024);
+        checkQueue(queue, seed, 4, 300);
+    });
+
+    // A small ring makes both sides sleep on the futexes.
+    runner.run("shared_queue/blocking", [](uint64_t seed) {
+        constexpr size_t producers     = 3;
+        constexpr size_t consumers     = 2;
+        constexpr uint64_t per_producer = 2000;
+
+        auto queue = ec::SharedQueue<uint64_t>::create(16);
+        std::vector<std::vector<uint64_t>> received(consumers);
+        std::atomic<size_t> finished{0};
+
+        parallel(producers + consumers, [&](size_t index) {
+            if (index < consumers) {
+                uint64_t data;
+                while (queue.waitEvent(&data)) received[index].push_back(data);
+                return;
+            }
+
+            Random random(seed + index);
+            size_t producer = index - consumers;
+            for (uint64_t i = 0; i < per_producer; ++i) {
+                queue.push(producer * per_producer + i);
+                if (random() % 64 == 0) std::this_thread::yield();
+            }
+            if (++finished == producers) queue.close();
+        });
+
+        checkDelivery(received, producers, per_producer);
+    });
+
+    // The child maps the inherited descriptor and produces, the parent
+    // consumes until the child closes the queue.
+    runner.run("shared_queue/cross_process", [](uint64_t seed) {
+        constexpr uint64_t count = 20000;
+
+        auto queue =
+            ec::SharedQueue<uint64_t>::create(64, ec::SharedQueueMode::Spsc);
+
+        pid_t child = fork();
+        check(child >= 0, "fork() failed");
+        if (child == 0) {
+            auto producer = ec::SharedQueue<uint64_t>::open(queue.getFd());
+            for (uint64_t i = 0; i < count; ++i) producer.push(seed + i);
+            producer.close();
+            _exit(0);
+        }
+
+        std::vector<std::vector<uint64_t>> received(1);
+        uint64_t data;
+        while (queue.waitEvent(&data)) received[0].push_back(data - seed);
+
+        int status = 0;
+        waitpid(child, &status, 0);
+        check(WIFEXITED(status) && WEXITSTATUS(status) == 0,
+              "producer process failed");
+        checkDelivery(received, 1, count);
+    });
+#endif
+}
+
+}  // namespace stress
@@ -0,0 +1,69 @@
+#include "stress.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+
+namespace stress {
+
+////////////////////////////////////////////////////////////
+// Runner implementation
+////////////////////////////////////////////////////////////
+
+Runner::Runner(const std::string& filter, double seconds, uint64_t seed,
+               uint64_t rounds)
+    : filter_(filter),
+      budget_(std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double>(seconds))),
+      seed_(seed), rounds_(rounds) {}
+
+void Runner::run(const std::string& name, const Round& round) {
+    if (!filter_.empty() && name.find(filter_) == std::string::npos) return;
+
+    auto deadline = Clock::now() + budget_;
+    uint64_t done = 0;
+
+    do {
+        uint64_t seed = seed_ + done;
+        try {
+            round(seed);
+        } catch (const std::exception& error) {
+            std::fprintf(stderr, "FAIL %-44s round %lu (--seed=%lu): %s\n",
+                         name.c_str(), static_cast<unsigned long>(done),
+                         static_cast<unsigned long>(seed), error.what());
+            ++failed_;
+            return;
+        }
+        ++done;
+    } while ((rounds_ == 0 || done < rounds_) && Clock::now() < deadline);
+
+    std::fprintf(stderr, "ok   %-44s %lu rounds\n", name.c_str(),
+                 static_cast<unsigned long>(done));
+}
+
+size_t Runner::failed() const { return failed_; }
+
+void parallel(size_t count, const std::function<void(size_t index)>& body) {
+    std::atomic<size_t> ready{0};
+    std::mutex lock;
+    std::exception_ptr error;
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < count; ++i)
+        threads.emplace_back([&, i]() {
+            ++ready;
+            while (ready.load() < count) std::this_thread::yield();
+            try {
+                body(i);
+            } catch (...) {
+                std::lock_guard guard(lock);
+                if (!error) error = std::current_exception();
+            }
+        });
+    for (auto& el : threads) el.join();
+
+    if (error) std::rethrow_exception(error);
+}
+
+}  // namespace stress
@@ -0,0 +1,71 @@
+#ifndef _TMBEL_TESTS_STRESS_HPP_
+#define _TMBEL_TESTS_STRESS_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace stress {
+
+using Clock  = std::chrono::steady_clock;
+using Random = std::mt19937_64;
+
+////////////////////////////////////////////////////////////
+/// \brief Thrown by check() when a round finds a broken
+/// invariant.
+////////////////////////////////////////////////////////////
+class Failure : public std::runtime_error {
+ public:
+    using std::runtime_error::runtime_error;
+};
+
+inline void check(bool condition, const std::string& message) {
+    if (!condition) throw Failure(message);
+}
+
+////////////////////////////////////////////////////////////
+/// \brief One randomized round of a stress case. Every round
+/// gets its own seed, so a failing one can be replayed with
+/// --seed and --rounds=1.
+////////////////////////////////////////////////////////////
+using Round = std::function<void(uint64_t seed)>;
+
+class Runner {
+ protected:
+    std::string filter_;
+    Clock::duration budget_;
+    uint64_t seed_;
+    uint64_t rounds_;
+    size_t failed_ = 0;
+
+ public:
+    /// Every case runs for seconds or at most rounds rounds,
+    /// whichever ends first. rounds of zero means unlimited.
+    Runner(const std::string& filter, double seconds, uint64_t seed,
+           uint64_t rounds);
+
+    void run(const std::string& name, const Round& round);
+
+    size_t failed() const;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Starts count threads running body(index) and joins
+/// them. All threads are released at once to maximize the
+/// overlap of their operations, the first exception thrown
+/// by a thread is rethrown.
+////////////////////////////////////////////////////////////
+void parallel(size_t count, const std::function<void(size_t index)>& body);
+
+void queueCases(Runner& runner);
+void handlerCases(Runner& runner);
+void containerCases(Runner& runner);
+
+}  // namespace stress
+
+#endif
@@ -0,0 +1,54 @@
+#include "stress.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+////////////////////////////////////////////////////////////
+/// tmbel_stress [--filter=substring] [--seconds=x]
+///              [--seed=n] [--rounds=n]
+///
+/// Runs every case for the given time and exits with 1 when
+/// one of them failed. A failure prints the seed of its
+/// round, --seed=<seed> --rounds=1 replays it.
+////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv) {
+    std::string filter;
+    double seconds  = 2.0;
+    uint64_t seed   = 1;
+    uint64_t rounds = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        auto value = [&argument](const char* prefix) -> const char* {
+            size_t length = std::strlen(prefix);
+            return argument.compare(0, length, prefix) == 0
+                       ? argument.c_str() + length
+                       : nullptr;
+        };
+
+        if (auto el = value("--filter="))
+            filter = el;
+        else if (auto el = value("--seconds="))
+            seconds = std::strtod(el, nullptr);
+        else if (auto el = value("--seed="))
+            seed = std::strtoull(el, nullptr, 10);
+        else if (auto el = value("--rounds="))
+            rounds = std::strtoull(el, nullptr, 10);
+        else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--filter=substring] [--seconds=x] [--seed=n]"
+                         " [--rounds=n]\n";
+            return 2;
+        }
+    }
+
+    stress::Runner runner(filter, seconds, seed, rounds);
+    stress::queueCases(runner);
+    stress::handlerCases(runner);
+    stress::containerCases(runner);
+
+    return runner.failed() == 0 ? 0 : 1;
+}